@@ -0,0 +1,99 @@
+/*
+ * Precomputed 8080 ALU results and flags, generated at compile time
+ */
+
+#include "aluTables.hpp"
+
+// flag bits in the PSW byte
+static constexpr uint8_t SIGN_FLAG = 0b1000'0000;
+static constexpr uint8_t ZERO_FLAG = 0b0100'0000;
+static constexpr uint8_t AUXILIARY_CARRY_FLAG = 0b0001'0000;
+static constexpr uint8_t PARITY_FLAG = 0b0000'0100;
+static constexpr uint8_t CARRY_FLAG = 0b0000'0001;
+// bit [1] is always 1
+static constexpr uint8_t CONSTANT_FLAGS = 0b0000'0010;
+
+// S, Z and P of a result
+static constexpr uint8_t signZeroParity(uint8_t value) {
+    uint8_t parity = value;
+    parity ^= parity >> 4;
+    parity ^= parity >> 2;
+    parity ^= parity >> 1;
+    return (value & SIGN_FLAG)
+        | ((value == 0) ? ZERO_FLAG : 0)
+        | ((parity & 0x01) ? 0 : PARITY_FLAG); // even parity
+}
+
+// result and flags of a + operand + carry
+static constexpr uint16_t addEntry(int a, int operand, int carry) {
+    int result = a + operand + carry;
+    uint8_t sum = result & 0xff;
+    uint8_t flags = CONSTANT_FLAGS | signZeroParity(sum)
+        | ((a ^ operand ^ sum) & AUXILIARY_CARRY_FLAG)
+        | ((result & 0x100) ? CARRY_FLAG : 0);
+    return sum | (flags << 8);
+}
+
+// result and flags of a - operand - carry
+static constexpr uint16_t subtractEntry(int a, int operand, int carry) {
+    int result = a - operand - carry;
+    uint8_t difference = result & 0xff;
+    // AC is the nibble carry of a + ~operand + !carry, i.e. no borrow
+    uint8_t flags = CONSTANT_FLAGS | signZeroParity(difference)
+        | ((a ^ (~operand & 0xff) ^ difference) & AUXILIARY_CARRY_FLAG)
+        | ((result & 0x100) ? CARRY_FLAG : 0);
+    return difference | (flags << 8);
+}
+
+// fill every table
+static constexpr struct AluTables8080 buildAluTables() {
+    struct AluTables8080 tables = {};
+    for (int value = 0; value < 0x100; ++value) {
+        tables.zsp[value] = signZeroParity(value);
+        // INR carries out of the low nibble only from 0b1111
+        uint8_t incremented = (value + 1) & 0xff;
+        tables.increment[value] = signZeroParity(incremented)
+            | (((value & 0x0f) == 0x0f) ? AUXILIARY_CARRY_FLAG : 0);
+        // DCR adds 0xff, which carries unless the low nibble is 0b0000
+        uint8_t decremented = (value - 1) & 0xff;
+        tables.decrement[value] = signZeroParity(decremented)
+            | (((value & 0x0f) != 0x00) ? AUXILIARY_CARRY_FLAG : 0);
+    }
+    for (int carry = 0; carry < 2; ++carry) {
+        for (int a = 0; a < 0x100; ++a) {
+            for (int operand = 0; operand < 0x100; ++operand) {
+                tables.add[carry][a][operand] = addEntry(a, operand, carry);
+                tables.subtract[carry][a][operand] =
+                    subtractEntry(a, operand, carry);
+            }
+        }
+    }
+    // DAA adds 0x06 and/or 0x60 and sets CY if the high digit overflowed
+    for (int carries = 0; carries < 4; ++carries) {
+        bool isAuxiliaryCarry = carries & 0b10;
+        bool isCarry = carries & 0b01;
+        for (int a = 0; a < 0x100; ++a) {
+            int lowNibble = a & 0x0f;
+            int highNibble = a & 0xf0;
+            int adjustment = 0x00;
+            bool carry = false;
+            if ((lowNibble > 0x09) || isAuxiliaryCarry) {
+                adjustment |= 0x06;
+            }
+            if (
+                (highNibble > 0x90)
+                || ((highNibble == 0x90) && (lowNibble > 0x09))
+                || isCarry
+            ) {
+                adjustment |= 0x60;
+                carry = true;
+            }
+            uint16_t entry = addEntry(a, adjustment, 0);
+            if (carry) entry |= (CARRY_FLAG << 8);
+            tables.decimalAdjust[carries][a] = entry;
+        }
+    }
+    return tables;
+}
+
+extern constexpr struct AluTables8080 ALU_TABLES = buildAluTables();
@@ -0,0 +1,40 @@
+/*
+ * Precomputed 8080 ALU results and flags, generated at compile time
+ */
+
+#ifndef ALUTABLES_HPP
+#define ALUTABLES_HPP
+
+#include <cstdint>
+
+/*
+ * Lookup tables for the 8-bit arithmetic of the 8080.
+ *
+ * Flag bytes use the PSW layout: S Z 0 AC 0 P 1 CY.
+ * Entries of add, subtract and decimalAdjust hold the 8-bit result in the
+ * low byte and the complete flags byte in the high byte.
+ *
+ * zsp[value]                       S, Z and P of a result
+ * add[carry][a][operand]           ADD/ADC, a + operand + carry
+ * subtract[carry][a][operand]      SUB/SBB/CMP, a - operand - carry
+ * increment[value]                 S Z AC P of INR value (CY unaffected)
+ * decrement[value]                 S Z AC P of DCR value (CY unaffected)
+ * decimalAdjust[ac << 1 | cy][a]   DAA of a with the given AC and CY
+ *
+ * AC follows the rules of the interpreter helpers: the carry out of the
+ * low nibble for additions, no borrow from the low nibble for
+ * subtractions, and the or of bit 3 of the operands for AND.
+ */
+struct AluTables8080 {
+    uint8_t zsp[0x100];
+    uint16_t add[2][0x100][0x100];
+    uint16_t subtract[2][0x100][0x100];
+    uint8_t increment[0x100];
+    uint8_t decrement[0x100];
+    uint16_t decimalAdjust[4][0x100];
+};
+
+// built by a constexpr function in aluTables.cpp, placed in read-only data
+extern const struct AluTables8080 ALU_TABLES;
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Cache of pre-decoded 8080 basic blocks for the BLOCK emulator core
+ */
+
+#include "blockCache.hpp"
+#include <algorithm>
+
+// one slot per possible entry pc, one page list per 256 bytes
+BlockCache8080::BlockCache8080() :
+        entries(0x10000), pageBlocks(0x100), writableBlocks(0) {
+    statistics = {0, 0, 0};
+}
+
+// empty destructor
+BlockCache8080::~BlockCache8080() {
+
+}
+
+// store a decoded block and register the pages it covers
+struct BasicBlock8080 *BlockCache8080::insert(
+    std::unique_ptr<struct BasicBlock8080> block
+) {
+    ++statistics.misses;
+    struct BasicBlock8080 *cached = block.get();
+    if (cached->isWritable) {
+        ++writableBlocks;
+        for (int page = cached->lowAddress >> 8;
+                page <= (cached->highAddress >> 8); ++page) {
+            pageBlocks[page].push_back(cached);
+        }
+    }
+    entries[cached->entryAddress] = std::move(block);
+    return cached;
+}
+
+// drop every writable block whose bytes include physicalAddress
+bool BlockCache8080::invalidate(uint16_t physicalAddress) {
+    std::vector<struct BasicBlock8080*> &blocks =
+        pageBlocks[physicalAddress >> 8];
+    bool isDropped = false;
+    // drop() erases the block from the page list, which only moves the
+    // entries after it, so walk the list backwards
+    for (size_t i = blocks.size(); i > 0; --i) {
+        struct BasicBlock8080 *block = blocks[i - 1];
+        if ((physicalAddress >= block->lowAddress)
+                && (physicalAddress <= block->highAddress)) {
+            drop(block);
+            isDropped = true;
+        }
+    }
+    return isDropped;
+}
+
+// drop every cached block
+void BlockCache8080::flush() {
+    for (auto &entry : entries) {
+        if (entry) {
+            ++statistics.invalidations;
+            retired.push_back(std::move(entry));
+        }
+    }
+    for (auto &page : pageBlocks) {
+        page.clear();
+    }
+    writableBlocks = 0;
+}
+
+// free dropped blocks
+void BlockCache8080::retire() {
+    retired.clear();
+}
+
+// unlink a block from the page lists and move it to the retired list
+void BlockCache8080::drop(struct BasicBlock8080 *block) {
+    ++statistics.invalidations;
+    if (block->isWritable) {
+        --writableBlocks;
+        for (int page = block->lowAddress >> 8;
+                page <= (block->highAddress >> 8); ++page) {
+            std::vector<struct BasicBlock8080*> &blocks = pageBlocks[page];
+            blocks.erase(
+                std::remove(blocks.begin(), blocks.end(), block),
+                blocks.end()
+            );
+        }
+    }
+    retired.push_back(std::move(entries[block->entryAddress]));
+}
@@ -0,0 +1,113 @@
+/*
+ * Cache of pre-decoded 8080 basic blocks for the BLOCK emulator core
+ */
+
+#ifndef BLOCKCACHE_HPP
+#define BLOCKCACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * One instruction with its immediate operand already extracted
+ */
+struct DecodedInstruction8080 {
+    uint8_t opcode;
+    uint8_t length; // bytes, 1-3
+    uint16_t operand; // immediate byte or word, 0 if none
+};
+
+/*
+ * A run of straight-line instructions ending in a control transfer
+ * (or at the length limit). Decoded once, executed many times.
+ */
+struct BasicBlock8080 {
+    uint16_t entryAddress; // pc the block was decoded from
+    // physical address range covered by the instruction bytes
+    uint16_t lowAddress;
+    uint16_t highAddress;
+    // true if any covered byte can be written (RAM), so the block must
+    // be invalidated by writes into its range
+    bool isWritable;
+    // true if any instruction stores, does I/O, halts or changes the
+    // interrupt enable; such blocks never belong to a skipped spin loop
+    bool hasSideEffects;
+    std::vector<struct DecodedInstruction8080> instructions;
+};
+
+/*
+ * Hit/miss/invalidation counters for the block cache
+ */
+struct BlockCacheStatistics {
+    unsigned long long hits; // block found at entry pc
+    unsigned long long misses; // block decoded at entry pc
+    unsigned long long invalidations; // blocks dropped by writes or flush
+};
+
+/*
+ * Blocks are cached by entry pc. Writable blocks are also registered on
+ * every 256-byte page they cover so writes can find them quickly.
+ *
+ * Invalidated blocks are retired rather than destroyed, since the block
+ * being executed may be the one a store invalidates. retire() frees them
+ * once the executor has let go of its block.
+ */
+class BlockCache8080 {
+    public:
+        // longest block decoded, in instructions
+        static const int MAX_BLOCK_INSTRUCTIONS = 64;
+
+        BlockCache8080();
+        ~BlockCache8080();
+
+        // look up the block entered at address, nullptr on a miss
+        // counts a hit when found
+        inline struct BasicBlock8080 *find(uint16_t address) {
+            struct BasicBlock8080 *block = entries[address].get();
+            if (block) ++statistics.hits;
+            return block;
+        }
+
+        // take ownership of a freshly decoded block, counts a miss.
+        // only called after find() missed at the block's entry address
+        struct BasicBlock8080 *insert(std::unique_ptr<struct BasicBlock8080> block);
+
+        // true if a write to physicalAddress could hit a cached block
+        inline bool isCode(uint16_t physicalAddress) const {
+            return (writableBlocks > 0)
+                && (pageBlocks[physicalAddress >> 8].size() > 0);
+        }
+
+        // true if any cached block covers writable memory
+        inline bool hasWritableCode() const { return writableBlocks > 0; }
+
+        // drop every block covering physicalAddress
+        // returns true if anything was dropped
+        bool invalidate(uint16_t physicalAddress);
+
+        // drop every block, e.g. after memory was reloaded from outside
+        void flush();
+
+        // free blocks dropped since the last call
+        void retire();
+
+        // read the counters
+        struct BlockCacheStatistics getStatistics() const { return statistics; }
+
+    private:
+        // blocks indexed by entry pc
+        std::vector<std::unique_ptr<struct BasicBlock8080>> entries;
+        // writable blocks by the 256-byte physical pages they cover
+        std::vector<std::vector<struct BasicBlock8080*>> pageBlocks;
+        // number of cached writable blocks
+        int writableBlocks;
+        // dropped blocks waiting for retire()
+        std::vector<std::unique_ptr<struct BasicBlock8080>> retired;
+        struct BlockCacheStatistics statistics;
+
+        // remove a block from the page lists and retire it
+        void drop(struct BasicBlock8080 *block);
+};
+
+#endif
@@ -21,7 +21,16 @@
 #include <string>
 #include <bitset>
 #include "emulator.hpp"
+#include "machine.hpp"
+#include "platformAdapter.hpp"
+#include "aluTables.hpp"
+#include "invadersHooks.hpp"
+#include "videoRenderer.hpp"
+#include "invadersCabinet.hpp"
 #include <chrono>
+#include <functional>
+#include <set>
+#include <cstddef>
 
 
 
@@ -29,6 +38,9 @@
 
 const int DISPLAY_WIDTH = 16;
 
+// cycles run per call into the emulator by the run command
+const int RUN_BATCH_CYCLES = 100000;
+
 /*
  * Struct holding the arguments retrieved from the command line
  */
@@ -36,6 +48,20 @@ struct disassembleArguments {
     std::string commandName;
     std::string romFileName;
     bool isCpmMode;
+    Emulator8080::core dispatchCore;
+    bool isCompareMode;
+    int benchFrames;
+    int benchRepeats;
+};
+
+/*
+ * Totals gathered while running a program on the emulator
+ */
+struct runStatistics {
+    unsigned long long cycles;
+    unsigned long long instructions;
+    double seconds;
+    double speedUp; // emulated time over host time, Space Invaders only
 };
 
 /*
@@ -46,6 +72,109 @@ std::unique_ptr <struct disassembleArguments> parseArguments(
     int argumentCount, char *argumentVector[]
 );
 
+/*
+ * Patch memory so BDOS calls (CALL $0005) reach an OUT $ff handler
+ * and warm boot (JMP $0000) halts
+ */
+void installCpmBdos(Memory &rom);
+
+/*
+ * Connect BDOS console output of a CP/M program to an ostream
+ */
+void connectCpmConsole(
+    Emulator8080 &emulator, Memory &rom, std::ostream &console
+);
+
+/*
+ * Run a CP/M program to completion on a fresh copy of image, silently.
+ * Used to time one dispatch core against another.
+ */
+struct runStatistics timeCpmProgram(
+    const std::vector<uint8_t> &image, 
+    uint16_t startAddress, 
+    Emulator8080::core dispatchCore
+);
+
+/*
+ * Convert a run to an emulated clock speed
+ */
+double clockMegahertz(const struct runStatistics &run);
+
+/*
+ * Name a dispatch core for reports
+ */
+std::string coreLabel(Emulator8080::core dispatchCore);
+
+/*
+ * Print the block cache counters of the BLOCK core on one line
+ */
+void printBlockCacheStatistics(const struct BlockCacheStatistics &statistics);
+
+/*
+ * Run a number of Space Invaders frames on emulator, which must already be
+ * connected to memory holding the ROM. A Machine in turbo mode schedules
+ * the interrupts on emulated cycles and handles I/O; nothing is rendered.
+ */
+struct runStatistics timeInvaders(Emulator8080 &emulator, int frames);
+
+/*
+ * Run Space Invaders with and without the native hooks side by side and
+ * compare RAM, registers and cycles after every half frame. The run
+ * without hooks also has spin loop skipping turned off, so it executes
+ * every instruction.
+ * Returns the first half frame that differs, or -1.
+ */
+int checkInvadersHooks(
+    std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames
+);
+
+/*
+ * Draw video RAM the way the Windows app's DrawScreen did before
+ * VideoRenderer: one virtual read per byte and a colour decision per
+ * pixel. Kept as the reference VideoRenderer is checked and timed against.
+ */
+void renderReference(const Memory &memory, uint8_t *pixels);
+
+/*
+ * Check VideoRenderer against renderReference() on the screen in memory
+ * and time both. Returns false if the images differ.
+ */
+bool benchVideoRenderer(const SpaceInvaderMemory &memory);
+
+/*
+ * Run Space Invaders for frames, redrawing each changed frame both
+ * incrementally from the dirty video RAM columns and in full. Reports how
+ * much of the screen changes and the time of both, and returns false if
+ * the two ever differ.
+ */
+bool benchIncrementalRendering(const std::vector<uint8_t> &image, int frames);
+
+/*
+ * Run Space Invaders for frames with split rendering, checking each half
+ * against a full redraw taken at the same interrupt. Reports the time per
+ * half and how many frames differ from one conversion at the RST1
+ * boundary, which would have torn. Returns false on a mismatch.
+ */
+bool benchSplitRendering(const std::vector<uint8_t> &image, int frames);
+
+/*
+ * Run every ALU instruction with every accumulator, operand and AC/CY
+ * combination on the table core (flag helpers) and the switch core
+ * (ALU_TABLES) and compare the results. Returns the number of mismatches.
+ */
+long checkAluTables();
+
+/*
+ * Step a number of Space Invaders frames and report how many 64-byte
+ * lines of ALU_TABLES the arithmetic instructions touch. memory is the
+ * memory emulator is connected to.
+ */
+void measureAluTableLines(
+    Emulator8080 &emulator, SpaceInvaderMemory &memory, int frames
+);
+
 int main(int argc, char *argv[]) {
 	std::ios_base::sync_with_stdio(false);
     // send the argment variables to the TCLAP parser
@@ -94,6 +223,17 @@ int main(int argc, char *argv[]) {
 
     
 
+    // keep a pristine image for comparison and benchmark runs
+    std::vector<uint8_t> image;
+    if (
+        args->isCompareMode || (args->commandName == "bench")
+        || (args->commandName == "alutables")
+        || (args->commandName == "hooks")
+        || (args->commandName == "render")
+    ) {
+        image = *tempROM;
+    }
+
     // move buffer into Memory object
     Memory rom(std::move(tempROM));
 
@@ -140,51 +280,15 @@ int main(int argc, char *argv[]) {
 
     } else if ((args->commandName == "debug") || (args->commandName == "run")) {
         Disassembler8080 disassembler(&rom);
-        Emulator8080 emulator(&rom);
+        Emulator8080 emulator(&rom, args->dispatchCore);
         if (args->commandName == "debug") disassembler.reset(startAddress);
         emulator.reset(startAddress);
 
         // set up memory for cpu emulation
         // and emulate BDOS calls
         if (args->isCpmMode) {
-            rom.write(0xc3, 0x0005); //JMP $e400
-            rom.write(0x00, 0x0006);
-            rom.write(0xe4, 0x0007);
-
-            rom.write(0xf5, 0xe400); //PUSH PSW
-            rom.write(0x79, 0xe401); //MOV A,C
-            rom.write(0xd3, 0xe402); //OUT $ff
-            rom.write(0xff, 0xe403);
-            rom.write(0xf1, 0xe404); //POP PSW
-            rom.write(0xc9, 0xe405); //RET
-
-            auto outputPort = [&emulator, &rom](uint8_t port, uint8_t value){
-                if (port == 0xff) {
-                    if (value == 9) {
-                        // C_WRITESTR system call
-                        auto cpuRegisters = emulator.getState();
-                        uint16_t stringOffset = (cpuRegisters->d << 8) 
-                            + cpuRegisters->e;
-                        //stringOffset += 3; // skip prefix
-                        //std::cout << '\n'; // prefix is a newline
-                        while (
-                            static_cast<char>(rom.read(stringOffset)) != '$'
-                        ) {
-                            std::cout << static_cast<char>(
-                                rom.read(stringOffset)
-                            );
-                            ++stringOffset;
-                        }
-                    } else if (value == 2) {
-                        // C_WRITE system call
-                        auto cpuRegisters = emulator.getState();
-                        std::cout << static_cast<char>(cpuRegisters->e);
-                    }
-                }
-                return;
-            };
-
-            emulator.connectOutput(outputPort);
+            installCpmBdos(rom);
+            connectCpmConsole(emulator, rom, std::cout);
         } else {
             emulator.connectOutput([](uint8_t port, uint8_t value){return;});
             
@@ -196,42 +300,53 @@ int main(int argc, char *argv[]) {
         auto startTime = std::chrono::high_resolution_clock::now();
 
         try {
-            std::unique_ptr<struct State8080> state = nullptr;
+            struct Registers8080 state;
             bool finished = false;
             while (!finished) {
-                cycles += emulator.step();
-                ++instructions;
+                if (args->commandName == "run") {
+                    // run a batch of instructions inside the emulator
+                    cycles += emulator.runCycles(RUN_BATCH_CYCLES);
+                    instructions = emulator.getInstructionCount();
+                } else {
+                    cycles += emulator.step();
+                    ++instructions;
+                }
                 if (args->commandName == "debug") {
                     disassembler.step();
-                    state = emulator.getState();
-                    disassembler.reset(state->pc);
+                    state = emulator.getRegisters();
+                    disassembler.reset(state.pc);
                     std::cout << "Cycles: " << std::dec << cycles << '\n';
                     std::cout << std::right << std::hex << std::setfill('0');
                     std::cout << "A: 0x" << std::setw(2) 
-                        << static_cast<int>(state->a) << " ";
+                        << static_cast<int>(state.a) << " ";
                     std::cout << "B: 0x" << std::setw(2) 
-                        << static_cast<int>(state->b) << " ";
+                        << static_cast<int>(state.b) << " ";
                     std::cout << "C: 0x" << std::setw(2) 
-                        << static_cast<int>(state->c) << " ";
+                        << static_cast<int>(state.c) << " ";
                     std::cout << "D: 0x" << std::setw(2)  
-                        << static_cast<int>(state->d) << " ";
+                        << static_cast<int>(state.d) << " ";
                     std::cout << "E: 0x" << std::setw(2)  
-                        << static_cast<int>(state->e) << " ";
+                        << static_cast<int>(state.e) << " ";
                     std::cout << "H: 0x" << std::setw(2)  
-                        << static_cast<int>(state->h) << " ";
+                        << static_cast<int>(state.h) << " ";
                     std::cout << "L: 0x" << std::setw(2) 
-                        << static_cast<int>(state->l) << " ";
+                        << static_cast<int>(state.l) << " ";
                     std::cout << "SP: 0x" << std::setw(4) 
-                        << static_cast<int>(state->sp) << " ";
+                        << static_cast<int>(state.sp) << " ";
                     std::cout << "PC: 0x" << std::setw(4) 
-                        << static_cast<int>(state->pc) << " ";
+                        << static_cast<int>(state.pc) << " ";
                     std::cout << "Flags: 0b" << std::setw(8)
-                        << std::bitset<8>(static_cast<int>(state->getFlags()));
+                        << std::bitset<8>(static_cast<int>(state.getFlags()));
                     std::cout << '\n';
                 }
-                if (args->isCpmMode && (emulator.getState()->pc == 0)) {
+                if (args->isCpmMode && (emulator.getProgramCounter() == 0)) {
                     finished = true;
                 } 
+                // nothing runs after HLT without interrupts
+                // cp/m warm boot (JMP $0000) ends here
+                if (emulator.isHalted()) {
+                    finished = true;
+                }
             } 
         auto stopTime = std::chrono::high_resolution_clock::now();
         std::chrono::duration<long long, std::nano> runTime = 
@@ -244,12 +359,241 @@ int main(int argc, char *argv[]) {
         double megahertz = (static_cast<double>(cycles) / runSeconds) / 1.e6;
         std::cout << "Approximate clock speed: " << megahertz;
         std::cout << " MHz." << std::endl;
+        if (emulator.isDeadlocked()) {
+            // no interrupt can end this halt; cp/m warm boot stops here
+            std::cout << "Halted at " << std::hex << std::setfill('0') 
+                << "$" << std::setw(4) << emulator.getProgramCounter() 
+                << " with interrupts disabled." << std::dec 
+                << std::setfill(' ') << std::endl;
+        }
+
+        if (args->dispatchCore == Emulator8080::BLOCK) {
+            printBlockCacheStatistics(emulator.getBlockCacheStatistics());
+            std::cout << std::endl;
+        }
+
+        // time the table core and the faster core on the same program and
+        // report the gain (the switch core if the table core was run).
+        // both runs write to the same discard sink: the run above printed
+        // to the console, which is slower and would flatter the other core
+        if (args->isCompareMode && args->isCpmMode) {
+            bool isTable = (args->dispatchCore == Emulator8080::TABLE);
+            Emulator8080::core fastCore = 
+                isTable ? Emulator8080::SWITCH : args->dispatchCore;
+            double tableMegahertz = clockMegahertz(
+                timeCpmProgram(image, startAddress, Emulator8080::TABLE)
+            );
+            double fastMegahertz = clockMegahertz(
+                timeCpmProgram(image, startAddress, fastCore)
+            );
+            std::cout << "Table core: " << tableMegahertz << " MHz. ";
+            std::cout << coreLabel(fastCore) << " core: " << fastMegahertz 
+                << " MHz. ";
+            std::cout << "Gain: " << (fastMegahertz / tableMegahertz);
+            std::cout << "x." << std::endl;
+        }
         } catch (const std::exception& e) {
             // processor throws excptions on illegal memory read
             // and on unknown opcode
             std::cerr << e.what() << '\n';
             return 1;
         }
+    } else if (args->commandName == "render") {
+        // run the game to get a busy screen, then convert it repeatedly
+        SpaceInvaderMemory memory;
+        memory.flashROM(image.data());
+        Emulator8080 emulator(&memory, Emulator8080::BLOCK);
+        emulator.reset(0x0000);
+        timeInvaders(emulator, args->benchFrames);
+        std::cout << "Space Invaders screen after " << std::dec 
+            << args->benchFrames << " frames:" << std::endl;
+        if (!benchVideoRenderer(memory)) return 1;
+        if (!benchIncrementalRendering(image, args->benchFrames)) return 1;
+        if (!benchSplitRendering(image, args->benchFrames)) return 1;
+    } else if (args->commandName == "alutables") {
+        // check the ALU lookup tables and report their cache footprint
+        std::cout << "ALU_TABLES: " << std::dec << sizeof(ALU_TABLES) 
+            << " bytes (add " << sizeof(ALU_TABLES.add) 
+            << ", subtract " << sizeof(ALU_TABLES.subtract) << ")" 
+            << std::endl;
+        long mismatches = checkAluTables();
+        std::cout << "Exhaustive check against the flag helpers: " 
+            << mismatches << " mismatches." << std::endl;
+        if (mismatches != 0) return 1;
+
+        SpaceInvaderMemory memory;
+        memory.flashROM(image.data());
+        Emulator8080 emulator(&memory, Emulator8080::SWITCH);
+        emulator.reset(0x0000);
+        measureAluTableLines(emulator, memory, args->benchFrames);
+    } else if (args->commandName == "hooks") {
+        // check the native Space Invaders hooks and time them
+        Emulator8080::core dispatchCore = 
+            (args->dispatchCore == Emulator8080::TABLE) 
+                ? Emulator8080::SWITCH : args->dispatchCore;
+        int divergence = 
+            checkInvadersHooks(image, dispatchCore, args->benchFrames);
+        if (divergence >= 0) {
+            std::cerr << "hooked run diverged in half frame " << std::dec
+                << divergence << '\n';
+            return 1;
+        }
+        std::cout << "Space Invaders, " << std::dec << args->benchFrames
+            << " frames, " << coreLabel(dispatchCore) << " core: "
+            << "RAM, registers and cycles match." << std::endl;
+
+        for (bool isHooked : {false, true}) {
+            SpaceInvaderMemory memory;
+            memory.flashROM(image.data());
+            Emulator8080 emulator(&memory, dispatchCore);
+            emulator.reset(0x0000);
+            if (isHooked) {
+                std::vector<std::string> installed = 
+                    installInvadersHooks(emulator, memory);
+                std::cout << "Hooks:";
+                for (const std::string &name : installed) {
+                    std::cout << " " << name;
+                }
+                std::cout << std::endl;
+            }
+            struct runStatistics run = 
+                timeInvaders(emulator, args->benchFrames);
+            std::cout << std::left << std::setfill(' ') << std::setw(30)
+                << (isHooked ? "  hooked:" : "  interpreted:");
+            std::cout << clockMegahertz(run) << " MHz (" << run.seconds 
+                << " s, " << std::setprecision(3)
+                << (100.0 * emulator.getHookCycles() / run.cycles)
+                << "% of cycles in hooks)" << std::setprecision(6) 
+                << std::endl;
+        }
+    } else if ((args->commandName == "bench") && args->isCpmMode) {
+        // time each core on a cp/m test program
+        std::vector<Emulator8080::core> cores = {
+            Emulator8080::TABLE, Emulator8080::SWITCH, Emulator8080::BLOCK
+        };
+        std::cout << args->romFileName << ", " << std::dec 
+            << args->benchRepeats << " run(s):" << std::endl;
+        struct runStatistics first = {0, 0, 0.0, 0.0};
+        for (Emulator8080::core dispatchCore : cores) {
+            struct runStatistics total = {0, 0, 0.0, 0.0};
+            for (int i = 0; i < args->benchRepeats; ++i) {
+                struct runStatistics run = 
+                    timeCpmProgram(image, startAddress, dispatchCore);
+                total.cycles += run.cycles;
+                total.instructions += run.instructions;
+                total.seconds += run.seconds;
+            }
+            std::cout << std::left << std::setfill(' ') << std::setw(30)
+                << ("  " + coreLabel(dispatchCore) + " core:");
+            std::cout << clockMegahertz(total) << " MHz (" 
+                << total.instructions << " instructions, " 
+                << total.seconds << " s)" << std::endl;
+
+            // every core must run the program the same way
+            if (first.cycles == 0) {
+                first = total;
+            } else if (
+                (total.cycles != first.cycles)
+                || (total.instructions != first.instructions)
+            ) {
+                std::cerr << coreLabel(dispatchCore) 
+                    << " core diverged from the table core" << '\n';
+                return 1;
+            }
+        }
+    } else if (args->commandName == "bench") {
+        // time each emulator build on the Space Invaders ROM
+        struct benchConfiguration {
+            std::string name;
+            std::function<std::unique_ptr<Emulator8080>(SpaceInvaderMemory*)> 
+                build;
+        };
+        std::vector<struct benchConfiguration> configurations = {
+            {"table core", [](SpaceInvaderMemory *memory) {
+                return std::make_unique<Emulator8080>(
+                    memory, Emulator8080::TABLE
+                );
+            }},
+            {"switch core", [](SpaceInvaderMemory *memory) {
+                return std::make_unique<Emulator8080>(
+                    memory, Emulator8080::SWITCH
+                );
+            }},
+            {"switch core, no spin skip", [](SpaceInvaderMemory *memory) {
+                std::unique_ptr<Emulator8080> emulator = 
+                    std::make_unique<Emulator8080>(
+                        memory, Emulator8080::SWITCH
+                    );
+                emulator->setSpinDetection(false);
+                return emulator;
+            }},
+            {"switch core, bound memory", [](SpaceInvaderMemory *memory) {
+                return std::unique_ptr<Emulator8080>(
+                    new BoundEmulator8080<SpaceInvaderMemory>(memory)
+                );
+            }},
+            {"block core", [](SpaceInvaderMemory *memory) {
+                return std::make_unique<Emulator8080>(
+                    memory, Emulator8080::BLOCK
+                );
+            }},
+            {"block core, bound memory", [](SpaceInvaderMemory *memory) {
+                return std::unique_ptr<Emulator8080>(
+                    new BoundEmulator8080<SpaceInvaderMemory>(
+                        memory, Emulator8080::BLOCK
+                    )
+                );
+            }}
+        };
+
+        std::cout << "Space Invaders, " << std::dec << args->benchFrames;
+        std::cout << " frames:" << std::endl;
+        std::vector<uint8_t> firstRAM;
+        for (auto &configuration : configurations) {
+            SpaceInvaderMemory memory;
+            memory.flashROM(image.data());
+            std::unique_ptr<Emulator8080> emulator = 
+                configuration.build(&memory);
+            emulator->reset(0x0000);
+            struct runStatistics run = 
+                timeInvaders(*emulator, args->benchFrames);
+
+            std::cout << std::left << std::setfill(' ') << std::setw(30) 
+                << ("  " + configuration.name + ":");
+            std::cout << clockMegahertz(run) << " MHz (" << run.instructions 
+                << " instructions, " << std::setprecision(4) << run.speedUp 
+                << "x real time)" << std::setprecision(6) << std::endl;
+            if (emulator->getCore() == Emulator8080::BLOCK) {
+                std::cout << std::setw(30) << "";
+                printBlockCacheStatistics(emulator->getBlockCacheStatistics());
+                std::cout << std::endl;
+            }
+            if (emulator->getSpinCycles() > 0) {
+                std::cout << std::setw(30) << "" << "Spin loops: " 
+                    << std::setprecision(3) 
+                    << (100.0 * emulator->getSpinCycles() / run.cycles) 
+                    << "% of cycles skipped." << std::setprecision(6) 
+                    << std::endl;
+            }
+            if (emulator->getIdleCycles() > 0) {
+                std::cout << std::setw(30) << "" << "Halted: " 
+                    << std::setprecision(3) 
+                    << (100.0 * emulator->getIdleCycles() / run.cycles) 
+                    << "% of cycles idle." << std::setprecision(6) 
+                    << std::endl;
+            }
+
+            // every build must leave RAM in the same state
+            std::vector<uint8_t> ram;
+            for (int i = 0x2000; i < 0x4000; ++i) ram.push_back(memory.read(i));
+            if (firstRAM.empty()) {
+                firstRAM = ram;
+            } else if (ram != firstRAM) {
+                std::cerr << configuration.name 
+                    << " diverged from the first build" << '\n';
+                return 1;
+            }
+        }
     }
     
     
@@ -257,6 +601,201 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
+/*
+ * Patch memory so BDOS calls (CALL $0005) reach an OUT $ff handler
+ * and warm boot (JMP $0000) halts
+ */
+void installCpmBdos(Memory &rom) {
+    rom.write(0x76, 0x0000); //HLT, warm boot stops the processor
+
+    rom.write(0xc3, 0x0005); //JMP $e400
+    rom.write(0x00, 0x0006);
+    rom.write(0xe4, 0x0007);
+
+    rom.write(0xf5, 0xe400); //PUSH PSW
+    rom.write(0x79, 0xe401); //MOV A,C
+    rom.write(0xd3, 0xe402); //OUT $ff
+    rom.write(0xff, 0xe403);
+    rom.write(0xf1, 0xe404); //POP PSW
+    rom.write(0xc9, 0xe405); //RET
+}
+
+/*
+ * Connect BDOS console output of a CP/M program to an ostream
+ */
+void connectCpmConsole(
+    Emulator8080 &emulator, Memory &rom, std::ostream &console
+) {
+    auto outputPort = [&emulator, &rom, &console](uint8_t port, uint8_t value){
+        if (port == 0xff) {
+            if (value == 9) {
+                // C_WRITESTR system call
+                uint16_t stringOffset = emulator.getRegisters().getDE();
+                while (
+                    static_cast<char>(rom.read(stringOffset)) != '$'
+                ) {
+                    console << static_cast<char>(
+                        rom.read(stringOffset)
+                    );
+                    ++stringOffset;
+                }
+            } else if (value == 2) {
+                // C_WRITE system call
+                console << static_cast<char>(emulator.getRegisters().e);
+            }
+        }
+        return;
+    };
+
+    emulator.connectOutput(outputPort);
+}
+
+/*
+ * Run a CP/M program to completion on a fresh copy of image, silently.
+ * Used to time one dispatch core against another.
+ */
+struct runStatistics timeCpmProgram(
+    const std::vector<uint8_t> &image, 
+    uint16_t startAddress, 
+    Emulator8080::core dispatchCore
+) {
+    Memory rom(std::make_unique<std::vector<uint8_t>>(image));
+    Emulator8080 emulator(&rom, dispatchCore);
+    emulator.reset(startAddress);
+    // an ostream without a buffer discards everything written to it
+    std::ostream discard(nullptr);
+    installCpmBdos(rom);
+    connectCpmConsole(emulator, rom, discard);
+    emulator.connectInput([](uint8_t){ return 0xff; });
+
+    struct runStatistics run = {0, 0, 0.0, 0.0};
+    auto startTime = std::chrono::high_resolution_clock::now();
+    while (!emulator.isHalted()) {
+        run.cycles += emulator.runCycles(RUN_BATCH_CYCLES);
+    }
+    run.instructions = emulator.getInstructionCount();
+    auto stopTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<long long, std::nano> runTime = 
+        stopTime - startTime;
+    run.seconds = static_cast<double>(runTime.count()) * 1.e-9;
+    return run;
+}
+
+/*
+ * Convert a run to an emulated clock speed
+ */
+double clockMegahertz(const struct runStatistics &run) {
+    return (static_cast<double>(run.cycles) / run.seconds) / 1.e6;
+}
+
+/*
+ * Name a dispatch core for reports
+ */
+std::string coreLabel(Emulator8080::core dispatchCore) {
+    switch (dispatchCore) {
+        case Emulator8080::SWITCH: return "Switch";
+        case Emulator8080::BLOCK: return "Block";
+        default: return "Table";
+    }
+}
+
+/*
+ * Print the block cache counters of the BLOCK core on one line
+ */
+void printBlockCacheStatistics(const struct BlockCacheStatistics &statistics) {
+    std::cout << std::dec << "Block cache: " << statistics.hits << " hits, "
+        << statistics.misses << " misses, " 
+        << statistics.invalidations << " invalidations.";
+}
+
+/*
+ * Run a number of Space Invaders frames on emulator, which must already be
+ * connected to memory holding the ROM. A Machine in turbo mode schedules
+ * the interrupts on emulated cycles and handles I/O; nothing is rendered.
+ */
+struct runStatistics timeInvaders(Emulator8080 &emulator, int frames) {
+    Adapter adapter;
+    adapter.setInputChanged(false);
+    Machine machine;
+    machine.setPlatformAdapter(&adapter);
+    machine.setEmulator(&emulator);
+    machine.setTurbo(true);
+    machine.setRenderPolicy(Machine::RENDER_NEVER);
+
+    struct runStatistics run = {0, 0, 0.0, 0.0};
+    auto startTime = std::chrono::high_resolution_clock::now();
+    machine.resetSpeed();
+    for (int half = 0; half < frames * 2; ++half) {
+        machine.step();
+    }
+    run.speedUp = machine.getSpeedUp();
+    run.cycles = machine.getCycles();
+    auto stopTime = std::chrono::high_resolution_clock::now();
+    run.instructions = emulator.getInstructionCount();
+    std::chrono::duration<long long, std::nano> runTime = 
+        stopTime - startTime;
+    run.seconds = static_cast<double>(runTime.count()) * 1.e-9;
+    return run;
+}
+
+/*
+ * Run Space Invaders with and without the native hooks side by side and
+ * compare RAM, registers and cycles after every half frame. The run
+ * without hooks also has spin loop skipping turned off, so it executes
+ * every instruction.
+ * Returns the first half frame that differs, or -1.
+ */
+int checkInvadersHooks(
+    std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames
+) {
+    // one complete system per run
+    struct hookRun {
+        SpaceInvaderMemory memory;
+        std::unique_ptr<Emulator8080> emulator;
+        Adapter adapter;
+        Machine machine;
+    };
+    struct hookRun runs[2];
+    for (struct hookRun &run : runs) {
+        run.memory.flashROM(image.data());
+        run.emulator = 
+            std::make_unique<Emulator8080>(&run.memory, dispatchCore);
+        run.emulator->reset(0x0000);
+        run.adapter.setInputChanged(false);
+        run.machine.setPlatformAdapter(&run.adapter);
+        run.machine.setEmulator(run.emulator.get());
+    }
+    runs[0].emulator->setSpinDetection(false);
+    installInvadersHooks(*runs[1].emulator, runs[1].memory);
+
+    for (int half = 0; half < frames * 2; ++half) {
+        for (struct hookRun &run : runs) run.machine.runHalfFrame();
+
+        struct Registers8080 interpreted = runs[0].emulator->getRegisters();
+        struct Registers8080 hooked = runs[1].emulator->getRegisters();
+        bool isSame = 
+            (runs[0].machine.getCycles() == runs[1].machine.getCycles())
+            && (
+                runs[0].emulator->getInstructionCount() 
+                == runs[1].emulator->getInstructionCount()
+            )
+            && (interpreted.getBC() == hooked.getBC())
+            && (interpreted.getDE() == hooked.getDE())
+            && (interpreted.getHL() == hooked.getHL())
+            && (interpreted.a == hooked.a)
+            && (interpreted.getFlags() == hooked.getFlags())
+            && (interpreted.sp == hooked.sp)
+            && (interpreted.pc == hooked.pc);
+        for (int i = 0x2000; isSame && (i < 0x4000); ++i) {
+            isSame = runs[0].memory.read(i) == runs[1].memory.read(i);
+        }
+        if (!isSame) return half;
+    }
+    return -1;
+}
+
 
 /*
  * Invoke parser from TCLAP library to process the command line
@@ -267,7 +806,11 @@ std::unique_ptr <struct disassembleArguments> parseArguments(
 ) {
     std::string romFileName;
     std::string commmandName;
+    std::string coreName;
     bool isCpm;
+    bool isCompare;
+    int benchFrames;
+    int benchRepeats;
     try {
         // TCLAP Parser
         TCLAP::CmdLine cmd(
@@ -283,6 +826,10 @@ std::unique_ptr <struct disassembleArguments> parseArguments(
         commands.push_back("disassemble");
         commands.push_back("debug");
         commands.push_back("run");
+        commands.push_back("bench");
+        commands.push_back("alutables");
+        commands.push_back("hooks");
+        commands.push_back("render");
         TCLAP::ValuesConstraint<std::string> commandValues(commands);
         TCLAP::UnlabeledValueArg<std::string> commandArg(
             "command",
@@ -312,11 +859,63 @@ std::unique_ptr <struct disassembleArguments> parseArguments(
         );
         cmd.add(cpm);
 
+        // choose the opcode dispatch core used by debug/run
+        std::vector<std::string> cores;
+        cores.push_back("table");
+        cores.push_back("switch");
+        cores.push_back("block");
+        TCLAP::ValuesConstraint<std::string> coreValues(cores);
+        TCLAP::ValueArg<std::string> core(
+            "k",
+            "core",
+            "opcode dispatch core for debug/run",
+            false,
+            "table",
+            &coreValues
+        );
+        cmd.add(core);
+
+        // switch to time both cores on a cp/m program
+        TCLAP::SwitchArg compare(
+            "m",
+            "compare",
+            "run: also time the table core and the faster core silently and report the gain",
+            false
+        );
+        cmd.add(compare);
+
+        // length of the benchmark run
+        TCLAP::ValueArg<int> frames(
+            "f",
+            "frames",
+            "bench/alutables/hooks/render: number of Space "
+                "Invaders frames to run",
+            false,
+            2000,
+            "int"
+        );
+        cmd.add(frames);
+
+        // number of times a cp/m program is run per core
+        TCLAP::ValueArg<int> repeats(
+            "r",
+            "repeat",
+            "bench -c: number of runs of the cp/m program per core",
+            false,
+            1,
+            "int"
+        );
+        cmd.add(repeats);
+
         // Run the parser and extract the values
         cmd.parse(argumentCount, argumentVector);
         romFileName = romFileNameArg.getValue();
         commmandName = commandArg.getValue();
+        coreName = core.getValue();
         isCpm = cpm.getValue();
+        isCompare = compare.getValue();
+        benchFrames = frames.getValue();
+        benchRepeats = repeats.getValue();
     } 
     catch (TCLAP::ArgException &e){ 
         // if something went wrong, print an error message and return nullptr
@@ -334,5 +933,436 @@ std::unique_ptr <struct disassembleArguments> parseArguments(
     args->romFileName = romFileName;
     args->commandName = commmandName;
     args->isCpmMode = isCpm;
+    if (coreName == "switch") {
+        args->dispatchCore = Emulator8080::SWITCH;
+    } else if (coreName == "block") {
+        args->dispatchCore = Emulator8080::BLOCK;
+    } else {
+        args->dispatchCore = Emulator8080::TABLE;
+    }
+    args->isCompareMode = isCompare;
+    args->benchFrames = benchFrames;
+    args->benchRepeats = benchRepeats;
     return args;
-}
\ No newline at end of file
+}
+
+/*
+ * Run every ALU instruction with every accumulator, operand and AC/CY
+ * combination on the table core (flag helpers) and the switch core
+ * (ALU_TABLES) and compare the results. Returns the number of mismatches.
+ */
+long checkAluTables() {
+    // ADI ACI SUI SBI CPI ANI XRI ORI take the operand as an immediate,
+    // INR A, DCR A and DAA only use the accumulator
+    const std::vector<uint8_t> immediateOpcodes = {
+        0xc6, 0xce, 0xd6, 0xde, 0xfe, 0xe6, 0xee, 0xf6
+    };
+    const std::vector<uint8_t> accumulatorOpcodes = {0x3c, 0x3d, 0x27};
+    const uint16_t STACK = 0x8000;
+
+    // LXI SP,STACK; POP PSW loads A and the flags, then the instruction
+    std::vector<uint8_t> image(0x10000, 0x00);
+    image[0] = 0x31;
+    image[1] = STACK & 0xff;
+    image[2] = STACK >> 8;
+    image[3] = 0xf1;
+    Memory referenceMemory(std::make_unique<std::vector<uint8_t>>(image));
+    Memory tableMemory(std::make_unique<std::vector<uint8_t>>(image));
+    Emulator8080 reference(&referenceMemory, Emulator8080::TABLE);
+    Emulator8080 table(&tableMemory, Emulator8080::SWITCH);
+
+    long mismatches = 0;
+    auto check = [&](uint8_t opcode, int a, int operand, int carries) {
+        // AC/CY from carries, the other flags vary with a
+        uint8_t flags = 0x02 | ((carries & 0b10) ? 0x10 : 0x00)
+            | ((carries & 0b01) ? 0x01 : 0x00) | ((a & 0x01) ? 0xc4 : 0x00);
+        for (Memory *memory : {&referenceMemory, &tableMemory}) {
+            memory->write(flags, STACK);
+            memory->write(a, STACK + 1);
+            memory->write(opcode, 0x0004);
+            memory->write(operand, 0x0005);
+        }
+        for (Emulator8080 *emulator : {&reference, &table}) {
+            emulator->reset(0x0000);
+            for (int i = 0; i < 3; ++i) emulator->step();
+        }
+        std::unique_ptr<struct State8080> expected = reference.getState();
+        std::unique_ptr<struct State8080> actual = table.getState();
+        if (
+            (expected->a != actual->a) 
+            || (expected->getFlags() != actual->getFlags())
+        ) {
+            if (mismatches < 10) {
+                std::cerr << std::hex << "opcode " << static_cast<int>(opcode)
+                    << " a " << a << " operand " << operand 
+                    << " carries " << carries << ": expected " 
+                    << static_cast<int>(expected->a) << "/" 
+                    << static_cast<int>(expected->getFlags()) << " got " 
+                    << static_cast<int>(actual->a) << "/" 
+                    << static_cast<int>(actual->getFlags()) 
+                    << std::dec << '\n';
+            }
+            ++mismatches;
+        }
+    };
+
+    for (int carries = 0; carries < 4; ++carries) {
+        for (int a = 0; a < 0x100; ++a) {
+            for (uint8_t opcode : accumulatorOpcodes) {
+                check(opcode, a, 0, carries);
+            }
+            for (int operand = 0; operand < 0x100; ++operand) {
+                for (uint8_t opcode : immediateOpcodes) {
+                    check(opcode, a, operand, carries);
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+/*
+ * Step a number of Space Invaders frames and report how many 64-byte
+ * lines of ALU_TABLES the arithmetic instructions touch. memory is the
+ * memory emulator is connected to.
+ */
+void measureAluTableLines(
+    Emulator8080 &emulator, SpaceInvaderMemory &memory, int frames
+) {
+    const unsigned long long HALF_FRAME_CYCLES = 16667;
+    const uint8_t RST1 = 0xcf;
+    const uint8_t RST2 = 0xd7;
+    const int LINE_BYTES = 64;
+    const uintptr_t tableStart = reinterpret_cast<uintptr_t>(&ALU_TABLES);
+
+    Adapter adapter;
+    adapter.setInputChanged(false);
+    Machine machine;
+    machine.setPlatformAdapter(&adapter);
+    machine.setEmulator(&emulator);
+
+    // lines touched, by the table the lookup went to
+    std::set<uintptr_t> addLines, subtractLines, smallLines;
+    unsigned long long lookups = 0;
+    unsigned long long cycles = 0;
+    bool isMidFrame = true;
+    for (int half = 0; half < frames * 2; ++half) {
+        unsigned long long target = (half + 1) * HALF_FRAME_CYCLES;
+        while (cycles < target) {
+            struct Registers8080 state = emulator.getRegisters();
+            uint8_t opcode = memory.read(state.pc);
+            // register operand from the low 3 bits, 6 is M
+            uint8_t registers[8] = {
+                state.b, state.c, state.d, state.e, 
+                state.h, state.l, 
+                memory.read((state.h << 8) | state.l), state.a
+            };
+            int carry = state.isFlag(State8080::CY) ? 1 : 0;
+            const void *entry = nullptr;
+            std::set<uintptr_t> *lines = &smallLines;
+            if ((opcode >= 0x80) && (opcode <= 0xbf)) {
+                uint8_t value = registers[opcode & 0x07];
+                switch (opcode & 0x38) {
+                    case 0x00: // ADD
+                        entry = &ALU_TABLES.add[0][state.a][value];
+                        lines = &addLines;
+                        break;
+                    case 0x08: // ADC
+                        entry = &ALU_TABLES.add[carry][state.a][value];
+                        lines = &addLines;
+                        break;
+                    case 0x10: // SUB
+                    case 0x38: // CMP
+                        entry = &ALU_TABLES.subtract[0][state.a][value];
+                        lines = &subtractLines;
+                        break;
+                    case 0x18: // SBB
+                        entry = 
+                            &ALU_TABLES.subtract[carry][state.a][value];
+                        lines = &subtractLines;
+                        break;
+                    default: // ANA XRA ORA
+                        entry = &ALU_TABLES.zsp[0];
+                        break;
+                }
+            } else {
+                uint8_t immediate = memory.read(state.pc + 1);
+                switch (opcode) {
+                    case 0xc6:
+                        entry = &ALU_TABLES.add[0][state.a][immediate];
+                        lines = &addLines;
+                        break;
+                    case 0xce:
+                        entry = &ALU_TABLES.add[carry][state.a][immediate];
+                        lines = &addLines;
+                        break;
+                    case 0xd6:
+                    case 0xfe:
+                        entry = 
+                            &ALU_TABLES.subtract[0][state.a][immediate];
+                        lines = &subtractLines;
+                        break;
+                    case 0xde:
+                        entry = 
+                            &ALU_TABLES.subtract[carry][state.a][immediate];
+                        lines = &subtractLines;
+                        break;
+                    case 0xe6:
+                    case 0xee:
+                    case 0xf6:
+                        entry = &ALU_TABLES.zsp[0];
+                        break;
+                    default:
+                        // INR/DCR r and M
+                        if ((opcode & 0xc6) == 0x04) {
+                            uint8_t value = registers[(opcode >> 3) & 0x07];
+                            entry = (opcode & 0x01) 
+                                ? &ALU_TABLES.decrement[value] 
+                                : &ALU_TABLES.increment[value];
+                        } else if (opcode == 0x27) {
+                            entry = &ALU_TABLES.decimalAdjust[0][0];
+                        }
+                        break;
+                }
+            }
+            if (entry != nullptr) {
+                ++lookups;
+                lines->insert(
+                    (reinterpret_cast<uintptr_t>(entry) - tableStart) 
+                    / LINE_BYTES
+                );
+            }
+            int used = emulator.step();
+            if (used == 0) break; // halted until the next interrupt
+            cycles += used;
+        }
+        if (cycles < target) cycles = target;
+        if (emulator.isInterruptEnable()) {
+            cycles += emulator.requestInterrupt(isMidFrame ? RST1 : RST2);
+        }
+        isMidFrame = !isMidFrame;
+    }
+
+    size_t lines = addLines.size() + subtractLines.size() + smallLines.size();
+    std::cout << std::dec << frames << " Space Invaders frames: " << lookups 
+        << " table lookups touched " << lines << " lines of " 
+        << LINE_BYTES << " bytes (" << (lines * LINE_BYTES) << " bytes)." 
+        << std::endl;
+    std::cout << "  add: " << addLines.size() << " lines, subtract: " 
+        << subtractLines.size() << " lines, zsp/inr/dcr/daa: " 
+        << smallLines.size() << " lines." << std::endl;
+}
+
+
+/*
+ * Draw video RAM the way DrawScreen did, see declaration
+ */
+void renderReference(const Memory &memory, uint8_t *pixels) {
+    const int WIDTH = VideoRenderer::WIDTH;
+    const int HEIGHT = VideoRenderer::HEIGHT;
+    auto foreground = [](int row, int column) {
+        if (
+            (row <= 32) || ((row > 64) && (row <= 184)) 
+            || ((row > 240) && ((column <= 15) || (column > 134)))
+        ) {
+            return VideoRenderer::COLOR_WHITE;
+        } else if ((row > 32) && (row <= 64)) {
+            return VideoRenderer::COLOR_MAGENTA;
+        } 
+        return VideoRenderer::COLOR_GREEN;
+    };
+    int row = HEIGHT - 1;
+    int column = 0;
+    for (int i = 0x2400; i < 0x4000; ++i) {
+        uint8_t bitBlock = memory.read(i);
+        for (int bit = 0; bit < 8; ++bit) {
+            pixels[row * WIDTH + column] = ((bitBlock >> bit) & 0x1) 
+                ? foreground(row, column) 
+                : VideoRenderer::COLOR_BLACK;
+            --row;
+        }
+        if (row < 0) {
+            row = HEIGHT - 1;
+            column += 1;
+        }
+    }
+}
+
+/*
+ * Check and time VideoRenderer, see declaration
+ */
+bool benchVideoRenderer(const SpaceInvaderMemory &memory) {
+    const int REPEATS = 2000;
+    const int PIXELS = VideoRenderer::WIDTH * VideoRenderer::HEIGHT;
+    const uint32_t palette[VideoRenderer::NUMBER_OF_COLORS] = {
+        0x00000000, 0x00ffffff, 0x00ff1144, 0x00139d08
+    };
+    VideoRenderer renderer;
+    renderer.setPalette(palette);
+    const uint8_t *const *videoStrips = memory.getVideoStrips();
+    std::vector<uint8_t> reference(PIXELS);
+    std::vector<uint8_t> indexed(PIXELS);
+    std::vector<uint32_t> colored(PIXELS);
+
+    // both outputs must match the reference pixel for pixel
+    renderReference(memory, reference.data());
+    renderer.render8(videoStrips, indexed.data());
+    renderer.render32(videoStrips, colored.data());
+    long lit = 0;
+    long mismatches = 0;
+    for (int i = 0; i < PIXELS; ++i) {
+        if (reference[i] != VideoRenderer::COLOR_BLACK) ++lit;
+        if (indexed[i] != reference[i]) ++mismatches;
+        if (colored[i] != palette[reference[i]]) ++mismatches;
+    }
+    std::cout << "  " << lit << " lit pixels, " << mismatches 
+        << " mismatches against the reference." << std::endl;
+
+    // time each conversion; a checksum keeps the work from being dropped
+    unsigned long checksum = 0;
+    auto timeRenderer = [&](const std::string &name, std::function<void()> render) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < REPEATS; ++i) {
+            render();
+            checksum += reference[i % PIXELS] + indexed[(i * 7) % PIXELS]
+                + colored[(i * 13) % PIXELS];
+        }
+        auto stopTime = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::micro> runTime = 
+            stopTime - startTime;
+        std::cout << std::left << std::setfill(' ') << std::setw(30) 
+            << ("  " + name + ":") << (runTime.count() / REPEATS) 
+            << " us per frame" << std::endl;
+    };
+    timeRenderer("reference, 8bpp", [&]() {
+        renderReference(memory, reference.data());
+    });
+    timeRenderer("VideoRenderer, 8bpp", [&]() {
+        renderer.render8(videoStrips, indexed.data());
+    });
+    timeRenderer("VideoRenderer, 32bpp", [&]() {
+        renderer.render32(videoStrips, colored.data());
+    });
+    std::cout << std::setw(30) << "" << "(checksum " << checksum << ")" 
+        << std::endl;
+    return mismatches == 0;
+}
+
+/*
+ * Compare incremental and full redraws over a run, see declaration
+ */
+bool benchIncrementalRendering(const std::vector<uint8_t> &image, int frames) {
+    const int PIXELS = VideoRenderer::WIDTH * VideoRenderer::HEIGHT;
+    InvadersCabinet cabinet(image, Emulator8080::BLOCK);
+    SpaceInvaderMemory &memory = *cabinet.memory;
+    Adapter &adapter = cabinet.adapter;
+    Machine &machine = cabinet.machine;
+    machine.setTurbo(true);
+    machine.setVideoMemory(&memory);
+    machine.setRenderPolicy(Machine::RENDER_ON_VRAM_CHANGE);
+
+    VideoRenderer renderer;
+    const uint8_t *const *videoStrips = memory.getVideoStrips();
+    std::vector<uint8_t> incremental(PIXELS);
+    std::vector<uint8_t> full(PIXELS);
+    long strips = 0;
+    long mismatches = 0;
+    double incrementalMicroseconds = 0.0;
+    double fullMicroseconds = 0.0;
+    adapter.setRefreshScreenFunction([&]() {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        strips += renderer.update8(
+            videoStrips, memory.takeDirtyColumns(), incremental.data()
+        );
+        auto middleTime = std::chrono::high_resolution_clock::now();
+        renderer.render8(videoStrips, full.data());
+        auto stopTime = std::chrono::high_resolution_clock::now();
+        incrementalMicroseconds += std::chrono::duration<double, std::micro>(
+            middleTime - startTime
+        ).count();
+        fullMicroseconds += std::chrono::duration<double, std::micro>(
+            stopTime - middleTime
+        ).count();
+        if (incremental != full) ++mismatches;
+    });
+    for (int half = 0; half < frames * 2; ++half) machine.step();
+
+    unsigned long long changed = machine.getFramesRendered();
+    std::cout << "Dirty columns over " << std::dec << frames << " frames: "
+        << changed << " frames changed, " << mismatches 
+        << " differ from a full redraw." << std::endl;
+    if (changed > 0) {
+        std::cout << "  " << std::setprecision(3) 
+            << (static_cast<double>(strips) / changed) 
+            << " of 28 strips redrawn per changed frame, " 
+            << (incrementalMicroseconds / changed) << " us against " 
+            << (fullMicroseconds / changed) << " us for a full redraw." 
+            << std::setprecision(6) << std::endl;
+    }
+    return mismatches == 0;
+}
+
+/*
+ * Check split rendering against full redraws, see declaration
+ */
+bool benchSplitRendering(const std::vector<uint8_t> &image, int frames) {
+    const int PIXELS = VideoRenderer::WIDTH * VideoRenderer::HEIGHT;
+    InvadersCabinet cabinet(image, Emulator8080::BLOCK);
+    SpaceInvaderMemory &memory = *cabinet.memory;
+    Adapter &adapter = cabinet.adapter;
+    Machine &machine = cabinet.machine;
+    machine.setTurbo(true);
+    machine.setVideoMemory(&memory);
+    machine.setSplitRendering(true);
+
+    VideoRenderer renderer;
+    std::vector<uint8_t> split(PIXELS);
+    std::vector<uint8_t> reference(PIXELS);
+    std::vector<uint8_t> whole(PIXELS);
+    std::vector<uint8_t> full(PIXELS);
+    long mismatches = 0;
+    long torn = 0;
+    long halves = 0;
+    double halfMicroseconds = 0.0;
+    adapter.setRenderColumnsFunction(
+        [&](const uint8_t *const *videoStrips, int firstColumn, int columns) {
+            auto startTime = std::chrono::high_resolution_clock::now();
+            renderer.update8(
+                videoStrips, memory.takeDirtyColumns(firstColumn, columns), 
+                split.data()
+            );
+            auto stopTime = std::chrono::high_resolution_clock::now();
+            halfMicroseconds += std::chrono::duration<double, std::micro>(
+                stopTime - startTime
+            ).count();
+            ++halves;
+            // the same columns of a full redraw make up the reference,
+            // and the first half's full redraw is the unsplit frame
+            renderer.render8(videoStrips, full.data());
+            if (firstColumn == 0) whole = full;
+            for (int row = 0; row < VideoRenderer::HEIGHT; ++row) {
+                int offset = row * VideoRenderer::WIDTH + firstColumn;
+                std::copy(
+                    full.begin() + offset, full.begin() + offset + columns,
+                    reference.begin() + offset
+                );
+            }
+        }
+    );
+    adapter.setRefreshScreenFunction([&]() {
+        if (split != reference) ++mismatches;
+        if (split != whole) ++torn;
+    });
+    for (int half = 0; half < frames * 2; ++half) machine.step();
+
+    std::cout << "Split rendering over " << std::dec << frames << " frames: "
+        << mismatches << " differ from the halves redrawn in full, " 
+        << torn << " differ from one redraw at the RST1 boundary." 
+        << std::endl;
+    if (halves > 0) {
+        std::cout << "  " << std::setprecision(3) 
+            << (halfMicroseconds / halves) << " us per half screen." 
+            << std::setprecision(6) << std::endl;
+    }
+    return mismatches == 0;
+}
@@ -8,28 +8,78 @@
 #include "processor.hpp"
 #include "emulator.hpp"
 #include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <atomic>
 #include "snapshot.h"
+#include "aluTables.hpp"
+
+// immediate operand of the instruction at pc on the switch core. the arms
+// read only the bytes they use, when they use them: nothing is fetched
+// ahead, and a conditional jump not taken reads nothing
+template<class memoryType>
+struct BusOperand8080 {
+    memoryType &bus;
+    uint16_t pc;
+    uint8_t byte() const { return bus.read(pc + 1); }
+    uint16_t word() const {
+        return bus.read(pc + 1) | (bus.read(pc + 2) << 8);
+    }
+};
+
+// immediate operand decoded ahead of time, as the block core keeps it
+struct DecodedOperand8080 {
+    uint16_t value;
+    uint8_t byte() const { return static_cast<uint8_t>(value); }
+    uint16_t word() const { return value; }
+};
 
 // Build an Emulator8080 with no memory attached
-Emulator8080::Emulator8080() {
+Emulator8080::Emulator8080(Emulator8080::core dispatchCore) {
     this->memory = nullptr;
+    this->dispatchCore = dispatchCore;
     this->reset(0x0000);
-    this->buildMap();
+    // the switch core does not use the lookup table
+    if (dispatchCore == TABLE) this->buildMap();
+    // only the block core caches decoded blocks
+    if (dispatchCore == BLOCK) {
+        this->blockCache = std::make_unique<BlockCache8080>();
+    }
     this->enableInterrupts = false;
     this->outputCallback = nullptr;
     this->inputCallback = nullptr;
     this->halted = false;
+    this->instructionCount = 0;
+    this->hookCycles = 0;
+    this->isSpinDetection = true;
+    this->spinCycles = 0;
+    this->idleCycles = 0;
+    this->batchCycles = 0;
 }
 
 // Build an emulator with attached memory device
-Emulator8080::Emulator8080(Memory *memoryDevice) {
+Emulator8080::Emulator8080(
+    Memory *memoryDevice, Emulator8080::core dispatchCore
+) {
     this->connectMemory(memoryDevice);
+    this->dispatchCore = dispatchCore;
     this->reset(0x0000);
-    this->buildMap();
+    // the switch core does not use the lookup table
+    if (dispatchCore == TABLE) this->buildMap();
+    // only the block core caches decoded blocks
+    if (dispatchCore == BLOCK) {
+        this->blockCache = std::make_unique<BlockCache8080>();
+    }
     this->enableInterrupts = false;
     this->outputCallback = nullptr;
     this->inputCallback = nullptr;
     this->halted = false;
+    this->instructionCount = 0;
+    this->hookCycles = 0;
+    this->isSpinDetection = true;
+    this->spinCycles = 0;
+    this->idleCycles = 0;
+    this->batchCycles = 0;
 }
 
 // connect a callback for the OUT instruction
@@ -46,6 +96,38 @@ void Emulator8080::connectInput(std::function<uint8_t(uint8_t)> inputFunction) {
     this->inputCallback = inputFunction;
 }
 
+// register a native hook, replacing any at the same address
+void Emulator8080::registerHook(uint16_t address, NativeHook8080 hook) {
+    if (hookSlots.empty()) hookSlots.assign(0x10000, 0);
+    if (hookSlots[address]) {
+        hooks[hookSlots[address] - 1] = hook;
+    } else if (hooks.size() < 0xff) {
+        hooks.push_back(hook);
+        hookSlots[address] = static_cast<uint8_t>(hooks.size());
+    } else {
+        throw std::length_error("too many native hooks");
+    }
+}
+
+// remove every native hook
+void Emulator8080::clearHooks() {
+    hooks.clear();
+    hookSlots.clear();
+}
+
+// run the hook registered at pc
+int Emulator8080::callHook(int budget, unsigned long long &instructions) {
+    int cycles = hooks[hookSlots[state.pc] - 1](
+        state.registers(), *memory, budget, instructions
+    );
+    hookCycles += cycles;
+    // hooks store through Memory, which the block core does not watch
+    if ((cycles > 0) && blockCache && blockCache->hasWritableCode()) {
+        flushBlockCache();
+    }
+    return cycles;
+}
+
 // empty destructor
 Emulator8080::~Emulator8080() {
 
@@ -60,8 +142,21 @@ void Emulator8080::reset(uint16_t address) {
 // fetch, decode, and execute a single instruction
 int Emulator8080::step() {
     if (!halted) {
+        ++instructionCount;
         // fetch
         uint8_t opcodeWord = fetch(state.pc);
+        if (dispatchCore == SWITCH) {
+            // decode and execute in one flat dispatch
+            return executeSwitch(
+                *memory, opcodeWord, BusOperand8080<Memory>{*memory, state.pc}
+            );
+        }
+        if (dispatchCore == BLOCK) {
+            // single steps bypass the cache but still invalidate it
+            return executeWatched(
+                *memory, opcodeWord, fetchOperand(*memory, opcodeWord)
+            );
+        }
         // decode
         auto opcodeFunction = decode(opcodeWord);
         // execute
@@ -71,6 +166,64 @@ int Emulator8080::step() {
     }
 }
 
+// true for OUT and IN, whose callbacks may ask for getBatchCycles()
+static inline bool isPortOpcode(uint8_t opcode) {
+    return (opcode | 0x08) == 0xdb;
+}
+
+// format an address the way memory errors report it
+static std::string formatAddress(uint16_t address) {
+    std::stringstream badAddress;
+    badAddress << "$" 
+        << std::setw(4) << std::hex << std::setfill('0')
+        << static_cast<int>(address);
+    return badAddress.str();
+}
+
+// end a batch after cycles of budget were used. a halted processor that
+// an interrupt can wake waits out the rest of the budget, which is the
+// time left until the caller's next interrupt
+inline int Emulator8080::idleUntil(int cycles, int budget) {
+    this->batchCycles = 0;
+    if (this->halted && this->enableInterrupts && (cycles < budget)) {
+        this->idleCycles += budget - cycles;
+        return budget;
+    }
+    return cycles;
+}
+
+// run a batch of instructions, see emulator.hpp
+// the try block is set up once per batch, not once per instruction
+int Emulator8080::runCycles(int budget) {
+    if (dispatchCore == SWITCH) {
+        return runSwitch(*memory, budget);
+    }
+    if (dispatchCore == BLOCK) {
+        return runBlocks(*memory, budget);
+    }
+    int cycles = 0;
+    unsigned long long instructions = 0;
+    try {
+        while ((cycles < budget) && !halted) {
+            if (isHooked(state.pc)) {
+                int used = callHook(budget - cycles, instructions);
+                cycles += used;
+                if (used > 0) continue;
+            }
+            // call straight into the table instead of copying the callable
+            uint8_t opcode = memory->read(state.pc);
+            if (isPortOpcode(opcode)) batchCycles = cycles;
+            cycles += opcodes[opcode]();
+            ++instructions;
+        }
+    } catch (const std::out_of_range& oor) {
+        instructionCount += instructions;
+        throw MemoryReadError(formatAddress(state.pc));
+    }
+    instructionCount += instructions;
+    return idleUntil(cycles, budget);
+}
+
 // read an opcode in from memory
 uint8_t Emulator8080::fetch(uint16_t address) {
     try { 
@@ -2765,283 +2918,1770 @@ void Emulator8080::buildMap() {
         };
 }
 
-// read an address stored starting at atAddress
-// accounts for little-endian storage model
-uint16_t Emulator8080::readAddressFromMemory(uint16_t atAddress) {
-    uint16_t lsb = this->memory->read(atAddress);
-    uint16_t msb = this->memory->read(atAddress + 1) << 8;
-    return msb + lsb;
+// number of bytes in each 8080 instruction, indexed by opcode
+// undocumented opcodes use the length of the instruction they alias
+static const uint8_t INSTRUCTION_LENGTH[0x100] = {
+//  0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f
+    1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x00
+    1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x10
+    1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1, // 0x20
+    1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1, // 0x30
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x50
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x70
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x90
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xa0
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xb0
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 3, 3, 3, 2, 1, // 0xc0
+    1, 1, 3, 2, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // 0xd0
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1, // 0xe0
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1  // 0xf0
+};
+
+// read the immediate operand of the instruction at pc
+// 1-byte instructions have no operand and return 0
+template<class memoryType>
+uint16_t Emulator8080::fetchOperand(memoryType &bus, uint8_t opcode) {
+    switch (INSTRUCTION_LENGTH[opcode]) {
+        case 2:
+            return bus.read(this->state.pc + 1);
+        case 3:
+            return bus.read(this->state.pc + 1) 
+                | (bus.read(this->state.pc + 2) << 8);
+        default:
+            return 0x0000;
+    }
 }
 
-// set up return address on stack and set jump address
-// pushes the current address on the stack, then sets the program counter to
-// an argument, address. isReset governs which address is pushed->
-// false, pc = next instruction; true, pc = current instruction
-void Emulator8080::callAddress(uint16_t address, bool isReset) {
+// push the pc and jump, as callAddress() but through a concrete memory
+template<class memoryType>
+void Emulator8080::callAddress(
+    memoryType &bus, uint16_t address, bool isReset
+) {
     // advance pc to next instruction if this is not a RST
     if (!isReset) {
         this->state.pc += 3;
     }
-    // push high byte of next pc
-    --this->state.sp;
-    this->memory->write(
-        static_cast<uint8_t>((this->state.pc & 0xFF00) >> 8),
-        this->state.sp
-    );
-    // push low byte of next pc
-    --this->state.sp;
-    this->memory->write(
-        static_cast<uint8_t>(this->state.pc & 0x00FF),
-        this->state.sp
-    );
-    // go to call address next  
+    bus.write(static_cast<uint8_t>(this->state.pc >> 8), --this->state.sp);
+    bus.write(static_cast<uint8_t>(this->state.pc & 0xff), --this->state.sp);
     this->state.pc = address;
 }
 
-// pair the BC registers into a 2-byte value
-uint16_t Emulator8080::getBC() {
-    uint16_t msb = this->state.b << 8;
-    uint16_t lsb = this->state.c;
-    return msb + lsb;
-}
-
-// pair the DE registers into a 2-byte value
-uint16_t Emulator8080::getDE() {
-    uint16_t msb = this->state.d << 8;
-    uint16_t lsb = this->state.e;
-    return msb + lsb;
+// pop the pc, as ret() but through a concrete memory
+template<class memoryType>
+int Emulator8080::ret(memoryType &bus) {
+    uint16_t lsb = bus.read(this->state.sp);
+    uint16_t msb = bus.read(this->state.sp + 1) << 8;
+    this->state.sp += 2;
+    this->state.pc = msb + lsb;
+    return 10;
 }
 
-// pair the HL registers into a 2-byte value
-uint16_t Emulator8080::getHL() {
-    uint16_t msb = this->state.h << 8;
-    uint16_t lsb = this->state.l;
-    return msb + lsb;
+// evaluate the condition field (bits 3-5) of a conditional opcode
+// 000 NZ, 001 Z, 010 NC, 011 C, 100 PO, 101 PE, 110 P, 111 M
+// bits 4-5 pick the flag, bit 3 whether it must be set
+inline bool Emulator8080::testCondition(uint8_t opcode) {
+    static const uint8_t CONDITION_FLAGS[4] = {
+        State8080::flagMasks[State8080::Z], 
+        State8080::flagMasks[State8080::CY],
+        State8080::flagMasks[State8080::P], 
+        State8080::flagMasks[State8080::S]
+    };
+    bool isSet = 
+        (this->state.getFlags() & CONDITION_FLAGS[(opcode >> 4) & 0x03]) != 0;
+    return isSet == static_cast<bool>(opcode & 0x08);
 }
 
-// determine state of Z[ero] flag
-void Emulator8080::updateZeroFlag(uint8_t value) {
-    if ( value == 0x00 ) { // compare to zero
-        this->state.setFlag(State8080::Z);
-    } else {
-        this->state.unSetFlag(State8080::Z);
-    }
-}
+// S Z AC P CY, the flags arithmetic and logic instructions change
+static const uint8_t ARITHMETIC_FLAGS = 0b1101'0101;
+// the flags INR/DCR change, all but CY
+static const uint8_t INCREMENT_FLAGS = 0b1101'0100;
 
-// determine state of S[ign] flag
-void Emulator8080::updateSignFlag(uint8_t value) {
-    if ( value & 0x80 ) { // 0b1000'0000
-        this->state.setFlag(State8080::S);
-    } else {
-        this->state.unSetFlag(State8080::S);
-    }
+// ADD/ADC: accumulator + addend (+ CY), set Z S P CY AC flags
+inline uint8_t Emulator8080::lookupAdd(uint8_t addend, bool withCarry) {
+    uint16_t entry = ALU_TABLES.add
+        [withCarry && this->state.isFlag(State8080::CY)]
+        [this->state.a][addend];
+    this->state.replaceFlags(entry >> 8, ARITHMETIC_FLAGS);
+    return entry & 0xff;
 }
 
-// determine state of P[arity] flag
-void Emulator8080::updateParityFlag(uint8_t value) {
-    // parity algorithm: https://www.freecodecamp.org/news/algorithmic-problem-solving-efficiently-computing-the-parity-of-a-stream-of-numbers-cd652af14643/
-    value ^= value >> 4;
-    value ^= value >> 2;
-    value ^= value >> 1;
-    if ( value & 0x01 ) { // 0b0000'0001
-        this->state.unSetFlag(State8080::P); // odd parity
-    } else {
-        this->state.setFlag(State8080::P); // even parity
-    }
+// SUB/SBB/CMP: accumulator - subtrahend (- CY), set Z S P CY AC flags
+inline uint8_t Emulator8080::lookupSubtract(
+    uint8_t subtrahend, bool withCarry
+) {
+    uint16_t entry = ALU_TABLES.subtract
+        [withCarry && this->state.isFlag(State8080::CY)]
+        [this->state.a][subtrahend];
+    this->state.replaceFlags(entry >> 8, ARITHMETIC_FLAGS);
+    return entry & 0xff;
 }
 
-// decrement a value, set Z S P AC flags
-uint8_t Emulator8080::decrementValue(uint8_t value) {
-	// AC flag set based on low nibble add, (-1) is 0b1111 2's complement
-	// therefore AC will be set (carry out of low nibble) unless low nibble
-	// of operand is 0b0000
-	if ((value & 0x0f) != 0x00) {
-		this->state.setFlag(State8080::AC);
-	}
-	else {
-		this->state.unSetFlag(State8080::AC);
-	}
-    --value; 
-    // set flags based on result of operation
-    this->updateZeroFlag(value);
-    this->updateSignFlag(value);
-    this->updateParityFlag(value);
-
-    //this->state.unSetFlag(State8080::AC);
-    return value; // return the decremented value
+// INR: value + 1, set Z S P AC flags
+inline uint8_t Emulator8080::lookupIncrement(uint8_t value) {
+    this->state.replaceFlags(ALU_TABLES.increment[value], INCREMENT_FLAGS);
+    return value + 1;
 }
 
-// increment a value, set Z S P AC flags
-uint8_t Emulator8080::incrementValue(uint8_t value) {
-    // only operand low nibble of 0b1111 will result in carry out from low nibble
-	// from adding 0b0001
-	if ((value & 0x0f) == 0x0f) {
-		this->state.setFlag(State8080::AC);
-	} else {
-		this->state.unSetFlag(State8080::AC);
-	}
-    ++value; 
-    // set flags based on result of operation
-    this->updateZeroFlag(value);
-    this->updateSignFlag(value);
-    this->updateParityFlag(value);
-
-    //this->state.unSetFlag(State8080::AC);
-    return value; // return the decremented value
+// DCR: value - 1, set Z S P AC flags
+inline uint8_t Emulator8080::lookupDecrement(uint8_t value) {
+    this->state.replaceFlags(ALU_TABLES.decrement[value], INCREMENT_FLAGS);
+    return value - 1;
 }
 
-// subtract subtrahend from minuend, set Z, S, P, CY, AC flags
-// return minuend - subtrahend
-uint8_t Emulator8080::subtractValues(
-    uint8_t minuend, uint8_t subtrahend, bool withCarry
-) {
-    // set up carry bit
-    uint8_t carryBit = 0;
-    if (withCarry && this->state.isFlag(State8080::CY)) carryBit = 1;
-
-    // check aux carry (https://www.reddit.com/r/EmuDev/comments/p8b4ou/8080_decrement_sub_wrappingzero_question/)
-    // do operation on low nibble, see if something propagated to the high
-    if (!(((minuend & 0x0f) - (subtrahend & 0x0f) - carryBit) & 0xf0)) {
-        this->state.setFlag(State8080::AC);
-    } else {
-        this->state.unSetFlag(State8080::AC);
-    }
-    // do the subtraction upcast to uint16_t in order to capture carry bit
-    uint16_t result = minuend - subtrahend - carryBit;
-    // get the 1-byte difference
-    uint8_t difference = result & 0x00ff;
-    // set flags based on result of operation
-    this->updateZeroFlag(difference);
-    this->updateSignFlag(difference);
-    this->updateParityFlag(difference);
-
-    // AC flag only set for addition
-    //this->state.unSetFlag(State8080::AC);
-
-    // determine state of carry flag
-    if (result & 0x0100) { //0b0000'0001'0000'0000 mask
-        this->state.setFlag(State8080::CY);
-    } else {
-        this->state.unSetFlag(State8080::CY);
-    }
-
-    return difference;
+// ANA/ANI: AC is bit 3 of either operand, CY is cleared
+inline uint8_t Emulator8080::lookupAnd(uint8_t value) {
+    uint8_t result = this->state.a & value;
+    this->state.replaceFlags(
+        ALU_TABLES.zsp[result] | (((this->state.a | value) << 1) & 0x10),
+        ARITHMETIC_FLAGS
+    );
+    return result;
 }
 
-// add a 2-byte addend to HL and store the result in HL
-// set the CY flag if necessary
-void Emulator8080::doubleAddWithHLIntoHL(uint16_t addend) {
-    // upcast to 4-byte to capture carry bit
-    uint32_t result = this->getHL() + addend;
-    // get the 2-byte sum
-    uint16_t sum = result & 0x0000ffff;
-    // store sum in HL
-    this->state.h = (sum & 0xff00) >> 8;
-    this->state.l = sum & 0x00ff;
-    // determine state of carry flag
-    if (result & 0x00010000) { //0b0000'0000'0000'0001'0000'0000'0000'0000 mask
-        this->state.setFlag(State8080::CY);
-    } else {
-        this->state.unSetFlag(State8080::CY);
-    }
+// ORA/ORI: AC and CY are cleared
+inline uint8_t Emulator8080::lookupOr(uint8_t value) {
+    uint8_t result = this->state.a | value;
+    this->state.replaceFlags(ALU_TABLES.zsp[result], ARITHMETIC_FLAGS);
+    return result;
 }
 
-// return the bitwise and of a value and the accumulator (a register)
-// set Z S P CY AC flags
-uint8_t Emulator8080::andWithAccumulator(uint8_t value) {
-    // http://bitsavers.trailing-edge.com/components/intel/MCS80/9800301D_8080_8085_Assembly_Language_Programming_Manual_May81.pdf
-    // page 1-12 for aux carry
-    //check aux carry (https://www.reddit.com/r/EmuDev/comments/p8b4ou/8080_decrement_sub_wrappingzero_question/)
-    if ((this->state.a & 0b0000'1000) | (value & 0b0000'1000)) {
-        this->state.setFlag(State8080::AC);
-    } else {
-        this->state.unSetFlag(State8080::AC);
-    }
-    uint8_t result = this->state.a & value; 
-    //update flags
-    this->updateZeroFlag(result);
-    this->updateSignFlag(result);
-    this->updateParityFlag(result);
-    this->state.unSetFlag(State8080::CY);
-
+// XRA/XRI: AC and CY are cleared
+inline uint8_t Emulator8080::lookupXor(uint8_t value) {
+    uint8_t result = this->state.a ^ value;
+    this->state.replaceFlags(ALU_TABLES.zsp[result], ARITHMETIC_FLAGS);
     return result;
 }
 
+// DAA: adjust the accumulator to two BCD digits, set Z S P CY AC flags
+inline uint8_t Emulator8080::lookupDecimalAdjust() {
+    uint16_t entry = ALU_TABLES.decimalAdjust
+        [(this->state.isFlag(State8080::AC) << 1) 
+            | this->state.isFlag(State8080::CY)]
+        [this->state.a];
+    this->state.replaceFlags(entry >> 8, ARITHMETIC_FLAGS);
+    return entry & 0xff;
+}
 
-// return the sum an addend and the accumulator (a register)
-// additionally adding the carry bit
-// set Z S P CY AC flags
-uint8_t Emulator8080::addWithAccumulator(uint8_t addend, bool withCarry) {
-    // do addition upcast to capture carry bit
-    uint16_t result = this->state.a + addend;
-    if (this->state.isFlag(State8080::CY) && withCarry) ++result;
+// execute one instruction through a flat switch over all 256 opcodes.
+// operand gives the immediate byte() or little-endian word() following
+// the opcode, see BusOperand8080 and DecodedOperand8080. Behaviour and cycle counts match the
+// lambdas installed by buildMap() opcode for opcode; the 8-bit arithmetic
+// goes through the lookup* table helpers instead of the flag helpers.
+// memoryType is the type memory accesses are bound to: Memory goes through
+// the virtual interface, a final class such as SpaceInvaderMemory is called
+// (and inlined) directly.
+template<class memoryType, class operandType>
+int Emulator8080::executeSwitch(
+    memoryType &bus, uint8_t opcode, const operandType &operand
+) {
+    uint16_t temp;
 
-    uint8_t sum = result & 0x00ff; // extract 1-byte sum
+    switch (opcode) {
+        // NOP and undocumented NOPs
+        case 0x00: case 0x08: case 0x10: case 0x18:
+        case 0x20: case 0x28: case 0x30: case 0x38:
+            ++this->state.pc;
+            return 4;
 
-    // update flags
-    this->updateZeroFlag(sum);
-    this->updateSignFlag(sum);
-    this->updateParityFlag(sum);
-
-    // check AC flag since this is an add
-    // sum the low nibbles and see if this makes a carry into the high nibble
-    uint8_t nibbleSum = (this->state.a & 0x0f) + (addend & 0x0f);
-    if (this->state.isFlag(State8080::CY) && withCarry) ++nibbleSum;
-    if (0x10 & nibbleSum) { // low nibble sum
-        this->state.setFlag(State8080::AC);
-    } else {
-        this->state.unSetFlag(State8080::AC);
-    }
+        // LXI B/D/H/SP
+        case 0x01:
+            this->state.setBC(operand.word());
+            this->state.pc += 3;
+            return 10;
+        case 0x11:
+            this->state.setDE(operand.word());
+            this->state.pc += 3;
+            return 10;
+        case 0x21:
+            this->state.setHL(operand.word());
+            this->state.pc += 3;
+            return 10;
+        case 0x31:
+            this->state.sp = operand.word();
+            this->state.pc += 3;
+            return 10;
 
-    // determine state of carry flag
-    // do this last since other operations rely on the state of this flag
-    if (result & 0x0100) { //0b0000'0001'0000'0000 mask
-        this->state.setFlag(State8080::CY);
-    } else {
-        this->state.unSetFlag(State8080::CY);
-    }
+        // STAX B/D, LDAX B/D
+        case 0x02:
+            bus.write(this->state.a, this->getBC());
+            ++this->state.pc;
+            return 7;
+        case 0x12:
+            bus.write(this->state.a, this->getDE());
+            ++this->state.pc;
+            return 7;
+        case 0x0a:
+            this->state.a = bus.read(this->getBC());
+            ++this->state.pc;
+            return 7;
+        case 0x1a:
+            this->state.a = bus.read(this->getDE());
+            ++this->state.pc;
+            return 7;
 
-    return sum;
-}
+        // INX B/D/H/SP
+        case 0x03:
+            this->state.setBC(this->state.getBC() + 1);
+            ++this->state.pc;
+            return 5;
+        case 0x13:
+            this->state.setDE(this->state.getDE() + 1);
+            ++this->state.pc;
+            return 5;
+        case 0x23:
+            this->state.setHL(this->state.getHL() + 1);
+            ++this->state.pc;
+            return 5;
+        case 0x33:
+            ++this->state.sp;
+            ++this->state.pc;
+            return 5;
 
-// return the bitwise or of a value and the accumulator (a register)
-// set Z S P CY AC flags
-uint8_t Emulator8080::orWithAccumulator(uint8_t value) {
-    this->state.unSetFlag(State8080::CY);
-    this->state.unSetFlag(State8080::AC);
-    uint8_t result = value | this->state.a;
-    this->updateZeroFlag(result);
-    this->updateSignFlag(result);
-    this->updateParityFlag(result);
-    return result;
-}
+        // DCX B/D/H/SP
+        case 0x0b:
+            this->state.setBC(this->state.getBC() - 1);
+            ++this->state.pc;
+            return 5;
+        case 0x1b:
+            this->state.setDE(this->state.getDE() - 1);
+            ++this->state.pc;
+            return 5;
+        case 0x2b:
+            this->state.setHL(this->state.getHL() - 1);
+            ++this->state.pc;
+            return 5;
+        case 0x3b:
+            --this->state.sp;
+            ++this->state.pc;
+            return 5;
 
-// return the bitwise xor of a value and the accumulator (a register)
-// set Z S P CY AC flags
-uint8_t Emulator8080::xorWithAccumulator(uint8_t value) {
-    this->state.unSetFlag(State8080::CY);
-    this->state.unSetFlag(State8080::AC);
-    uint8_t result = value ^ this->state.a;
-    this->updateZeroFlag(result);
-    this->updateSignFlag(result);
-    this->updateParityFlag(result);
-    return result;
-}
+        // INR r
+        case 0x04: // INR B
+            this->state.b = this->lookupIncrement(this->state.b);
+            ++this->state.pc;
+            return 5;
+        case 0x0c: // INR C
+            this->state.c = this->lookupIncrement(this->state.c);
+            ++this->state.pc;
+            return 5;
+        case 0x14: // INR D
+            this->state.d = this->lookupIncrement(this->state.d);
+            ++this->state.pc;
+            return 5;
+        case 0x1c: // INR E
+            this->state.e = this->lookupIncrement(this->state.e);
+            ++this->state.pc;
+            return 5;
+        case 0x24: // INR H
+            this->state.h = this->lookupIncrement(this->state.h);
+            ++this->state.pc;
+            return 5;
+        case 0x2c: // INR L
+            this->state.l = this->lookupIncrement(this->state.l);
+            ++this->state.pc;
+            return 5;
+        case 0x3c: // INR A
+            this->state.a = this->lookupIncrement(this->state.a);
+            ++this->state.pc;
+            return 5;
+        // INR M
+        case 0x34:
+            temp = this->getHL();
+            bus.write(
+                this->lookupIncrement(bus.read(temp)), temp
+            );
+            ++this->state.pc;
+            return 10;
 
-// trigger an interrupt
-// accepts an initializer list of bytes representing an 8080 instruction
-// only one-byte instructions currently implemented
-// returns # of cpu clock cycles to handle interrupt
-int Emulator8080::processInterrupt(
-    std::initializer_list<uint8_t> instructionBytes
-) {
-    if (!(this->enableInterrupts)) return 0;
-    std::vector<uint8_t> interruptBytes = instructionBytes;
+        // DCR r
+        case 0x05: // DCR B
+            this->state.b = this->lookupDecrement(this->state.b);
+            ++this->state.pc;
+            return 5;
+        case 0x0d: // DCR C
+            this->state.c = this->lookupDecrement(this->state.c);
+            ++this->state.pc;
+            return 5;
+        case 0x15: // DCR D
+            this->state.d = this->lookupDecrement(this->state.d);
+            ++this->state.pc;
+            return 5;
+        case 0x1d: // DCR E
+            this->state.e = this->lookupDecrement(this->state.e);
+            ++this->state.pc;
+            return 5;
+        case 0x25: // DCR H
+            this->state.h = this->lookupDecrement(this->state.h);
+            ++this->state.pc;
+            return 5;
+        case 0x2d: // DCR L
+            this->state.l = this->lookupDecrement(this->state.l);
+            ++this->state.pc;
+            return 5;
+        case 0x3d: // DCR A
+            this->state.a = this->lookupDecrement(this->state.a);
+            ++this->state.pc;
+            return 5;
+        // DCR M
+        case 0x35:
+            temp = this->getHL();
+            bus.write(
+                this->lookupDecrement(bus.read(temp)), temp
+            );
+            ++this->state.pc;
+            return 10;
 
-    // interrupts clear the halt state
-    this->halted = false;
+        // MVI r
+        case 0x06: // MVI B
+            this->state.b = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        case 0x0e: // MVI C
+            this->state.c = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        case 0x16: // MVI D
+            this->state.d = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        case 0x1e: // MVI E
+            this->state.e = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        case 0x26: // MVI H
+            this->state.h = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        case 0x2e: // MVI L
+            this->state.l = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        case 0x3e: // MVI A
+            this->state.a = operand.byte();
+            this->state.pc += 2;
+            return 7;
+        // MVI M
+        case 0x36:
+            bus.write(operand.byte(), this->getHL());
+            this->state.pc += 2;
+            return 10;
+
+        // RLC
+        case 0x07:
+            if (this->state.a & 0x80) {
+                this->state.setFlag(State8080::CY);
+            } else {
+                this->state.unSetFlag(State8080::CY);
+            }
+            this->state.a = (this->state.a << 1) | (this->state.a >> 7);
+            ++this->state.pc;
+            return 4;
+        // RRC
+        case 0x0f:
+            if (this->state.a & 0x01) {
+                this->state.setFlag(State8080::CY);
+            } else {
+                this->state.unSetFlag(State8080::CY);
+            }
+            this->state.a = (this->state.a >> 1) | (this->state.a << 7);
+            ++this->state.pc;
+            return 4;
+        // RAL
+        case 0x17:
+            temp = this->state.isFlag(State8080::CY) ? 0x01 : 0x00;
+            if (this->state.a & 0x80) {
+                this->state.setFlag(State8080::CY);
+            } else {
+                this->state.unSetFlag(State8080::CY);
+            }
+            this->state.a = (this->state.a << 1) | temp;
+            ++this->state.pc;
+            return 4;
+        // RAR
+        case 0x1f:
+            temp = this->state.isFlag(State8080::CY) ? 0x80 : 0x00;
+            if (this->state.a & 0x01) {
+                this->state.setFlag(State8080::CY);
+            } else {
+                this->state.unSetFlag(State8080::CY);
+            }
+            this->state.a = (this->state.a >> 1) | temp;
+            ++this->state.pc;
+            return 4;
+
+        // DAD B/D/H/SP
+        case 0x09:
+            this->doubleAddWithHLIntoHL(this->getBC());
+            ++this->state.pc;
+            return 10;
+        case 0x19:
+            this->doubleAddWithHLIntoHL(this->getDE());
+            ++this->state.pc;
+            return 10;
+        case 0x29:
+            this->doubleAddWithHLIntoHL(this->getHL());
+            ++this->state.pc;
+            return 10;
+        case 0x39:
+            this->doubleAddWithHLIntoHL(this->state.sp);
+            ++this->state.pc;
+            return 10;
+
+        // SHLD, LHLD
+        case 0x22:
+            temp = operand.word();
+            bus.write(this->state.l, temp);
+            bus.write(this->state.h, temp + 1);
+            this->state.pc += 3;
+            return 16;
+        case 0x2a:
+            temp = operand.word();
+            this->state.l = bus.read(temp);
+            this->state.h = bus.read(temp + 1);
+            this->state.pc += 3;
+            return 16;
+
+        // DAA
+        case 0x27:
+            this->state.a = this->lookupDecimalAdjust();
+            ++this->state.pc;
+            return 4;
+
+        // CMA, STC, CMC
+        case 0x2f:
+            this->state.a = ~this->state.a;
+            ++this->state.pc;
+            return 4;
+        case 0x37:
+            this->state.setFlag(State8080::CY);
+            ++this->state.pc;
+            return 4;
+        case 0x3f:
+            this->state.complementFlag(State8080::CY);
+            ++this->state.pc;
+            return 4;
+
+        // STA, LDA
+        case 0x32:
+            bus.write(this->state.a, operand.word());
+            this->state.pc += 3;
+            return 13;
+        case 0x3a:
+            this->state.a = bus.read(operand.word());
+            this->state.pc += 3;
+            return 13;
+
+        // HLT
+        case 0x76:
+            this->halted = true;
+            ++this->state.pc;
+            return 7;
+
+        // MOV M,r
+        case 0x70: // MOV M,B
+            bus.write(this->state.b, this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x71: // MOV M,C
+            bus.write(this->state.c, this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x72: // MOV M,D
+            bus.write(this->state.d, this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x73: // MOV M,E
+            bus.write(this->state.e, this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x74: // MOV M,H
+            bus.write(this->state.h, this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x75: // MOV M,L
+            bus.write(this->state.l, this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x77: // MOV M,A
+            bus.write(this->state.a, this->getHL());
+            ++this->state.pc;
+            return 7;
+        // MOV r,M
+        case 0x46: // MOV B,M
+            this->state.b = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x4e: // MOV C,M
+            this->state.c = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x56: // MOV D,M
+            this->state.d = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x5e: // MOV E,M
+            this->state.e = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x66: // MOV H,M
+            this->state.h = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x6e: // MOV L,M
+            this->state.l = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+        case 0x7e: // MOV A,M
+            this->state.a = bus.read(this->getHL());
+            ++this->state.pc;
+            return 7;
+
+        // ADD/ADC M
+        case 0x86:
+            this->state.a = 
+                this->lookupAdd(bus.read(this->getHL()));
+            ++this->state.pc;
+            return 7;
+        case 0x8e:
+            this->state.a = this->lookupAdd(
+                bus.read(this->getHL()), true
+            );
+            ++this->state.pc;
+            return 7;
+        // SUB/SBB M
+        case 0x96:
+            this->state.a = this->lookupSubtract(
+                bus.read(this->getHL())
+            );
+            ++this->state.pc;
+            return 7;
+        case 0x9e:
+            this->state.a = this->lookupSubtract(
+                bus.read(this->getHL()), true
+            );
+            ++this->state.pc;
+            return 7;
+        // ANA/XRA/ORA/CMP M
+        case 0xa6:
+            this->state.a = 
+                this->lookupAnd(bus.read(this->getHL()));
+            ++this->state.pc;
+            return 7;
+        case 0xae:
+            this->state.a = 
+                this->lookupXor(bus.read(this->getHL()));
+            ++this->state.pc;
+            return 7;
+        case 0xb6:
+            this->state.a = 
+                this->lookupOr(bus.read(this->getHL()));
+            ++this->state.pc;
+            return 7;
+        case 0xbe:
+            this->lookupSubtract(
+                bus.read(this->getHL())
+            );
+            ++this->state.pc;
+            return 7;
+
+        // POP B/D/H/PSW
+        case 0xc1:
+            this->state.c = bus.read(this->state.sp++);
+            this->state.b = bus.read(this->state.sp++);
+            ++this->state.pc;
+            return 10;
+        case 0xd1:
+            this->state.e = bus.read(this->state.sp++);
+            this->state.d = bus.read(this->state.sp++);
+            ++this->state.pc;
+            return 10;
+        case 0xe1:
+            this->state.l = bus.read(this->state.sp++);
+            this->state.h = bus.read(this->state.sp++);
+            ++this->state.pc;
+            return 10;
+        case 0xf1:
+            this->state.loadFlags(bus.read(this->state.sp++));
+            this->state.a = bus.read(this->state.sp++);
+            ++this->state.pc;
+            return 10;
+
+        // PUSH B/D/H/PSW
+        case 0xc5:
+            bus.write(this->state.b, --this->state.sp);
+            bus.write(this->state.c, --this->state.sp);
+            ++this->state.pc;
+            return 11;
+        case 0xd5:
+            bus.write(this->state.d, --this->state.sp);
+            bus.write(this->state.e, --this->state.sp);
+            ++this->state.pc;
+            return 11;
+        case 0xe5:
+            bus.write(this->state.h, --this->state.sp);
+            bus.write(this->state.l, --this->state.sp);
+            ++this->state.pc;
+            return 11;
+        case 0xf5:
+            bus.write(this->state.a, --this->state.sp);
+            bus.write(this->state.getFlags(), --this->state.sp);
+            ++this->state.pc;
+            return 11;
+
+        // Jcc
+        case 0xc2: case 0xca: case 0xd2: case 0xda:
+        case 0xe2: case 0xea: case 0xf2: case 0xfa:
+            if (this->testCondition(opcode)) {
+                this->state.pc = operand.word();
+            } else {
+                this->state.pc += 3;
+            }
+            return 10;
+        // JMP and undocumented alias
+        case 0xc3: case 0xcb:
+            this->state.pc = operand.word();
+            return 10;
+
+        // Ccc
+        case 0xc4: case 0xcc: case 0xd4: case 0xdc:
+        case 0xe4: case 0xec: case 0xf4: case 0xfc:
+            if (this->testCondition(opcode)) {
+                this->callAddress(bus, operand.word());
+                return 17;
+            }
+            this->state.pc += 3;
+            return 11;
+        // CALL and undocumented aliases
+        case 0xcd: case 0xdd: case 0xed: case 0xfd:
+            this->callAddress(bus, operand.word());
+            return 17;
+
+        // Rcc
+        case 0xc0: case 0xc8: case 0xd0: case 0xd8:
+        case 0xe0: case 0xe8: case 0xf0: case 0xf8:
+            if (this->testCondition(opcode)) {
+                return this->ret(bus) + 1;
+            }
+            ++this->state.pc;
+            return 5;
+        // RET and undocumented alias
+        case 0xc9: case 0xd9:
+            return this->ret(bus);
+
+        // RST n, pushes the current pc (see callAddress)
+        case 0xc7: case 0xcf: case 0xd7: case 0xdf:
+        case 0xe7: case 0xef: case 0xf7: case 0xff:
+            this->callAddress(bus, opcode & 0x38, true);
+            return 11;
+
+        // ADI, ACI, SUI, SBI, ANI, XRI, ORI, CPI
+        case 0xc6:
+            this->state.a = this->lookupAdd(operand.byte());
+            this->state.pc += 2;
+            return 7;
+        case 0xce:
+            this->state.a = this->lookupAdd(operand.byte(), true);
+            this->state.pc += 2;
+            return 7;
+        case 0xd6:
+            this->state.a = this->lookupSubtract(operand.byte());
+            this->state.pc += 2;
+            return 7;
+        case 0xde:
+            this->state.a = 
+                this->lookupSubtract(operand.byte(), true);
+            this->state.pc += 2;
+            return 7;
+        case 0xe6:
+            this->state.a = this->lookupAnd(operand.byte());
+            this->state.pc += 2;
+            return 7;
+        case 0xee:
+            this->state.a = this->lookupXor(operand.byte());
+            this->state.pc += 2;
+            return 7;
+        case 0xf6:
+            this->state.a = this->lookupOr(operand.byte());
+            this->state.pc += 2;
+            return 7;
+        case 0xfe:
+            this->lookupSubtract(operand.byte());
+            this->state.pc += 2;
+            return 7;
+
+        // OUT, IN
+        case 0xd3:
+            outputCallback(operand.byte(), this->state.a);
+            this->state.pc += 2;
+            return 10;
+        case 0xdb:
+            this->state.a = inputCallback(operand.byte());
+            this->state.pc += 2;
+            return 10;
+
+        // XTHL
+        case 0xe3: {
+            uint8_t templ = this->state.l;
+            uint8_t temph = this->state.h;
+            this->state.l = bus.read(this->state.sp);
+            this->state.h = bus.read(this->state.sp + 1);
+            bus.write(templ, this->state.sp);
+            bus.write(temph, this->state.sp + 1);
+            ++this->state.pc;
+            return 18;
+        }
+        // PCHL
+        case 0xe9:
+            this->state.pc = this->getHL();
+            return 5;
+        // XCHG
+        case 0xeb:
+            temp = this->state.getHL();
+            this->state.setHL(this->state.getDE());
+            this->state.setDE(temp);
+            ++this->state.pc;
+            return 4;
+        // SPHL
+        case 0xf9:
+            this->state.sp = this->getHL();
+            ++this->state.pc;
+            return 5;
+
+        // DI, EI
+        case 0xf3:
+            this->enableInterrupts = false;
+            ++this->state.pc;
+            return 4;
+        case 0xfb:
+            this->enableInterrupts = true;
+            ++this->state.pc;
+            return 4;
+
+        // MOV r,r
+        case 0x40: // MOV B,B
+            ++this->state.pc;
+            return 5;
+        case 0x41: // MOV B,C
+            this->state.b = this->state.c;
+            ++this->state.pc;
+            return 5;
+        case 0x42: // MOV B,D
+            this->state.b = this->state.d;
+            ++this->state.pc;
+            return 5;
+        case 0x43: // MOV B,E
+            this->state.b = this->state.e;
+            ++this->state.pc;
+            return 5;
+        case 0x44: // MOV B,H
+            this->state.b = this->state.h;
+            ++this->state.pc;
+            return 5;
+        case 0x45: // MOV B,L
+            this->state.b = this->state.l;
+            ++this->state.pc;
+            return 5;
+        case 0x47: // MOV B,A
+            this->state.b = this->state.a;
+            ++this->state.pc;
+            return 5;
+        case 0x48: // MOV C,B
+            this->state.c = this->state.b;
+            ++this->state.pc;
+            return 5;
+        case 0x49: // MOV C,C
+            ++this->state.pc;
+            return 5;
+        case 0x4a: // MOV C,D
+            this->state.c = this->state.d;
+            ++this->state.pc;
+            return 5;
+        case 0x4b: // MOV C,E
+            this->state.c = this->state.e;
+            ++this->state.pc;
+            return 5;
+        case 0x4c: // MOV C,H
+            this->state.c = this->state.h;
+            ++this->state.pc;
+            return 5;
+        case 0x4d: // MOV C,L
+            this->state.c = this->state.l;
+            ++this->state.pc;
+            return 5;
+        case 0x4f: // MOV C,A
+            this->state.c = this->state.a;
+            ++this->state.pc;
+            return 5;
+        case 0x50: // MOV D,B
+            this->state.d = this->state.b;
+            ++this->state.pc;
+            return 5;
+        case 0x51: // MOV D,C
+            this->state.d = this->state.c;
+            ++this->state.pc;
+            return 5;
+        case 0x52: // MOV D,D
+            ++this->state.pc;
+            return 5;
+        case 0x53: // MOV D,E
+            this->state.d = this->state.e;
+            ++this->state.pc;
+            return 5;
+        case 0x54: // MOV D,H
+            this->state.d = this->state.h;
+            ++this->state.pc;
+            return 5;
+        case 0x55: // MOV D,L
+            this->state.d = this->state.l;
+            ++this->state.pc;
+            return 5;
+        case 0x57: // MOV D,A
+            this->state.d = this->state.a;
+            ++this->state.pc;
+            return 5;
+        case 0x58: // MOV E,B
+            this->state.e = this->state.b;
+            ++this->state.pc;
+            return 5;
+        case 0x59: // MOV E,C
+            this->state.e = this->state.c;
+            ++this->state.pc;
+            return 5;
+        case 0x5a: // MOV E,D
+            this->state.e = this->state.d;
+            ++this->state.pc;
+            return 5;
+        case 0x5b: // MOV E,E
+            ++this->state.pc;
+            return 5;
+        case 0x5c: // MOV E,H
+            this->state.e = this->state.h;
+            ++this->state.pc;
+            return 5;
+        case 0x5d: // MOV E,L
+            this->state.e = this->state.l;
+            ++this->state.pc;
+            return 5;
+        case 0x5f: // MOV E,A
+            this->state.e = this->state.a;
+            ++this->state.pc;
+            return 5;
+        case 0x60: // MOV H,B
+            this->state.h = this->state.b;
+            ++this->state.pc;
+            return 5;
+        case 0x61: // MOV H,C
+            this->state.h = this->state.c;
+            ++this->state.pc;
+            return 5;
+        case 0x62: // MOV H,D
+            this->state.h = this->state.d;
+            ++this->state.pc;
+            return 5;
+        case 0x63: // MOV H,E
+            this->state.h = this->state.e;
+            ++this->state.pc;
+            return 5;
+        case 0x64: // MOV H,H
+            ++this->state.pc;
+            return 5;
+        case 0x65: // MOV H,L
+            this->state.h = this->state.l;
+            ++this->state.pc;
+            return 5;
+        case 0x67: // MOV H,A
+            this->state.h = this->state.a;
+            ++this->state.pc;
+            return 5;
+        case 0x68: // MOV L,B
+            this->state.l = this->state.b;
+            ++this->state.pc;
+            return 5;
+        case 0x69: // MOV L,C
+            this->state.l = this->state.c;
+            ++this->state.pc;
+            return 5;
+        case 0x6a: // MOV L,D
+            this->state.l = this->state.d;
+            ++this->state.pc;
+            return 5;
+        case 0x6b: // MOV L,E
+            this->state.l = this->state.e;
+            ++this->state.pc;
+            return 5;
+        case 0x6c: // MOV L,H
+            this->state.l = this->state.h;
+            ++this->state.pc;
+            return 5;
+        case 0x6d: // MOV L,L
+            ++this->state.pc;
+            return 5;
+        case 0x6f: // MOV L,A
+            this->state.l = this->state.a;
+            ++this->state.pc;
+            return 5;
+        case 0x78: // MOV A,B
+            this->state.a = this->state.b;
+            ++this->state.pc;
+            return 5;
+        case 0x79: // MOV A,C
+            this->state.a = this->state.c;
+            ++this->state.pc;
+            return 5;
+        case 0x7a: // MOV A,D
+            this->state.a = this->state.d;
+            ++this->state.pc;
+            return 5;
+        case 0x7b: // MOV A,E
+            this->state.a = this->state.e;
+            ++this->state.pc;
+            return 5;
+        case 0x7c: // MOV A,H
+            this->state.a = this->state.h;
+            ++this->state.pc;
+            return 5;
+        case 0x7d: // MOV A,L
+            this->state.a = this->state.l;
+            ++this->state.pc;
+            return 5;
+        case 0x7f: // MOV A,A
+            ++this->state.pc;
+            return 5;
+
+        // ADD r
+        case 0x80:
+            this->state.a = this->lookupAdd(this->state.b);
+            ++this->state.pc;
+            return 4;
+        case 0x81:
+            this->state.a = this->lookupAdd(this->state.c);
+            ++this->state.pc;
+            return 4;
+        case 0x82:
+            this->state.a = this->lookupAdd(this->state.d);
+            ++this->state.pc;
+            return 4;
+        case 0x83:
+            this->state.a = this->lookupAdd(this->state.e);
+            ++this->state.pc;
+            return 4;
+        case 0x84:
+            this->state.a = this->lookupAdd(this->state.h);
+            ++this->state.pc;
+            return 4;
+        case 0x85:
+            this->state.a = this->lookupAdd(this->state.l);
+            ++this->state.pc;
+            return 4;
+        case 0x87:
+            this->state.a = this->lookupAdd(this->state.a);
+            ++this->state.pc;
+            return 4;
+        // ADC r
+        case 0x88:
+            this->state.a = this->lookupAdd(this->state.b, true);
+            ++this->state.pc;
+            return 4;
+        case 0x89:
+            this->state.a = this->lookupAdd(this->state.c, true);
+            ++this->state.pc;
+            return 4;
+        case 0x8a:
+            this->state.a = this->lookupAdd(this->state.d, true);
+            ++this->state.pc;
+            return 4;
+        case 0x8b:
+            this->state.a = this->lookupAdd(this->state.e, true);
+            ++this->state.pc;
+            return 4;
+        case 0x8c:
+            this->state.a = this->lookupAdd(this->state.h, true);
+            ++this->state.pc;
+            return 4;
+        case 0x8d:
+            this->state.a = this->lookupAdd(this->state.l, true);
+            ++this->state.pc;
+            return 4;
+        case 0x8f:
+            this->state.a = this->lookupAdd(this->state.a, true);
+            ++this->state.pc;
+            return 4;
+        // SUB r
+        case 0x90:
+            this->state.a = this->lookupSubtract(this->state.b);
+            ++this->state.pc;
+            return 4;
+        case 0x91:
+            this->state.a = this->lookupSubtract(this->state.c);
+            ++this->state.pc;
+            return 4;
+        case 0x92:
+            this->state.a = this->lookupSubtract(this->state.d);
+            ++this->state.pc;
+            return 4;
+        case 0x93:
+            this->state.a = this->lookupSubtract(this->state.e);
+            ++this->state.pc;
+            return 4;
+        case 0x94:
+            this->state.a = this->lookupSubtract(this->state.h);
+            ++this->state.pc;
+            return 4;
+        case 0x95:
+            this->state.a = this->lookupSubtract(this->state.l);
+            ++this->state.pc;
+            return 4;
+        case 0x97:
+            this->state.a = this->lookupSubtract(this->state.a);
+            ++this->state.pc;
+            return 4;
+        // SBB r
+        case 0x98:
+            this->state.a = this->lookupSubtract(this->state.b, true);
+            ++this->state.pc;
+            return 4;
+        case 0x99:
+            this->state.a = this->lookupSubtract(this->state.c, true);
+            ++this->state.pc;
+            return 4;
+        case 0x9a:
+            this->state.a = this->lookupSubtract(this->state.d, true);
+            ++this->state.pc;
+            return 4;
+        case 0x9b:
+            this->state.a = this->lookupSubtract(this->state.e, true);
+            ++this->state.pc;
+            return 4;
+        case 0x9c:
+            this->state.a = this->lookupSubtract(this->state.h, true);
+            ++this->state.pc;
+            return 4;
+        case 0x9d:
+            this->state.a = this->lookupSubtract(this->state.l, true);
+            ++this->state.pc;
+            return 4;
+        case 0x9f:
+            this->state.a = this->lookupSubtract(this->state.a, true);
+            ++this->state.pc;
+            return 4;
+        // ANA r
+        case 0xa0:
+            this->state.a = this->lookupAnd(this->state.b);
+            ++this->state.pc;
+            return 4;
+        case 0xa1:
+            this->state.a = this->lookupAnd(this->state.c);
+            ++this->state.pc;
+            return 4;
+        case 0xa2:
+            this->state.a = this->lookupAnd(this->state.d);
+            ++this->state.pc;
+            return 4;
+        case 0xa3:
+            this->state.a = this->lookupAnd(this->state.e);
+            ++this->state.pc;
+            return 4;
+        case 0xa4:
+            this->state.a = this->lookupAnd(this->state.h);
+            ++this->state.pc;
+            return 4;
+        case 0xa5:
+            this->state.a = this->lookupAnd(this->state.l);
+            ++this->state.pc;
+            return 4;
+        case 0xa7:
+            this->state.a = this->lookupAnd(this->state.a);
+            ++this->state.pc;
+            return 4;
+        // XRA r
+        case 0xa8:
+            this->state.a = this->lookupXor(this->state.b);
+            ++this->state.pc;
+            return 4;
+        case 0xa9:
+            this->state.a = this->lookupXor(this->state.c);
+            ++this->state.pc;
+            return 4;
+        case 0xaa:
+            this->state.a = this->lookupXor(this->state.d);
+            ++this->state.pc;
+            return 4;
+        case 0xab:
+            this->state.a = this->lookupXor(this->state.e);
+            ++this->state.pc;
+            return 4;
+        case 0xac:
+            this->state.a = this->lookupXor(this->state.h);
+            ++this->state.pc;
+            return 4;
+        case 0xad:
+            this->state.a = this->lookupXor(this->state.l);
+            ++this->state.pc;
+            return 4;
+        case 0xaf:
+            this->state.a = this->lookupXor(this->state.a);
+            ++this->state.pc;
+            return 4;
+        // ORA r
+        case 0xb0:
+            this->state.a = this->lookupOr(this->state.b);
+            ++this->state.pc;
+            return 4;
+        case 0xb1:
+            this->state.a = this->lookupOr(this->state.c);
+            ++this->state.pc;
+            return 4;
+        case 0xb2:
+            this->state.a = this->lookupOr(this->state.d);
+            ++this->state.pc;
+            return 4;
+        case 0xb3:
+            this->state.a = this->lookupOr(this->state.e);
+            ++this->state.pc;
+            return 4;
+        case 0xb4:
+            this->state.a = this->lookupOr(this->state.h);
+            ++this->state.pc;
+            return 4;
+        case 0xb5:
+            this->state.a = this->lookupOr(this->state.l);
+            ++this->state.pc;
+            return 4;
+        case 0xb7:
+            this->state.a = this->lookupOr(this->state.a);
+            ++this->state.pc;
+            return 4;
+        // CMP r
+        case 0xb8:
+            this->lookupSubtract(this->state.b);
+            ++this->state.pc;
+            return 4;
+        case 0xb9:
+            this->lookupSubtract(this->state.c);
+            ++this->state.pc;
+            return 4;
+        case 0xba:
+            this->lookupSubtract(this->state.d);
+            ++this->state.pc;
+            return 4;
+        case 0xbb:
+            this->lookupSubtract(this->state.e);
+            ++this->state.pc;
+            return 4;
+        case 0xbc:
+            this->lookupSubtract(this->state.h);
+            ++this->state.pc;
+            return 4;
+        case 0xbd:
+            this->lookupSubtract(this->state.l);
+            ++this->state.pc;
+            return 4;
+        case 0xbf:
+            this->lookupSubtract(this->state.a);
+            ++this->state.pc;
+            return 4;
+    }
+    // every opcode is handled above
+    return 0;
+}
+
+// how an opcode matters to spin loop detection
+enum spinClass : uint8_t {
+    SPIN_PLAIN = 0, // registers and flags only, or a memory read
+    SPIN_SIDE_EFFECT = 1, // may not be part of a spin loop
+    SPIN_JUMP = 2 // may go back to a loop head
+};
+
+// side effects are stores (PUSH, CALL and RST included, even when a
+// conditional call is not taken), IN, OUT, EI, DI and HLT.
+// jumps are JMP, Jcc, RET, Rcc and PCHL
+static constexpr std::array<uint8_t, 0x100> buildSpinClasses() {
+    std::array<uint8_t, 0x100> spinClasses = {};
+    const uint8_t sideEffects[] = {
+        0x02, 0x12, 0x22, 0x32, 0x34, 0x35, 0x36, // stores, INR/DCR M
+        0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, // MOV M,r and HLT
+        0xc4, 0xcc, 0xd4, 0xdc, 0xe4, 0xec, 0xf4, 0xfc, // Ccc
+        0xcd, 0xdd, 0xed, 0xfd, // CALL
+        0xc7, 0xcf, 0xd7, 0xdf, 0xe7, 0xef, 0xf7, 0xff, // RST
+        0xc5, 0xd5, 0xe5, 0xf5, 0xe3, // PUSH, XTHL
+        0xd3, 0xdb, 0xf3, 0xfb // OUT, IN, DI, EI
+    };
+    const uint8_t jumps[] = {
+        0xc2, 0xca, 0xd2, 0xda, 0xe2, 0xea, 0xf2, 0xfa, // Jcc
+        0xc0, 0xc8, 0xd0, 0xd8, 0xe0, 0xe8, 0xf0, 0xf8, // Rcc
+        0xc3, 0xcb, 0xc9, 0xd9, 0xe9 // JMP, RET, PCHL
+    };
+    for (uint8_t opcode : sideEffects) spinClasses[opcode] = SPIN_SIDE_EFFECT;
+    for (uint8_t opcode : jumps) spinClasses[opcode] = SPIN_JUMP;
+    return spinClasses;
+}
+static constexpr std::array<uint8_t, 0x100> SPIN_CLASSES = buildSpinClasses();
+
+// record a loop head, or skip passes of a loop seen twice unchanged
+inline int Emulator8080::skipSpin(
+    struct SpinWatch8080 &spin, int cycles, int budget,
+    unsigned long long instructions
+) {
+    // most visits between comparisons
+    const int MAX_BACKOFF = 63;
+    if ((spin.visits == 0) || (spin.address != this->state.pc)) {
+        spin.address = this->state.pc;
+        spin.visits = 1;
+        spin.backoff = 0;
+        spin.wait = 0;
+        spin.cycles = cycles;
+        spin.instructions = instructions;
+        return 0;
+    }
+    if (spin.wait > 0) {
+        --spin.wait;
+        return 0;
+    }
+    if (
+        (spin.visits == 1) 
+        || !this->isSpinDetection
+        || !this->state.isSameState(spin.registers)
+    ) {
+        if (spin.visits == 2) {
+            spin.backoff = std::min(2 * spin.backoff + 1, MAX_BACKOFF);
+            spin.wait = spin.backoff;
+        }
+        spin.visits = 2;
+        spin.cycles = cycles;
+        spin.instructions = instructions;
+        spin.registers = this->state.registers();
+        return 0;
+    }
+    // the passes since the recorded visit changed nothing, so they repeat.
+    // skip the passes that start before budget runs out; the interpreter
+    // runs the last one and ends the batch on the same instruction
+    int passCycles = cycles - spin.cycles;
+    unsigned long long passInstructions = instructions - spin.instructions;
+    int passes = (cycles < budget) ? (budget - cycles - 1) / passCycles : 0;
+    int skipped = passes * passCycles;
+    this->spinCycles += skipped;
+    spin.cycles = cycles + skipped;
+    spin.instructions = instructions + passes * passInstructions;
+    return skipped;
+}
+
+// run a batch of instructions on the switch core, see runCycles()
+template<class memoryType>
+int Emulator8080::runSwitch(memoryType &bus, int budget) {
+    int cycles = 0;
+    unsigned long long instructions = 0;
+    struct SpinWatch8080 spin;
+    spin.visits = 0;
+    try {
+        while ((cycles < budget) && !this->halted) {
+            if (this->isHooked(this->state.pc)) {
+                int used = this->callHook(budget - cycles, instructions);
+                cycles += used;
+                if (used > 0) {
+                    spin.visits = 0;
+                    continue;
+                }
+            }
+            uint16_t pc = this->state.pc;
+            uint8_t opcodeWord = bus.read(pc);
+            if (isPortOpcode(opcodeWord)) this->batchCycles = cycles;
+            cycles += this->executeSwitch(
+                bus, opcodeWord, BusOperand8080<memoryType>{bus, pc}
+            );
+            ++instructions;
+            uint8_t spinClass = SPIN_CLASSES[opcodeWord];
+            if (spinClass == SPIN_SIDE_EFFECT) {
+                spin.visits = 0;
+            } else if ((spinClass == SPIN_JUMP) && (this->state.pc <= pc)) {
+                int skipped = 
+                    this->skipSpin(spin, cycles, budget, instructions);
+                if (skipped > 0) {
+                    cycles += skipped;
+                    instructions = spin.instructions;
+                }
+            }
+        }
+    } catch (const std::out_of_range& oor) {
+        this->instructionCount += instructions;
+        throw MemoryReadError(formatAddress(this->state.pc));
+    }
+    this->instructionCount += instructions;
+    return this->idleUntil(cycles, budget);
+}
+
+/*
+ * Memory wrapper used by the block core. Reads and writes go straight to
+ * the wrapped memory; a write that lands on the bytes of a cached block
+ * drops that block and raises a flag so the executor leaves it.
+ * Writes are only checked while some cached block covers writable memory,
+ * so code running from ROM pays one test per store.
+ */
+template<class memoryType>
+class CodeWatchingBus {
+    public:
+        CodeWatchingBus(memoryType &bus, BlockCache8080 &cache) :
+                bus(bus), cache(cache), invalidated(false) {}
+        inline uint8_t read(uint16_t address) const {
+            return bus.read(address);
+        }
+        inline void write(uint8_t word, uint16_t address) {
+            bus.write(word, address);
+            if (cache.hasWritableCode()) {
+                uint16_t physical = bus.physicalAddress(address);
+                if (cache.isCode(physical) && cache.invalidate(physical)) {
+                    invalidated = true;
+                }
+            }
+        }
+        // true if a write dropped a block since the last clear()
+        inline bool isInvalidated() const { return invalidated; }
+        inline void clear() { invalidated = false; }
+    private:
+        memoryType &bus;
+        BlockCache8080 &cache;
+        bool invalidated;
+};
+
+// true for opcodes that end a basic block: jumps, calls, returns,
+// restarts (including undocumented aliases), PCHL and HLT
+static bool isBlockEnd(uint8_t opcode) {
+    switch (opcode & 0xc7) {
+        case 0xc0: // Rcc
+        case 0xc2: // Jcc
+        case 0xc4: // Ccc
+        case 0xc7: // RST
+            return true;
+    }
+    switch (opcode) {
+        case 0x76: // HLT
+        case 0xc3: case 0xcb: // JMP
+        case 0xc9: case 0xd9: // RET
+        case 0xcd: case 0xdd: case 0xed: case 0xfd: // CALL
+        case 0xe9: // PCHL
+            return true;
+        default:
+            return false;
+    }
+}
+
+// decode instructions from address up to the end of the basic block
+// a block running past the end of memory stops at the last whole
+// instruction; the interpreter raises the error if it gets there
+template<class memoryType>
+struct BasicBlock8080 *Emulator8080::buildBlock(
+    memoryType &bus, uint16_t address
+) {
+    std::unique_ptr<struct BasicBlock8080> block =
+        std::make_unique<struct BasicBlock8080>();
+    block->entryAddress = address;
+    block->lowAddress = bus.physicalAddress(address);
+    block->highAddress = block->lowAddress;
+    block->isWritable = false;
+    block->hasSideEffects = false;
+    uint16_t pc = address;
+    bool isEnd = false;
+    while (
+        !isEnd 
+        && (block->instructions.size() < BlockCache8080::MAX_BLOCK_INSTRUCTIONS)
+    ) {
+        struct DecodedInstruction8080 instruction;
+        try {
+            instruction.opcode = bus.read(pc);
+            instruction.length = INSTRUCTION_LENGTH[instruction.opcode];
+            instruction.operand = 0x0000;
+            if (instruction.length == 2) {
+                instruction.operand = bus.read(pc + 1);
+            } else if (instruction.length == 3) {
+                instruction.operand = bus.read(pc + 1) 
+                    | (bus.read(pc + 2) << 8);
+            }
+        } catch (const std::out_of_range& oor) {
+            if (block->instructions.empty()) throw;
+            break;
+        }
+        // record the bytes covered so stores into them are caught
+        for (int offset = 0; offset < instruction.length; ++offset) {
+            uint16_t byteAddress = pc + offset;
+            uint16_t physical = bus.physicalAddress(byteAddress);
+            if (physical < block->lowAddress) block->lowAddress = physical;
+            if (physical > block->highAddress) block->highAddress = physical;
+            if (!bus.isReadOnly(byteAddress)) block->isWritable = true;
+        }
+        if (SPIN_CLASSES[instruction.opcode] == SPIN_SIDE_EFFECT) {
+            block->hasSideEffects = true;
+        }
+        block->instructions.push_back(instruction);
+        pc += instruction.length;
+        isEnd = isBlockEnd(instruction.opcode);
+    }
+    return this->blockCache->insert(std::move(block));
+}
+
+// run a batch of instructions on the block core, see runCycles()
+// the budget, HLT and invalidation are checked after every instruction,
+// so a batch ends on exactly the same instruction as on the other cores.
+// spin loops are looked for on jumps back to the entry of a block or
+// before it
+template<class memoryType>
+int Emulator8080::runBlocks(memoryType &bus, int budget) {
+    CodeWatchingBus<memoryType> watchedBus(bus, *this->blockCache);
+    int cycles = 0;
+    unsigned long long instructions = 0;
+    struct SpinWatch8080 spin;
+    spin.visits = 0;
+    try {
+        while ((cycles < budget) && !this->halted) {
+            if (this->isHooked(this->state.pc)) {
+                int used = this->callHook(budget - cycles, instructions);
+                cycles += used;
+                if (used > 0) {
+                    spin.visits = 0;
+                    continue;
+                }
+            }
+            struct BasicBlock8080 *block = 
+                this->blockCache->find(this->state.pc);
+            if (block == nullptr) {
+                block = this->buildBlock(bus, this->state.pc);
+            }
+            for (const auto &instruction : block->instructions) {
+                if (isPortOpcode(instruction.opcode)) {
+                    this->batchCycles = cycles;
+                }
+                cycles += this->executeSwitch(
+                    watchedBus, instruction.opcode, 
+                    DecodedOperand8080{instruction.operand}
+                );
+                ++instructions;
+                if (
+                    (cycles >= budget) || this->halted 
+                    || watchedBus.isInvalidated()
+                ) {
+                    break;
+                }
+            }
+            if (block->hasSideEffects) {
+                spin.visits = 0;
+            } else if (this->state.pc <= block->entryAddress) {
+                int skipped = 
+                    this->skipSpin(spin, cycles, budget, instructions);
+                if (skipped > 0) {
+                    cycles += skipped;
+                    instructions = spin.instructions;
+                }
+            }
+            // the block just left may have been dropped, free it now
+            if (watchedBus.isInvalidated()) {
+                watchedBus.clear();
+                this->blockCache->retire();
+            }
+        }
+    } catch (const std::out_of_range& oor) {
+        this->instructionCount += instructions;
+        throw MemoryReadError(formatAddress(this->state.pc));
+    }
+    this->instructionCount += instructions;
+    return this->idleUntil(cycles, budget);
+}
+
+// execute one instruction outside a cached block on the block core
+template<class memoryType>
+int Emulator8080::executeWatched(
+    memoryType &bus, uint8_t opcode, uint16_t operand
+) {
+    CodeWatchingBus<memoryType> watchedBus(bus, *this->blockCache);
+    int cycles = this->executeSwitch(
+        watchedBus, opcode, DecodedOperand8080{operand}
+    );
+    if (watchedBus.isInvalidated()) this->blockCache->retire();
+    return cycles;
+}
+
+// report the block cache counters
+struct BlockCacheStatistics Emulator8080::getBlockCacheStatistics() const {
+    if (this->blockCache) return this->blockCache->getStatistics();
+    return {0, 0, 0};
+}
+
+// drop every cached block
+void Emulator8080::flushBlockCache() {
+    if (this->blockCache) {
+        this->blockCache->flush();
+        this->blockCache->retire();
+    }
+}
+
+// Build a statically bound emulator with no memory attached
+template<class memoryType>
+BoundEmulator8080<memoryType>::BoundEmulator8080(
+    Emulator8080::core dispatchCore
+) : 
+        Emulator8080(dispatchCore) {
+    if (dispatchCore == TABLE) {
+        throw std::invalid_argument(
+            "a bound emulator runs the switch or block core"
+        );
+    }
+}
+
+// Build a statically bound emulator with attached memory device
+template<class memoryType>
+BoundEmulator8080<memoryType>::BoundEmulator8080(
+    memoryType *memoryDevice, Emulator8080::core dispatchCore
+) :
+        Emulator8080(memoryDevice, dispatchCore) {
+    if (dispatchCore == TABLE) {
+        throw std::invalid_argument(
+            "a bound emulator runs the switch or block core"
+        );
+    }
+}
+
+// only accept a memory of the bound type
+template<class memoryType>
+void BoundEmulator8080<memoryType>::connectMemory(Memory *memoryDevice) {
+    if (
+        (memoryDevice != nullptr) 
+        && (dynamic_cast<memoryType*>(memoryDevice) == nullptr)
+    ) {
+        throw std::invalid_argument(
+            "memory does not match the type the emulator is bound to"
+        );
+    }
+    Emulator8080::connectMemory(memoryDevice);
+}
+
+// fetch, decode, and execute a single instruction with every memory
+// access bound to memoryType at compile time
+template<class memoryType>
+int BoundEmulator8080<memoryType>::step() {
+    if (this->halted) return 0;
+    ++this->instructionCount;
+    memoryType &bus = *static_cast<memoryType*>(this->memory);
+    uint8_t opcodeWord = bus.read(this->state.pc);
+    if (this->dispatchCore == BLOCK) {
+        return this->executeWatched(
+            bus, opcodeWord, this->fetchOperand(bus, opcodeWord)
+        );
+    }
+    return this->executeSwitch(
+        bus, opcodeWord, BusOperand8080<memoryType>{bus, this->state.pc}
+    );
+}
+
+// run a batch of instructions with memory bound at compile time
+template<class memoryType>
+int BoundEmulator8080<memoryType>::runCycles(int budget) {
+    memoryType &bus = *static_cast<memoryType*>(this->memory);
+    if (this->dispatchCore == BLOCK) return this->runBlocks(bus, budget);
+    return this->runSwitch(bus, budget);
+}
+
+template class BoundEmulator8080<SpaceInvaderMemory>;
+
+// read an address stored starting at atAddress
+// accounts for little-endian storage model
+uint16_t Emulator8080::readAddressFromMemory(uint16_t atAddress) {
+    uint16_t lsb = this->memory->read(atAddress);
+    uint16_t msb = this->memory->read(atAddress + 1) << 8;
+    return msb + lsb;
+}
+
+// set up return address on stack and set jump address
+// pushes the current address on the stack, then sets the program counter to
+// an argument, address. isReset governs which address is pushed->
+// false, pc = next instruction; true, pc = current instruction
+void Emulator8080::callAddress(uint16_t address, bool isReset) {
+    // advance pc to next instruction if this is not a RST
+    if (!isReset) {
+        this->state.pc += 3;
+    }
+    // push high byte of next pc
+    --this->state.sp;
+    this->memory->write(
+        static_cast<uint8_t>((this->state.pc & 0xFF00) >> 8),
+        this->state.sp
+    );
+    // push low byte of next pc
+    --this->state.sp;
+    this->memory->write(
+        static_cast<uint8_t>(this->state.pc & 0x00FF),
+        this->state.sp
+    );
+    // go to call address next  
+    this->state.pc = address;
+}
+
+// pair the BC registers into a 2-byte value
+uint16_t Emulator8080::getBC() {
+    return this->state.getBC();
+}
+
+// pair the DE registers into a 2-byte value
+uint16_t Emulator8080::getDE() {
+    return this->state.getDE();
+}
+
+// pair the HL registers into a 2-byte value
+uint16_t Emulator8080::getHL() {
+    return this->state.getHL();
+}
+
+// decrement a value, set Z S P AC flags
+uint8_t Emulator8080::decrementValue(uint8_t value) {
+    // -1 is added as 0xff, so AC (carry out of the low nibble) is set
+    // unless the low nibble of the operand is 0b0000
+    uint8_t result = value - 1;
+    // S Z P AC are worked out from the result when first read
+    this->state.deferFlags(result, value ^ 0xff ^ result);
+    return result; // return the decremented value
+}
+
+// increment a value, set Z S P AC flags
+uint8_t Emulator8080::incrementValue(uint8_t value) {
+    // only operand low nibble of 0b1111 will result in carry out from low nibble
+	// from adding 0b0001
+    uint8_t result = value + 1;
+    // S Z P AC are worked out from the result when first read
+    this->state.deferFlags(result, value ^ 0x01 ^ result);
+    return result; // return the incremented value
+}
+
+// subtract subtrahend from minuend, set Z, S, P, CY, AC flags
+// return minuend - subtrahend
+uint8_t Emulator8080::subtractValues(
+    uint8_t minuend, uint8_t subtrahend, bool withCarry
+) {
+    // set up carry bit
+    uint8_t carryBit = 0;
+    if (withCarry && this->state.isFlag(State8080::CY)) carryBit = 1;
+
+    // do the subtraction upcast to uint16_t in order to capture carry bit
+    uint16_t result = minuend - subtrahend - carryBit;
+    // get the 1-byte difference
+    uint8_t difference = result & 0x00ff;
+    // aux carry is set when the low nibble does not borrow
+    // (https://www.reddit.com/r/EmuDev/comments/p8b4ou/8080_decrement_sub_wrappingzero_question/)
+    // which is the nibble carry of minuend + ~subtrahend + !carryBit
+    this->state.deferFlags(
+        difference, minuend ^ static_cast<uint8_t>(~subtrahend) ^ difference
+    );
+
+    // determine state of carry flag
+    if (result & 0x0100) { //0b0000'0001'0000'0000 mask
+        this->state.setFlag(State8080::CY);
+    } else {
+        this->state.unSetFlag(State8080::CY);
+    }
+
+    return difference;
+}
+
+// add a 2-byte addend to HL and store the result in HL
+// set the CY flag if necessary
+void Emulator8080::doubleAddWithHLIntoHL(uint16_t addend) {
+    // upcast to 4-byte to capture carry bit
+    uint32_t result = this->getHL() + addend;
+    // get the 2-byte sum
+    uint16_t sum = result & 0x0000ffff;
+    // store sum in HL
+    this->state.setHL(sum);
+    // determine state of carry flag
+    if (result & 0x00010000) { //0b0000'0000'0000'0001'0000'0000'0000'0000 mask
+        this->state.setFlag(State8080::CY);
+    } else {
+        this->state.unSetFlag(State8080::CY);
+    }
+}
+
+// return the bitwise and of a value and the accumulator (a register)
+// set Z S P CY AC flags
+uint8_t Emulator8080::andWithAccumulator(uint8_t value) {
+    // http://bitsavers.trailing-edge.com/components/intel/MCS80/9800301D_8080_8085_Assembly_Language_Programming_Manual_May81.pdf
+    // page 1-12 for aux carry
+    // AC is the or of bit 3 of the operands, moved up to bit 4
+    uint8_t result = this->state.a & value; 
+    this->state.deferFlags(result, (this->state.a | value) << 1);
+    this->state.unSetFlag(State8080::CY);
+
+    return result;
+}
+
+
+// return the sum an addend and the accumulator (a register)
+// additionally adding the carry bit
+// set Z S P CY AC flags
+uint8_t Emulator8080::addWithAccumulator(uint8_t addend, bool withCarry) {
+    // do addition upcast to capture carry bit
+    uint16_t result = this->state.a + addend;
+    if (withCarry && this->state.isFlag(State8080::CY)) ++result;
+
+    uint8_t sum = result & 0x00ff; // extract 1-byte sum
+
+    // S Z P from the sum, AC from the carry into bit 4
+    this->state.deferFlags(sum, this->state.a ^ addend ^ sum);
+
+    // determine state of carry flag
+    if (result & 0x0100) { //0b0000'0001'0000'0000 mask
+        this->state.setFlag(State8080::CY);
+    } else {
+        this->state.unSetFlag(State8080::CY);
+    }
+
+    return sum;
+}
+
+// return the bitwise or of a value and the accumulator (a register)
+// set Z S P CY AC flags
+uint8_t Emulator8080::orWithAccumulator(uint8_t value) {
+    this->state.unSetFlag(State8080::CY);
+    uint8_t result = value | this->state.a;
+    // AC is cleared
+    this->state.deferFlags(result, 0x00);
+    return result;
+}
+
+// return the bitwise xor of a value and the accumulator (a register)
+// set Z S P CY AC flags
+uint8_t Emulator8080::xorWithAccumulator(uint8_t value) {
+    this->state.unSetFlag(State8080::CY);
+    uint8_t result = value ^ this->state.a;
+    // AC is cleared
+    this->state.deferFlags(result, 0x00);
+    return result;
+}
+
+// trigger an interrupt
+// accepts an initializer list of bytes representing an 8080 instruction
+// only one-byte instructions currently implemented
+// returns # of cpu clock cycles to handle interrupt
+int Emulator8080::processInterrupt(
+    std::initializer_list<uint8_t> instructionBytes
+) {
+    if (!(this->enableInterrupts)) return 0;
+    std::vector<uint8_t> interruptBytes = instructionBytes;
+
+    // interrupts clear the halt state
+    this->halted = false;
 
     if (interruptBytes.size() == 1) {
+        if (this->dispatchCore == SWITCH) {
+            this->enableInterrupts = false;
+            // one-byte instructions take no operand
+            return this->executeSwitch(
+                *this->memory, interruptBytes.at(0), DecodedOperand8080{0}
+            );
+        }
+        if (this->dispatchCore == BLOCK) {
+            this->enableInterrupts = false;
+            // the RST pushes the pc, which may land on cached code
+            return this->executeWatched(
+                *this->memory, interruptBytes.at(0), 0x0000
+            );
+        }
         auto interruptFunction = this->decode(interruptBytes.at(0));
         this->enableInterrupts = false;
         return interruptFunction();
@@ -3091,12 +4731,46 @@ int Emulator8080::requestInterrupt(uint8_t opcode) {
     }
 }
 
+// ids of full snapshots, unique across emulators
+static std::atomic<unsigned long long> nextSnapshotId(1);
+
 //Create a snapshot of the state and memory of the emulator
 std::unique_ptr<Snapshot> Emulator8080::TakeSnapshot()
 {
 	std::unique_ptr<Snapshot> snap = std::make_unique<Snapshot>();
 	snap->copyMemory(memory);
 	snap->state = state.clone();
+	snap->interruptsEnabled = enableInterrupts;
+	snap->halted = halted;
+	snap->id = nextSnapshotId++;
+	//Later deltas against this snapshot need only what is written from now
+	memory->setDirtyPages(MemoryPages::none());
+	snapshotBase = snap->id;
+	return snap;
+}
+
+//Create a snapshot holding only the memory pages changed since base
+std::unique_ptr<Snapshot> Emulator8080::TakeSnapshot(std::shared_ptr<const Snapshot> base)
+{
+	//A delta is always relative to a full snapshot
+	if (base->isDelta())
+	{
+		base = base->base;
+	}
+	std::unique_ptr<Snapshot> snap = std::make_unique<Snapshot>();
+	if (base->id == snapshotBase)
+	{
+		snap->copyPages(memory, memory->getDirtyPages());
+	}
+	else
+	{
+		snap->copyPages(memory, MemoryPages::all());
+	}
+	snap->base = std::move(base);
+	snap->state = state.clone();
+	snap->interruptsEnabled = enableInterrupts;
+	snap->halted = halted;
+	snap->id = nextSnapshotId++;
 	return snap;
 }
 
@@ -3105,5 +4779,30 @@ std::unique_ptr<Snapshot> Emulator8080::TakeSnapshot()
 void Emulator8080::LoadSnapshot(std::unique_ptr<Snapshot> snapshot)
 {
 	state.loadState(std::move(snapshot->state->clone()));
-	memory->flashROM(snapshot->memoryData.data(), snapshot->memoryData.size(), 0);
+	loadInterruptState(snapshot->interruptsEnabled, snapshot->halted);
+	if (snapshot->isDelta())
+	{
+		//The base, then the pages that differ from it
+		const Snapshot& base = *snapshot->base;
+		memory->loadBlock(base.memoryData.data(), 0, base.memoryData.size());
+		const uint8_t* source = snapshot->memoryData.data();
+		for (int page = 0; page < MemoryPages::PAGES; ++page)
+		{
+			if (snapshot->pages.isSet(page))
+			{
+				memory->loadBlock(source, page * MemoryPages::PAGE_BYTES, MemoryPages::PAGE_BYTES);
+				source += MemoryPages::PAGE_BYTES;
+			}
+		}
+		//Memory is now the base except for those pages
+		memory->setDirtyPages(snapshot->pages);
+		snapshotBase = base.id;
+	}
+	else
+	{
+		memory->loadBlock(snapshot->memoryData.data(), 0, snapshot->memoryData.size());
+		memory->setDirtyPages(MemoryPages::none());
+		snapshotBase = snapshot->id;
+	}
+	flushBlockCache();
 }
@@ -8,124 +8,303 @@
 #include "processor.hpp"
 #include <cstdint>
 #include "memory.hpp"
+#include "blockCache.hpp"
 #include <ostream>
 #include <array>
 #include <iostream>
 #include <string>
 #include <functional>
 #include <initializer_list>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+
+// register pairs are stored in host byte order so each can be read as
+// one uint16_t; every compiler this builds with on a big-endian host
+// defines __BYTE_ORDER__ (MSVC targets are all little-endian)
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define REGISTERS8080_BIG_ENDIAN
+#endif
 
 /*
- * State for the 8080 Emulator. 
- * Internally maintains the registers of an 8080 processor.
- * 
- * Public Interface:
- * a, b, c, d, e, h, l, pc, sp, are all publicly accessible data members.
- * these represent registers and are uint8_t.
+ * Register file of the 8080, a plain trivially copyable struct.
+ * Copying it (or memcpy) is a complete copy of the processor registers,
+ * flags included, with no allocation and no vtable.
+ *
+ * a, b, c, d, e, h, l (uint8_t) and sp, pc (uint16_t) are public.
+ * BC, DE and HL are laid out as native 16-bit words, so getBC()/setBC()
+ * and friends are single loads and stores.
+ *
+ * Flags go through the methods below; flagsRegister, pendingFlags,
+ * lazyResult and lazyCarries are only public to keep the struct a POD.
  * 
- * State8080::flag defines symbols to represent the different flags:
+ * Registers8080::flag defines symbols to represent the different flags:
  * S,Z,AC,P,CY [Sign, Zero, Auxiliary Carry, Parity, CarrY]
  * 
  * getFlags() returns a uint8_t representing the current flags state
  * loadFlags(uint8_t) replaces the flags byte with a supplient uint8_t
- * isFlag(State8080::flag) tests a flag (true=set, false=unset)
- * setFlag(State8080::flag) sets a flag to 1/true
- * unSetFlag(State8080::flag) unsets a flag to 0/false
- * complementFlag(State8080::flag) flips the value of a flag
+ * isFlag(Registers8080::flag) tests a flag (true=set, false=unset)
+ * setFlag(Registers8080::flag) sets a flag to 1/true
+ * unSetFlag(Registers8080::flag) unsets a flag to 0/false
+ * complementFlag(Registers8080::flag) flips the value of a flag
+ * replaceFlags(uint8_t, mask) overwrites the flags selected by mask
+ * deferFlags(result, carries) records an ALU result instead of setting
+ *     S, Z, P and AC; they are worked out the next time a flag is read.
+ *     carries is operand ^ operand ^ result of the equivalent addition,
+ *     bit 4 of it is AC. CY is never deferred.
+ * clearRegisters() zeroes every register and resets the flags
+ */
+struct Registers8080 {
+    // meaningful names to work with flags
+    enum flag {S,Z,AC,P,CY};
+
+    // cpu registers, pairs first and in host byte order
+#ifdef REGISTERS8080_BIG_ENDIAN
+    uint8_t     b;
+    uint8_t     c;
+    uint8_t     d;
+    uint8_t     e;
+    uint8_t     h;
+    uint8_t     l;
+#else
+    uint8_t     c;
+    uint8_t     b;
+    uint8_t     e;
+    uint8_t     d;
+    uint8_t     l;
+    uint8_t     h;
+#endif
+    uint8_t     a;
+    // bit [5] is always 0; bit [1] is always 1
+    // flags still in pendingFlags are stale here
+    mutable uint8_t flagsRegister;
+    uint16_t    sp;
+    uint16_t    pc;
+
+    // S Z P AC bits of flagsRegister that have to be derived from the
+    // last recorded ALU result before they are read
+    mutable uint8_t pendingFlags;
+    uint8_t     lazyResult;
+    uint8_t     lazyCarries;
+
+    // bitmasks for teh different flags based on their storage in a byte
+    static constexpr uint8_t flagMasks[5] = {
+        0b1000'0000,    // S
+        0b0100'0000,    // Z
+        0b0001'0000,    // AC
+        0b0000'0100,    // P
+        0b0000'0001     // CY
+    };
+    static constexpr uint8_t DEFERRED_FLAGS = 0b1101'0100;
+
+    // byte offset of each pair in the struct
+    static constexpr int BC_PAIR = 0;
+    static constexpr int DE_PAIR = 2;
+    static constexpr int HL_PAIR = 4;
+
+    // read and write register pairs as words
+    uint16_t getBC() const { return loadPair(BC_PAIR); }
+    uint16_t getDE() const { return loadPair(DE_PAIR); }
+    uint16_t getHL() const { return loadPair(HL_PAIR); }
+    void setBC(uint16_t value) { storePair(BC_PAIR, value); }
+    void setDE(uint16_t value) { storePair(DE_PAIR, value); }
+    void setHL(uint16_t value) { storePair(HL_PAIR, value); }
+
+    // zero every register, flags hold only their constant bits
+    void clearRegisters() {
+        std::memset(this, 0, sizeof(struct Registers8080));
+        flagsRegister = 0b0000'0010;
+    }
+
+    // access the flags
+    uint8_t     getFlags() const { 
+        if (pendingFlags) resolveFlags();
+        return flagsRegister; 
+    }
+
+    // restore flags from a byte
+    void        loadFlags(uint8_t flagByte) {
+        pendingFlags = 0;
+        flagsRegister = flagByte;
+        // make sure constant bits are correct
+        // bit [5] is always 0; bit [1] is always 1
+        flagsRegister &= 0b1101'0111;
+        flagsRegister |= 0b0000'0010;
+    }
+
+    // return the state of a flag
+    // a pending flag is read straight from the recorded result
+    bool isFlag(Registers8080::flag whichFlag) const {
+        if (pendingFlags & flagMasks[whichFlag]) {
+            switch (whichFlag) {
+                case S: return static_cast<bool>(lazyResult & 0x80);
+                case Z: return lazyResult == 0;
+                case P: return isLazyParityEven();
+                default: return static_cast<bool>(lazyCarries & 0x10);
+            }
+        }
+        return static_cast<bool>(flagsRegister & flagMasks[whichFlag]);
+    }
+    // flag is true
+    void setFlag(Registers8080::flag whichFlag) {
+        pendingFlags &= ~flagMasks[whichFlag];
+        flagsRegister |= flagMasks[whichFlag];
+    }
+    // flag is false
+    void unSetFlag(Registers8080::flag whichFlag) {
+        pendingFlags &= ~flagMasks[whichFlag];
+        flagsRegister &= ~flagMasks[whichFlag];
+    }
+    // flag is !flag
+    void complementFlag(Registers8080::flag whichFlag){
+        if (pendingFlags & flagMasks[whichFlag]) resolveFlags();
+        flagsRegister ^= flagMasks[whichFlag];
+    }
+    // replace the flags selected by mask with those of a flags byte
+    // (a lookup table entry); the constant bits are not fixed up
+    void replaceFlags(uint8_t flagByte, uint8_t mask) {
+        pendingFlags &= ~mask;
+        flagsRegister = (flagsRegister & ~mask) | (flagByte & mask);
+    }
+    // defer S Z P AC to the next read, see above
+    void deferFlags(uint8_t result, uint8_t carries) {
+        lazyResult = result;
+        lazyCarries = carries;
+        pendingFlags = DEFERRED_FLAGS;
+    }
+
+    // true if other holds the same registers and flags, however the
+    // flags of either are currently recorded
+    bool isSameState(const struct Registers8080 &other) const {
+        return (getBC() == other.getBC()) && (getDE() == other.getDE())
+            && (getHL() == other.getHL()) && (a == other.a)
+            && (sp == other.sp) && (pc == other.pc)
+            && (getFlags() == other.getFlags());
+    }
+
+    private:
+        // read the pair starting at offset as one native word
+        uint16_t loadPair(int offset) const {
+            uint16_t pair;
+            std::memcpy(
+                &pair, reinterpret_cast<const uint8_t*>(this) + offset, 2
+            );
+            return pair;
+        }
+        void storePair(int offset, uint16_t pair) {
+            std::memcpy(reinterpret_cast<uint8_t*>(this) + offset, &pair, 2);
+        }
+
+        // true if the last recorded result has even parity
+        bool isLazyParityEven() const {
+            // parity algorithm: https://www.freecodecamp.org/news/algorithmic-problem-solving-efficiently-computing-the-parity-of-a-stream-of-numbers-cd652af14643/
+            uint8_t parity = lazyResult;
+            parity ^= parity >> 4;
+            parity ^= parity >> 2;
+            parity ^= parity >> 1;
+            return !(parity & 0x01);
+        }
+
+        // work out the pending flags and store them in flagsRegister
+        void resolveFlags() const {
+            uint8_t resolved = 
+                (lazyResult & flagMasks[S])
+                | ((lazyResult == 0) ? flagMasks[Z] : 0)
+                | (isLazyParityEven() ? flagMasks[P] : 0)
+                | (lazyCarries & flagMasks[AC]);
+            flagsRegister = 
+                (flagsRegister & ~pendingFlags) | (resolved & pendingFlags);
+            pendingFlags = 0;
+        }
+};
+
+static_assert(
+    std::is_trivial<struct Registers8080>::value 
+        && std::is_standard_layout<struct Registers8080>::value,
+    "Registers8080 must stay a POD"
+);
+static_assert(
+    (offsetof(struct Registers8080, h) < 6) 
+        && (offsetof(struct Registers8080, l) < 6)
+        && (sizeof(struct Registers8080) <= 64),
+    "register pairs must come first and the file fit in a cache line"
+);
+
+/*
+ * State for the 8080 Emulator, as seen through the generic State
+ * interface of processor.hpp. Adapts Registers8080, which holds every
+ * register and flag.
  * 
  * clone() reurns a unique_ptr to a copy of the current state
+ * loadState() copies in the registers of another state
+ * registers() gives the plain register file
  */
-struct State8080 : State {
+struct State8080 : State, Registers8080 {
     private:
         virtual struct State8080* doClone() const {
             // a allocate a new State8080 on the heap
             // this is a private method to allow States to be polymorphic
-            struct State8080*temp = new struct State8080;
-            temp->a = this->a;
-            temp->b = this->b;
-            temp->c = this->c;
-            temp->d = this->d;
-            temp->e = this->e;
-            temp->h = this->h;
-            temp->l = this->l;
-            temp->sp = this->sp;
-            temp->pc = this->pc;
-            temp->flagsRegister = this->flagsRegister;
-            return temp;
-        }
-        // bitmasks for teh different flags based on their storage in a byte
-        const uint8_t flagMasks[5] = {
-            0b1000'0000,    // S
-            0b0100'0000,    // Z
-            0b0001'0000,    // AC
-            0b0000'0100,    // P
-            0b0000'0001     // CY
-        };
-
-        // bit [5] is always 0; bit [1] is always 1
-        uint8_t flagsRegister = 0b0000'0010;
+            return new struct State8080(*this);
+        }
     public:
-        // meaningful names to work with flags
-        enum flag {S,Z,AC,P,CY};
+        // all registers zero
+        State8080() { this->clearRegisters(); }
+        // wrap a register file
+        explicit State8080(const struct Registers8080 &registers) : 
+                Registers8080(registers) {}
+
         // public clone interface, converts the private raw pointer into 
         // a unique_ptr, transferring ownership of the copy to the caller
         std::unique_ptr<struct State8080> clone() const {
             return std::unique_ptr<struct State8080>(doClone());
         }
 
-        // cpu registers
-        uint8_t     a;    
-        uint8_t     b;    
-        uint8_t     c;    
-        uint8_t     d;    
-        uint8_t     e;    
-        uint8_t     h;    
-        uint8_t     l;    
-        uint16_t    sp;
-        uint16_t    pc;
-
-        // access the flags
-        uint8_t     getFlags() { return flagsRegister; }
-
-        // restore flags from a byte
-		void        loadFlags(uint8_t flagByte) {
-			flagsRegister = flagByte;
-			// make sure constant bits are correct
-			// bit [5] is always 0; bit [1] is always 1
-			flagsRegister &= 0b1101'0111;
-			flagsRegister |= 0b0000'0010;
-		}
-
         // load a state
         void loadState(std::unique_ptr<struct State8080> newState) {
-            this->a = newState->a;
-            this->b = newState->b;
-            this->c = newState->c;
-            this->d = newState->d;
-            this->e = newState->e;
-            this->h = newState->h;
-            this->l = newState->l;
-            this->sp = newState->sp;
-            this->pc = newState->pc;
-            this->loadFlags(newState->getFlags());
-        }
-  
-        // return the state of a flag
-        bool isFlag(State8080::flag whichFlag) {
-            return static_cast<bool>(flagsRegister & flagMasks[whichFlag]);
-        }
-        // flag is true
-        void setFlag(State8080::flag whichFlag) {
-            flagsRegister |= flagMasks[whichFlag];
-        }
-        // flag is false
-        void unSetFlag(State8080::flag whichFlag) {
-            flagsRegister &= ~flagMasks[whichFlag];
-        }
-        // flag is !flag
-        void complementFlag(State8080::flag whichFlag){
-            flagsRegister ^= flagMasks[whichFlag];
+            this->registers() = newState->registers();
         }
+
+        // the register file on its own
+        struct Registers8080 &registers() { return *this; }
+        const struct Registers8080 &registers() const { return *this; }
+};
+
+/*
+ * Native (C++) replacement for emulated code starting at a fixed address.
+ * Called with the registers, the memory and the cycles left in the
+ * current runCycles() batch. Registers and memory must end up exactly as
+ * if the emulated code had run, and the hook must stop exactly where the
+ * interpreter would: it may only finish a pass whose last instruction
+ * starts while budget is still unused. Returns the cycles used (0 to
+ * decline, the instruction at pc then runs normally) and adds the
+ * emulated instructions it replaced to instructions.
+ */
+typedef std::function<int(
+    struct Registers8080 &registers, Memory &memory, int budget,
+    unsigned long long &instructions
+)> NativeHook8080;
+
+/*
+ * Bookkeeping of runCycles() for spotting a spin loop: a loop that only
+ * reads memory and changes registers and flags.
+ * A jump going backward marks a loop head; any instruction with side
+ * effects clears it. If the head is reached again with the registers
+ * unchanged, every further pass would repeat the last one exactly.
+ * Registers are only copied from the second visit on, so loops that store
+ * cost a few writes per pass. Loops that keep changing registers are
+ * compared less and less often; a comparison then spans several passes,
+ * which are skipped together.
+ */
+struct SpinWatch8080 {
+    uint16_t address; // loop head, target of the last backward jump
+    // visits to address since the last side effect: 0, 1, or 2 once
+    // registers holds the state of a recorded visit
+    int visits;
+    int backoff; // visits let pass after the last failed comparison
+    int wait; // visits still to let pass before comparing
+    int cycles; // batch cycles at the recorded visit
+    unsigned long long instructions; // batch instructions at that point
+    struct Registers8080 registers;
 };
 
 /*
@@ -135,15 +314,85 @@ struct State8080 : State {
 class Emulator8080 : 
         public Processor<struct State8080, Memory> {
     public:
+        // selects how opcodes are dispatched
+        // TABLE: lookup table of std::function callables (original core)
+        // SWITCH: flat switch over all 256 opcodes, no type erasure
+        // BLOCK: switch core fed from a cache of pre-decoded basic blocks
+        enum core {TABLE, SWITCH, BLOCK};
+
         // default constructor
-        Emulator8080();
+        Emulator8080(Emulator8080::core dispatchCore = TABLE);
         // construct with a memory attached
-        Emulator8080(Memory *memoryDevice);
+        Emulator8080(
+            Memory *memoryDevice, Emulator8080::core dispatchCore = TABLE
+        );
         ~Emulator8080();
         int step() override; // "execute" an instruction
         void reset(uint16_t address = 0x0000); // put the pc at an address
 
-		inline bool isInterruptEnable() { return enableInterrupts; }
+        // execute instructions in one tight loop until at least budget
+        // cycles have been used or the processor halts. returns the cycles
+        // actually used; anything above budget is the overshoot of the last
+        // instruction. interrupts are not checked inside the loop.
+        // after HLT with interrupts enabled the rest of the budget passes
+        // idle and is included in the return; after HLT with interrupts
+        // disabled the batch ends early, see isDeadlocked()
+        virtual int runCycles(int budget);
+
+		inline bool isInterruptEnable() const { return enableInterrupts; }
+
+        // true after HLT until the next interrupt
+        // step() returns 0 cycles while halted
+        inline bool isHalted() const { return halted; }
+
+        // restore the interrupt enable and HLT flags, for snapshots and
+        // save states; registers go through loadRegisters()
+        inline void loadInterruptState(bool isEnabled, bool isHalted) {
+            enableInterrupts = isEnabled;
+            halted = isHalted;
+        }
+
+        // true after HLT with interrupts disabled: no interrupt can be
+        // accepted, so the processor never runs again
+        inline bool isDeadlocked() const { 
+            return halted && !enableInterrupts; 
+        }
+
+        // emulated cycles runCycles() spent halted waiting for an interrupt
+        inline unsigned long long getIdleCycles() const { return idleCycles; }
+
+        // cycles the running runCycles() batch had used when the current
+        // OUT or IN started. only meaningful inside the port callbacks;
+        // 0 between batches
+        inline int getBatchCycles() const { return batchCycles; }
+
+        // number of instructions executed since construction
+        inline unsigned long long getInstructionCount() const { 
+            return instructionCount; 
+        }
+
+        // read the program counter without copying the whole state
+        inline uint16_t getProgramCounter() const { return state.pc; }
+
+        // copy the register file out or in, no allocation
+        // cheaper than getState() for debuggers and rewind
+        inline struct Registers8080 getRegisters() const { 
+            return state.registers(); 
+        }
+        inline void loadRegisters(const struct Registers8080 &registers) {
+            state.registers() = registers;
+        }
+
+        // report which opcode dispatch core this emulator was built with
+        Emulator8080::core getCore() const { return dispatchCore; }
+
+        // hit/miss/invalidation counters of the BLOCK core, all 0 otherwise
+        struct BlockCacheStatistics getBlockCacheStatistics() const;
+
+        // drop every pre-decoded block. the BLOCK core sees stores made by
+        // the emulated program, but memory changed from outside the
+        // emulator (loading a program, a snapshot) needs a flush
+        void flushBlockCache();
 
         // connectMemory(Memory*) provided by paretnt class
 
@@ -155,14 +404,38 @@ class Emulator8080 :
         // function returns value, argument in port address
         void connectInput(std::function<uint8_t(uint8_t)> inputFunction);
 
+        // run hook instead of the code at address whenever runCycles()
+        // reaches it (the block core checks at block entry only).
+        // step() and interrupts always interpret.
+        void registerHook(uint16_t address, NativeHook8080 hook);
+        // remove every hook
+        void clearHooks();
+        // emulated cycles run by hooks so far
+        inline unsigned long long getHookCycles() const { return hookCycles; }
+
+        // the switch and block cores skip whole passes of a spin loop
+        // (see SpinWatch8080) that fit in the budget, counting the cycles
+        // and instructions as if they ran. on by default; the table core
+        // always runs every instruction
+        inline void setSpinDetection(bool isEnabled) { 
+            isSpinDetection = isEnabled;
+        }
+        // emulated cycles skipped in spin loops so far
+        inline unsigned long long getSpinCycles() const { return spinCycles; }
+
         // request an interrupt. Accepts a one-byte 8080 opcode
         // returns the number of CPU clock cycles to process the interrupt
         int requestInterrupt(uint8_t opcode);
 				
 		std::unique_ptr<class Snapshot> TakeSnapshot();
+		// delta snapshot: only the memory pages written since base, a full
+		// snapshot of this emulator, was taken or loaded. A base the
+		// memory's dirty pages do not count from gets every page
+		std::unique_ptr<class Snapshot> TakeSnapshot(std::shared_ptr<const class Snapshot> base);
+		// loads full and delta snapshots alike
 		void LoadSnapshot(std::unique_ptr<class Snapshot> snapshot);
 		
-    private:
+    protected:
         // fetch instruction at address
         uint8_t fetch(uint16_t address);
 
@@ -175,6 +448,90 @@ class Emulator8080 :
 
         void buildMap(); // populate the lookup table
 
+        // opcode dispatch core selected at construction
+        Emulator8080::core dispatchCore;
+
+        // fetch the immediate operand (0, 1 or 2 bytes) following an opcode
+        // for single steps on the block core
+        template<class memoryType>
+        uint16_t fetchOperand(memoryType &bus, uint8_t opcode);
+
+        // execute an opcode through a flat switch. operand gives the
+        // immediate byte() or word() following it, read from bus as it is
+        // needed or decoded ahead (see emulator.cpp)
+        // every memory access goes through bus, see BoundEmulator8080
+        // returns the number of cycles used
+        template<class memoryType, class operandType>
+        int executeSwitch(
+            memoryType &bus, uint8_t opcode, const operandType &operand
+        );
+
+        // body of runCycles() for the switch core
+        template<class memoryType>
+        int runSwitch(memoryType &bus, int budget);
+
+        // instructions executed by step() and runCycles()
+        unsigned long long instructionCount;
+
+        // call and return through a concrete memory type
+        template<class memoryType>
+        void callAddress(memoryType &bus, uint16_t address, bool isReset = false);
+        template<class memoryType>
+        int ret(memoryType &bus);
+
+        // decoded blocks, only allocated for the BLOCK core
+        std::unique_ptr<BlockCache8080> blockCache;
+        // id of the full snapshot the memory's dirty pages count from
+        unsigned long long snapshotBase = 0;
+
+        // native hooks, hookSlots[address] is 1 + index into hooks
+        // or 0; both are empty until the first hook is registered
+        std::vector<NativeHook8080> hooks;
+        std::vector<uint8_t> hookSlots;
+        unsigned long long hookCycles;
+
+        // true if a hook is registered at address
+        inline bool isHooked(uint16_t address) const {
+            return !hookSlots.empty() && hookSlots[address];
+        }
+        // run the hook at pc with budget cycles left, see NativeHook8080
+        int callHook(int budget, unsigned long long &instructions);
+
+        // spin loop skipping, see setSpinDetection()
+        bool isSpinDetection;
+        unsigned long long spinCycles;
+        // called when a jump went backward after cycles and instructions
+        // of the batch. records the loop head or skips passes of a spin;
+        // returns the cycles skipped, spin.instructions then holds the
+        // batch instructions including the skipped ones
+        int skipSpin(
+            struct SpinWatch8080 &spin, int cycles, int budget, 
+            unsigned long long instructions
+        );
+
+        // halt scheduling, see runCycles()
+        unsigned long long idleCycles;
+        // batch position of the last OUT or IN, see getBatchCycles()
+        int batchCycles;
+        // returns the cycles a batch that used cycles of budget accounts
+        int idleUntil(int cycles, int budget);
+
+        // decode the block entered at address and add it to the cache
+        template<class memoryType>
+        struct BasicBlock8080 *buildBlock(memoryType &bus, uint16_t address);
+
+        // body of runCycles() for the block core
+        template<class memoryType>
+        int runBlocks(memoryType &bus, int budget);
+
+        // executeSwitch() with stores checked against cached blocks
+        // used for single steps and interrupts on the block core
+        template<class memoryType>
+        int executeWatched(memoryType &bus, uint8_t opcode, uint16_t operand);
+
+        // evaluate the condition encoded in bits 3-5 of a Jcc/Ccc/Rcc opcode
+        bool testCondition(uint8_t opcode);
+
         // hold the callback for OUT instruction
         // arguments are port, value
         std::function<void(uint8_t,uint8_t)> outputCallback;
@@ -191,11 +548,6 @@ class Emulator8080 :
         uint16_t getDE();
         uint16_t getHL();
 
-        // flag calculators
-        void updateZeroFlag(uint8_t value);
-        void updateSignFlag(uint8_t value);
-        void updateParityFlag(uint8_t value);
-
         // logical and arithmetic helpers
         uint8_t incrementValue(uint8_t value);
         uint8_t decrementValue(uint8_t value);
@@ -209,6 +561,17 @@ class Emulator8080 :
         uint8_t xorWithAccumulator(uint8_t value);
         uint8_t orWithAccumulator(uint8_t value);
 
+        // the same operations on the accumulator as branch-free lookups
+        // into ALU_TABLES (aluTables.hpp), used by the switch/block cores
+        uint8_t lookupAdd(uint8_t addend, bool withCarry = false);
+        uint8_t lookupSubtract(uint8_t subtrahend, bool withCarry = false);
+        uint8_t lookupIncrement(uint8_t value);
+        uint8_t lookupDecrement(uint8_t value);
+        uint8_t lookupAnd(uint8_t value);
+        uint8_t lookupOr(uint8_t value);
+        uint8_t lookupXor(uint8_t value);
+        uint8_t lookupDecimalAdjust();
+
 
         // encapusulate call procedures
         void callAddress(uint16_t address, bool isReset = false);
@@ -230,6 +593,33 @@ class Emulator8080 :
      
 };
 
+/*
+ * Emulator8080 variant statically bound to a concrete memory class.
+ * Runs the switch or block core, with every fetch, load and store calling
+ * memoryType directly instead of through the virtual Memory interface.
+ * With a final memoryType (SpaceInvaderMemory) the address mask and ROM
+ * write protection inline into each opcode.
+ * 
+ * Instantiated for SpaceInvaderMemory, and run by the headless cabinet.
+ * The disassembler and the CP/M tools keep using the polymorphic
+ * Emulator8080.
+ */
+template<class memoryType>
+class BoundEmulator8080 : public Emulator8080 {
+    public:
+        // default constructor
+        // throws std::invalid_argument for the TABLE core
+        BoundEmulator8080(Emulator8080::core dispatchCore = SWITCH);
+        // construct with a memory attached
+        BoundEmulator8080(
+            memoryType *memoryDevice, Emulator8080::core dispatchCore = SWITCH
+        );
+        int step() override; // "execute" an instruction
+        int runCycles(int budget) override; // run a batch of instructions
+        // throws std::invalid_argument if memoryDevice is not a memoryType
+        void connectMemory(Memory *memoryDevice) override;
+};
+
 /*
  * A meaningful exception to throw if the "processor" encounters an
  * interrupt that cannot be processed
@@ -0,0 +1,96 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+
+Frame pacer. Replaces polling the clock in a busy loop with a sleep up to
+just before each deadline. Sleeps can overshoot by a scheduler tick, so
+the last stretch (spinMargin) is spent checking the clock instead.
+
+https://en.cppreference.com/w/cpp/thread/sleep_until
+*/
+
+#include "framePacer.hpp"
+#include <thread>
+#include <cmath>
+
+FramePacer::FramePacer(
+	std::chrono::nanoseconds period,
+	std::chrono::nanoseconds spinMargin,
+	int maxCatchUp
+) : _period(period), _spinMargin(spinMargin),
+	_maxCatchUp((maxCatchUp > 0) ? maxCatchUp : 1)
+{
+	resetJitter();
+	restart();
+}
+
+int FramePacer::wait()
+{
+	Clock::time_point now = Clock::now();
+	if (now < _nextDeadline)
+	{
+		//Sleep through most of the wait, the host cpu is free meanwhile
+		if (_nextDeadline - now > _spinMargin)
+		{
+			std::this_thread::sleep_until(_nextDeadline - _spinMargin);
+		}
+		//Then spin on the clock to hit the deadline closely
+		while ((now = Clock::now()) < _nextDeadline)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	//Record how late we are
+	std::chrono::duration<double, std::micro> lateness = now - _nextDeadline;
+	++_frames;
+	_latenessSum += lateness.count();
+	_latenessSquareSum += lateness.count() * lateness.count();
+	if (lateness.count() > _maxLateness)
+	{
+		_maxLateness = lateness.count();
+	}
+
+	//Every period that has started is due. Deadlines move in whole
+	//periods so they stay on the original grid
+	int due = 1 + static_cast<int>((now - _nextDeadline) / _period);
+	if (due > _maxCatchUp)
+	{
+		//Too far behind to catch up, give up the extra periods
+		_dropped += due - _maxCatchUp;
+		due = _maxCatchUp;
+		_nextDeadline = now + _period;
+	}
+	else
+	{
+		_nextDeadline += due * _period;
+	}
+	return due;
+}
+
+void FramePacer::restart()
+{
+	_nextDeadline = Clock::now() + _period;
+}
+
+FrameJitter FramePacer::getJitter() const
+{
+	FrameJitter jitter = {_frames, _dropped, 0.0, _maxLateness, 0.0};
+	if (_frames > 0)
+	{
+		jitter.meanLateness = _latenessSum / _frames;
+		double variance = _latenessSquareSum / _frames
+			- jitter.meanLateness * jitter.meanLateness;
+		jitter.standardDeviation = (variance > 0.0) ? std::sqrt(variance) : 0.0;
+	}
+	return jitter;
+}
+
+void FramePacer::resetJitter()
+{
+	_frames = 0;
+	_dropped = 0;
+	_latenessSum = 0.0;
+	_latenessSquareSum = 0.0;
+	_maxLateness = 0.0;
+}
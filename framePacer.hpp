@@ -0,0 +1,59 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+#pragma once
+#include <chrono>
+
+//Frame timing measured by a FramePacer, all times in microseconds
+struct FrameJitter
+{
+	unsigned long long frames; //deadlines waited for
+	unsigned long long dropped; //periods given up after a long stall
+	double meanLateness; //how late wait() returned, on average
+	double maxLateness;
+	double standardDeviation; //of the lateness
+};
+
+//Paces a loop to a fixed period with little host cpu. wait() sleeps until
+//shortly before the next deadline and spins for the rest. Deadlines are
+//whole periods from the start, so lateness in one period does not push
+//the later ones back and no drift builds up.
+class FramePacer
+{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		//period between deadlines, time left to spin instead of sleep, and
+		//the most periods wait() reports as due after a stall
+		FramePacer(
+			std::chrono::nanoseconds period,
+			std::chrono::nanoseconds spinMargin = std::chrono::microseconds(1500),
+			int maxCatchUp = 4
+		);
+
+		//Block until the next deadline. Returns how many periods are due,
+		//1 normally and more if the caller fell behind. When more than
+		//maxCatchUp periods are due the extra ones are dropped and the
+		//deadlines restart from now.
+		int wait();
+
+		//Restart the deadlines from now, keeping the statistics
+		void restart();
+
+		FrameJitter getJitter() const;
+		void resetJitter();
+
+	private:
+		std::chrono::nanoseconds _period;
+		std::chrono::nanoseconds _spinMargin;
+		int _maxCatchUp;
+		Clock::time_point _nextDeadline;
+
+		//Running sums for getJitter()
+		unsigned long long _frames;
+		unsigned long long _dropped;
+		double _latenessSum;
+		double _latenessSquareSum;
+		double _maxLateness;
+};
@@ -0,0 +1,824 @@
+/*
+ *  Headless Space Invaders cabinet: runs Machine without a window or sound
+ *  for a number of frames, driven by an optional input script, and can
+ *  dump frames as images. It can record the input as a movie, or replay a
+ *  movie as fast as it runs and check it ends as recorded.
+ */
+
+#ifdef _WIN32
+#define TCLAP_NAMESTARTSTRING "~~"
+#define TCLAP_FLAGSTARTSTRING "/"
+#endif
+
+#include "tclap/CmdLine.h"
+#include <string>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <chrono>
+#include "memory.hpp"
+#include "emulator.hpp"
+#include "machine.hpp"
+#include "platformAdapter.hpp"
+#include "invadersHooks.hpp"
+#include "videoRenderer.hpp"
+#include "soundMixer.hpp"
+#include "inputMovie.hpp"
+
+// size of the complete Space Invaders ROM
+const int ROM_BYTES = 0x2000;
+
+/*
+ * Struct holding the arguments retrieved from the command line
+ */
+struct headlessArguments {
+    std::string romDirectory;
+    int frames;
+    Emulator8080::core dispatchCore;
+    std::string scriptFileName;
+    std::string dumpDirectory;
+    int dumpInterval;
+    bool isRealTime;
+    bool isPulling;
+    bool isHooked;
+    bool isSplit;
+    std::string audioFileName;
+    std::string soundDirectory;
+    std::string recordFileName;
+    std::string replayFileName;
+};
+
+/*
+ * One scripted change of a cabinet input
+ */
+struct inputEvent {
+    std::string input; // coin, p1start, p1shoot, p1left, ...
+    bool isDown;
+};
+
+/*
+ * Invoke parser from TCLAP library to process the command line
+ * Returns nullptr on failure.
+ */
+std::unique_ptr<struct headlessArguments> parseArguments(
+    int argumentCount, char *argumentVector[]
+);
+
+/*
+ * Read the ROM from directory: either the single 8 KB file "invaders" or
+ * the four 2 KB parts invaders.h, .g, .f and .e in address order.
+ * Returns an empty vector on failure.
+ */
+std::vector<uint8_t> loadInvadersROM(const std::string &directory);
+
+/*
+ * Build the cabinet's cpu on memory. The switch and block cores run bound
+ * to SpaceInvaderMemory, so every memory access inlines; the table core
+ * has no bound form and runs on the polymorphic emulator.
+ */
+std::unique_ptr<Emulator8080> buildEmulator(
+    SpaceInvaderMemory &memory, Emulator8080::core dispatchCore
+);
+
+/*
+ * Read an input script. Each line is "<frame> <input> <down|up>"; blank
+ * lines and lines starting with # are skipped. Inputs are coin, p1start,
+ * p2start, p1shoot, p1left, p1right, p2shoot, p2left and p2right.
+ * Returns false and reports the line on a syntax error.
+ */
+bool loadInputScript(
+    const std::string &fileName,
+    std::multimap<unsigned long long, struct inputEvent> &script
+);
+
+/*
+ * Apply one scripted event to the adapter. Returns false for an unknown
+ * input name.
+ */
+bool applyInputEvent(Adapter &adapter, const struct inputEvent &event);
+
+/*
+ * Route the cabinet's sound callbacks to the mixer's event queue, stamped
+ * with the emulated cycle of the OUT behind each
+ */
+void connectSounds(Adapter &adapter, SoundMixer &mixer);
+
+/*
+ * Stand in for an audio device that pulls its sound through a callback:
+ * hand sink every block the device would have asked for by host time
+ * since start, mixed on demand. pulled counts the samples handed over.
+ */
+void pullDeviceSamples(
+    SoundMixer &mixer, SoundSink &sink,
+    std::chrono::steady_clock::time_point start, unsigned long long &pulled
+);
+
+/*
+ * Write the screen held in video RAM as a binary PPM image, upright and
+ * coloured by the gel. pixels holds the last frame dumped (or is empty);
+ * only the video RAM columns written since then are converted again.
+ */
+bool dumpFrame(
+    const VideoRenderer &renderer, SpaceInvaderMemory &memory, 
+    std::vector<uint32_t> &pixels, const std::string &fileName
+);
+
+/*
+ * Write WIDTH * HEIGHT 0x00RRGGBB pixels as a binary PPM image
+ */
+bool writeImage(
+    const std::vector<uint32_t> &pixels, const std::string &fileName
+);
+
+int main(int argc, char *argv[]) {
+    std::ios_base::sync_with_stdio(false);
+    std::unique_ptr<struct headlessArguments> args =
+        parseArguments(argc, argv);
+    if (!args) {
+        return 1;
+    }
+
+    std::vector<uint8_t> rom = loadInvadersROM(args->romDirectory);
+    if (rom.empty()) {
+        std::cerr << "Could not load the Space Invaders ROM from: "
+            << args->romDirectory << '\n';
+        return 1;
+    }
+
+    std::multimap<unsigned long long, struct inputEvent> script;
+    if (
+        !args->scriptFileName.empty()
+        && !loadInputScript(args->scriptFileName, script)
+    ) {
+        return 1;
+    }
+    bool isRecording = !args->recordFileName.empty();
+    bool isReplaying = !args->replayFileName.empty();
+    if (isReplaying && (isRecording || !args->scriptFileName.empty())) {
+        std::cerr << "A replay takes its input from the movie alone" << '\n';
+        return 1;
+    }
+    InputMovie movie;
+    if (isReplaying) {
+        // a replay never waits for host time
+        args->isRealTime = false;
+        try {
+            movie.read(args->replayFileName);
+        } catch (const InputMovieError& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    // wire up the cabinet
+    SpaceInvaderMemory memory;
+    memory.flashROM(rom.data());
+    std::unique_ptr<Emulator8080> cpu = 
+        buildEmulator(memory, args->dispatchCore);
+    Emulator8080 &emulator = *cpu;
+    emulator.reset(0x0000);
+    if (args->isHooked) installInvadersHooks(emulator, memory);
+    Adapter adapter;
+    Machine machine;
+    machine.setPlatformAdapter(&adapter);
+    machine.setEmulator(&emulator);
+    machine.setTurbo(!args->isRealTime);
+
+    // frames are only drawn when they are dumped
+    bool isDumping = !args->dumpDirectory.empty();
+    bool isDumpFailed = false;
+    VideoRenderer renderer;
+    std::vector<uint32_t> pixels;
+    if (isDumping) {
+        machine.setRenderPolicy(
+            Machine::RENDER_EVERY_NTH_FRAME, args->dumpInterval
+        );
+        if (args->isSplit) {
+            // each half is converted as the beam finishes it, the refresh
+            // only writes the result
+            pixels.resize(VideoRenderer::WIDTH * VideoRenderer::HEIGHT);
+            machine.setVideoMemory(&memory);
+            machine.setSplitRendering(true);
+            adapter.setRenderColumnsFunction(
+                [&](const uint8_t *const *videoStrips, int firstColumn, int columns) {
+                    renderer.update32(
+                        videoStrips, 
+                        memory.takeDirtyColumns(firstColumn, columns), 
+                        pixels.data()
+                    );
+                }
+            );
+        }
+        adapter.setRefreshScreenFunction([&]() {
+            std::stringstream fileName;
+            fileName << args->dumpDirectory << "/frame"
+                << std::setw(6) << std::setfill('0') << machine.getFrames()
+                << ".ppm";
+            bool isWritten = args->isSplit
+                ? writeImage(pixels, fileName.str())
+                : dumpFrame(renderer, memory, pixels, fileName.str());
+            if (!isWritten) {
+                isDumpFailed = true;
+            }
+        });
+    } else {
+        machine.setRenderPolicy(Machine::RENDER_NEVER);
+    }
+
+    // in real time sound is mixed on host time, on its own thread or with
+    // -u on demand as a device callback would pull it. otherwise it is
+    // rendered offline after every half frame, on emulated time.
+    // the sink is declared first so the mixer thread stops before it goes
+    bool isMixing = !args->audioFileName.empty();
+    std::unique_ptr<SoundSink> sink;
+    SoundMixer mixer;
+    if (isMixing) {
+        try {
+            mixer.loadSounds(args->soundDirectory);
+        } catch (const SoundFileError& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        if (args->audioFileName == "null") {
+            sink = std::make_unique<NullSoundSink>();
+        } else {
+            std::unique_ptr<WavFileSink> file = 
+                std::make_unique<WavFileSink>(args->audioFileName);
+            if (!file->isOpen()) {
+                std::cerr << "Could not write sound to: " 
+                    << args->audioFileName << '\n';
+                return 1;
+            }
+            sink = std::move(file);
+        }
+        connectSounds(adapter, mixer);
+        if (args->isRealTime && !args->isPulling) {
+            mixer.start(sink.get());
+        } else if (!args->isRealTime) {
+            // events are mixed after their half frame, no delay is needed
+            mixer.setClock(Machine::CPU_HZ, 0);
+            mixer.syncClock(machine.getCycles());
+        }
+    }
+    bool isRenderingSound = isMixing && !args->isRealTime;
+    bool isPullingSound = isMixing && args->isRealTime && args->isPulling;
+    unsigned long long samplesPulled = 0;
+
+    unsigned long long frames = static_cast<unsigned long long>(args->frames);
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::chrono::steady_clock::time_point pullStart =
+        std::chrono::steady_clock::now();
+    machine.resetSpeed();
+    try {
+        // a replay starts from the movie's state and runs to its end
+        if (isReplaying) {
+            movie.startReplay(emulator, memory, machine);
+            if (isRenderingSound) mixer.syncClock(machine.getCycles());
+        } else if (isRecording) {
+            movie.startRecording(emulator, memory, machine);
+        }
+        // scripted input takes effect from the start of its frame. it is
+        // applied as each half frame starts, since with -r step() runs as
+        // many half frames as are due
+        std::string unknownInput;
+        adapter.setHalfFrameInputFunction([&]() {
+            if ((machine.getHalfFrames() % 2) != 0) return;
+            auto events = script.equal_range(machine.getFrames());
+            for (auto event = events.first; event != events.second; ++event) {
+                if (
+                    !applyInputEvent(adapter, event->second) 
+                    && unknownInput.empty()
+                ) {
+                    unknownInput = event->second.input;
+                }
+            }
+        });
+        // a split frame ends a half frame after it is counted
+        bool isSplitDumping = isDumping && args->isSplit;
+        while (
+            (
+                isReplaying ? !movie.isReplayDone(machine)
+                : (
+                    (machine.getFrames() < frames)
+                    || (isSplitDumping && (machine.getHalfFrames() % 2) != 0)
+                )
+            )
+            && !isDumpFailed
+        ) {
+            machine.step();
+            adapter.setInputChanged(false);
+            if (!unknownInput.empty()) {
+                std::cerr << "Unknown input in script: " << unknownInput
+                    << '\n';
+                return 1;
+            }
+            if (isRenderingSound) {
+                mixer.renderUntil(machine.getCycles(), *sink);
+            } else if (isPullingSound) {
+                pullDeviceSamples(mixer, *sink, pullStart, samplesPulled);
+            }
+            if (machine.isDeadlocked()) {
+                std::cerr << "Processor halted with interrupts disabled at $"
+                    << std::hex << std::setw(4) << std::setfill('0')
+                    << emulator.getProgramCounter() << std::dec
+                    << " in frame " << machine.getFrames() << '\n';
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        // the emulator throws on illegal memory reads and unknown opcodes
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    auto stopTime = std::chrono::high_resolution_clock::now();
+    if (isRecording) {
+        movie.finishRecording(emulator, memory, machine);
+        try {
+            movie.write(args->recordFileName);
+        } catch (const InputMovieError& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    }
+    if (isDumpFailed) {
+        std::cerr << "Could not write frames to: " << args->dumpDirectory
+            << '\n';
+        return 1;
+    }
+
+    std::chrono::duration<double> runTime = stopTime - startTime;
+    double seconds = runTime.count();
+    std::cout << "Ran " << machine.getFrames() << " frames ("
+        << machine.getCycles() << " cycles, "
+        << emulator.getInstructionCount() << " instructions) in "
+        << seconds << " seconds." << std::endl;
+    std::cout << "Frames per second: " << machine.getFramesPerSecond()
+        << " (" << machine.getSpeedUp() << "x real time)." << std::endl;
+    std::cout << "Emulated clock speed: "
+        << (static_cast<double>(machine.getCycles()) / seconds) / 1.e6
+        << " MHz." << std::endl;
+    if (isDumping) {
+        std::cout << "Dumped " << machine.getFramesRendered()
+            << " frames to " << args->dumpDirectory << "." << std::endl;
+    }
+    if (isMixing) {
+        mixer.stop();
+        std::cout << "Mixed " << (static_cast<double>(mixer.getSamplesMixed())
+            / SoundMixer::SAMPLE_RATE) << " seconds of sound, "
+            << mixer.getDroppedEvents() << " events dropped, "
+            << mixer.getOverruns() << " blocks lost, "
+            << mixer.getResyncs() << " clock resyncs." << std::endl;
+    }
+    if (isRecording) {
+        std::cout << "Recorded " << movie.getEvents().size()
+            << " input changes to " << args->recordFileName 
+            << ", state checksum " << std::hex << std::setw(8) 
+            << std::setfill('0') << movie.getEnd().stateChecksum << std::dec
+            << "." << std::endl;
+    }
+    if (isReplaying) {
+        if (!movie.isReplayMatching(emulator, memory, machine)) {
+            std::cerr << "Replay of " << args->replayFileName
+                << " did not end as recorded" 
+                << (machine.isReplayDesynced() ? ", input came at other cycles" : "")
+                << '\n';
+            return 1;
+        }
+        std::cout << "Replayed " << movie.getEvents().size() 
+            << " input changes: the state checksum " << std::hex 
+            << std::setw(8) << std::setfill('0') 
+            << movie.getEnd().stateChecksum << std::dec 
+            << " matches the recording." << std::endl;
+    }
+    if (args->isRealTime) {
+        FrameJitter jitter = machine.getFrameJitter();
+        std::cout << "Half frame lateness: mean " << jitter.meanLateness
+            << " us, max " << jitter.maxLateness << " us, deviation "
+            << jitter.standardDeviation << " us, " << jitter.dropped
+            << " dropped." << std::endl;
+    }
+    return 0;
+}
+
+/*
+ * Invoke parser from TCLAP library to process the command line
+ * Returns nullptr on failure.
+ */
+std::unique_ptr<struct headlessArguments> parseArguments(
+    int argumentCount, char *argumentVector[]
+) {
+    std::unique_ptr<struct headlessArguments> args =
+        std::make_unique<struct headlessArguments>();
+    std::string coreName;
+    try {
+        // TCLAP Parser
+        TCLAP::CmdLine cmd(
+            "Headless Space Invaders cabinet",
+            ' ',
+            "0.1",
+            true
+        );
+
+        // directory holding the ROM
+        TCLAP::UnlabeledValueArg<std::string> romDirectoryArg(
+            "romDirectory",
+            "directory holding invaders or invaders.h/.g/.f/.e",
+            false,
+            "roms/invaders",
+            "string"
+        );
+        cmd.add(romDirectoryArg);
+
+        // length of the run
+        TCLAP::ValueArg<int> frames(
+            "f",
+            "frames",
+            "number of frames to run",
+            false,
+            3600,
+            "int"
+        );
+        cmd.add(frames);
+
+        // choose the opcode dispatch core
+        std::vector<std::string> cores;
+        cores.push_back("table");
+        cores.push_back("switch");
+        cores.push_back("block");
+        TCLAP::ValuesConstraint<std::string> coreValues(cores);
+        TCLAP::ValueArg<std::string> core(
+            "k",
+            "core",
+            "opcode dispatch core",
+            false,
+            "block",
+            &coreValues
+        );
+        cmd.add(core);
+
+        // scripted input
+        TCLAP::ValueArg<std::string> script(
+            "i",
+            "input",
+            "input script, lines of \"<frame> <input> <down|up>\"",
+            false,
+            "",
+            "string"
+        );
+        cmd.add(script);
+
+        // frame dumps
+        TCLAP::ValueArg<std::string> dumpDirectory(
+            "d",
+            "dump",
+            "directory to write frames to as PPM images",
+            false,
+            "",
+            "string"
+        );
+        cmd.add(dumpDirectory);
+        TCLAP::ValueArg<int> dumpInterval(
+            "e",
+            "every",
+            "with -d: dump every Nth frame",
+            false,
+            60,
+            "int"
+        );
+        cmd.add(dumpInterval);
+        TCLAP::SwitchArg split(
+            "s",
+            "split",
+            "with -d: convert each half of the screen at its interrupt",
+            false
+        );
+        cmd.add(split);
+
+        // pace to the cabinet's speed instead of running flat out
+        TCLAP::SwitchArg realTime(
+            "r",
+            "realtime",
+            "run at 60 frames per second instead of as fast as possible",
+            false
+        );
+        cmd.add(realTime);
+
+        // native hooks for the hot ROM loops
+        TCLAP::SwitchArg hooks(
+            "n",
+            "native",
+            "run the hot ROM loops as native hooks",
+            false
+        );
+        cmd.add(hooks);
+
+        // sound, rendered offline as fast as the emulation runs unless -r
+        TCLAP::ValueArg<std::string> audio(
+            "a",
+            "audio",
+            "mix the sound into this WAV file, or mix and discard it: null",
+            false,
+            "",
+            "string"
+        );
+        cmd.add(audio);
+        TCLAP::ValueArg<std::string> sounds(
+            "w",
+            "wavs",
+            "with -a: directory holding the sound effects 0.wav to 8.wav",
+            false,
+            "sounds",
+            "string"
+        );
+        cmd.add(sounds);
+        TCLAP::SwitchArg pull(
+            "u",
+            "pull",
+            "with -a and -r: mix the sound on demand as a device callback "
+                "pulls it, instead of on the mixer thread",
+            false
+        );
+        cmd.add(pull);
+
+        // input movies
+        TCLAP::ValueArg<std::string> record(
+            "m",
+            "movie",
+            "record the input of the run into this movie file",
+            false,
+            "",
+            "string"
+        );
+        cmd.add(record);
+        TCLAP::ValueArg<std::string> replay(
+            "p",
+            "play",
+            "replay this movie file as fast as possible instead of running "
+                "-f frames, and check it ends as recorded",
+            false,
+            "",
+            "string"
+        );
+        cmd.add(replay);
+
+        // Run the parser and extract the values
+        cmd.parse(argumentCount, argumentVector);
+        args->romDirectory = romDirectoryArg.getValue();
+        args->frames = frames.getValue();
+        coreName = core.getValue();
+        args->scriptFileName = script.getValue();
+        args->dumpDirectory = dumpDirectory.getValue();
+        args->dumpInterval = dumpInterval.getValue();
+        args->isRealTime = realTime.getValue();
+        args->isPulling = pull.getValue();
+        args->isHooked = hooks.getValue();
+        args->isSplit = split.getValue();
+        args->audioFileName = audio.getValue();
+        args->soundDirectory = sounds.getValue();
+        args->recordFileName = record.getValue();
+        args->replayFileName = replay.getValue();
+    }
+    catch (TCLAP::ArgException &e){
+        // if something went wrong, print an error message and return nullptr
+        std::cerr << "error: "
+            << e.error()
+            << " for arg "
+            << e.argId()
+            << '\n';
+        return std::unique_ptr<struct headlessArguments>(nullptr);
+    }
+
+    if (coreName == "switch") {
+        args->dispatchCore = Emulator8080::SWITCH;
+    } else if (coreName == "table") {
+        args->dispatchCore = Emulator8080::TABLE;
+    } else {
+        args->dispatchCore = Emulator8080::BLOCK;
+    }
+    return args;
+}
+
+/*
+ * Read the ROM from directory, see declaration
+ */
+std::vector<uint8_t> loadInvadersROM(const std::string &directory) {
+    std::vector<uint8_t> rom(ROM_BYTES);
+
+    // the whole ROM in one file
+    std::ifstream romFile(directory + "/invaders", std::ios::binary);
+    if (romFile) {
+        romFile.read(reinterpret_cast<char*>(rom.data()), ROM_BYTES);
+        if (romFile.gcount() == ROM_BYTES) return rom;
+    }
+
+    // the four chips of the board, lowest address first
+    const char *parts[] = {"h", "g", "f", "e"};
+    const int PART_BYTES = 0x0800;
+    for (int i = 0; i < 4; ++i) {
+        std::ifstream partFile(
+            directory + "/invaders." + parts[i], std::ios::binary
+        );
+        partFile.read(
+            reinterpret_cast<char*>(rom.data() + i * PART_BYTES), PART_BYTES
+        );
+        if (partFile.gcount() != PART_BYTES) return std::vector<uint8_t>();
+    }
+    return rom;
+}
+
+/*
+ * Build the cabinet's cpu, see declaration
+ */
+std::unique_ptr<Emulator8080> buildEmulator(
+    SpaceInvaderMemory &memory, Emulator8080::core dispatchCore
+) {
+    if (dispatchCore == Emulator8080::TABLE) {
+        return std::make_unique<Emulator8080>(&memory, dispatchCore);
+    }
+    return std::unique_ptr<Emulator8080>(
+        new BoundEmulator8080<SpaceInvaderMemory>(&memory, dispatchCore)
+    );
+}
+
+/*
+ * Read an input script, see declaration
+ */
+bool loadInputScript(
+    const std::string &fileName,
+    std::multimap<unsigned long long, struct inputEvent> &script
+) {
+    std::ifstream scriptFile(fileName);
+    if (!scriptFile) {
+        std::cerr << "Could not open file: " << fileName << '\n';
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(scriptFile, line)) {
+        ++lineNumber;
+        std::stringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || (first[0] == '#')) continue;
+
+        unsigned long long frame;
+        struct inputEvent event;
+        std::string state;
+        std::stringstream frameField(first);
+        if (
+            !(frameField >> frame) || !(fields >> event.input >> state)
+            || ((state != "down") && (state != "up"))
+        ) {
+            std::cerr << fileName << ":" << lineNumber
+                << ": expected \"<frame> <input> <down|up>\"" << '\n';
+            return false;
+        }
+        event.isDown = (state == "down");
+        script.insert(std::make_pair(frame, event));
+    }
+    return true;
+}
+
+/*
+ * Apply one scripted event to the adapter, see declaration
+ */
+bool applyInputEvent(Adapter &adapter, const struct inputEvent &event) {
+    const std::map<std::string, void (Adapter::*)(bool)> inputs = {
+        {"coin", &Adapter::setCoin},
+        {"p1start", &Adapter::setP1StartButtonDown},
+        {"p2start", &Adapter::setP2StartButtonDown},
+        {"p1shoot", &Adapter::setP1ShootButtonDown},
+        {"p1left", &Adapter::setP1LeftButtonDown},
+        {"p1right", &Adapter::setP1RightButtonDown},
+        {"p2shoot", &Adapter::setP2ShootButtonDown},
+        {"p2left", &Adapter::setP2LeftButtonDown},
+        {"p2right", &Adapter::setP2RightButtonDown}
+    };
+    auto setter = inputs.find(event.input);
+    if (setter == inputs.end()) return false;
+    (adapter.*(setter->second))(event.isDown);
+    return true;
+}
+
+/*
+ * Route sound callbacks to the mixer, see declaration
+ */
+void connectSounds(Adapter &adapter, SoundMixer &mixer) {
+    SoundMixer *sounds = &mixer;
+    Adapter *cabinet = &adapter;
+    adapter.setStartUFOFunction(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::UFO, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setStopUFOFunction(
+        [sounds, cabinet]() {
+            sounds->stopSound(SoundMixer::UFO, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setShootFunction(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::SHOT, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setPlayerDieSoundFunction(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::PLAYER_DEATH, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setInvaderDieFunction(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::INVADER_DEATH, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setFleetMove1Function(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::FLEET_MOVE_1, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setFleetMove2Function(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::FLEET_MOVE_2, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setFleetMove3Function(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::FLEET_MOVE_3, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setFleetMove4Function(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::FLEET_MOVE_4, cabinet->getSoundCycle());
+        }
+    );
+    adapter.setUFOHitFunction(
+        [sounds, cabinet]() {
+            sounds->playSound(SoundMixer::UFO_HIT, cabinet->getSoundCycle());
+        }
+    );
+}
+
+/*
+ * Pull the sound due by host time, see declaration
+ */
+void pullDeviceSamples(
+    SoundMixer &mixer, SoundSink &sink,
+    std::chrono::steady_clock::time_point start, unsigned long long &pulled
+) {
+    std::chrono::duration<double> elapsed = 
+        std::chrono::steady_clock::now() - start;
+    unsigned long long due = static_cast<unsigned long long>(
+        elapsed.count() * SoundMixer::SAMPLE_RATE
+    );
+    int16_t block[SoundMixer::BLOCK_SAMPLES];
+    // the device asks for whole blocks, like the mixer thread writes them
+    while (pulled + SoundMixer::BLOCK_SAMPLES <= due) {
+        mixer.pullSamples(block, SoundMixer::BLOCK_SAMPLES);
+        sink.write(block, SoundMixer::BLOCK_SAMPLES);
+        pulled += SoundMixer::BLOCK_SAMPLES;
+    }
+}
+
+/*
+ * Write the screen as a binary PPM image, see declaration
+ */
+bool dumpFrame(
+    const VideoRenderer &renderer, SpaceInvaderMemory &memory, 
+    std::vector<uint32_t> &pixels, const std::string &fileName
+) {
+    const int PIXELS = VideoRenderer::WIDTH * VideoRenderer::HEIGHT;
+    const uint8_t *const *videoStrips = memory.getVideoStrips();
+    if (pixels.empty()) {
+        pixels.resize(PIXELS);
+        renderer.render32(videoStrips, pixels.data());
+        memory.takeDirtyColumns();
+    } else {
+        renderer.update32(videoStrips, memory.takeDirtyColumns(), pixels.data());
+    }
+    return writeImage(pixels, fileName);
+}
+
+/*
+ * Write pixels as a binary PPM image, see declaration
+ */
+bool writeImage(
+    const std::vector<uint32_t> &pixels, const std::string &fileName
+) {
+    const int PIXELS = VideoRenderer::WIDTH * VideoRenderer::HEIGHT;
+    // 0x00RRGGBB to the red, green, blue bytes of the file
+    std::vector<uint8_t> bytes(PIXELS * 3);
+    for (int i = 0; i < PIXELS; ++i) {
+        bytes[i * 3] = (pixels[i] >> 16) & 0xff;
+        bytes[i * 3 + 1] = (pixels[i] >> 8) & 0xff;
+        bytes[i * 3 + 2] = pixels[i] & 0xff;
+    }
+    std::ofstream image(fileName, std::ios::binary);
+    image << "P6\n" << VideoRenderer::WIDTH << " " << VideoRenderer::HEIGHT 
+        << "\n255\n";
+    image.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return static_cast<bool>(image);
+}
@@ -0,0 +1,206 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+
+Input movies. An event costs four bytes or so: half frames between
+changes fit a byte or two, and a half frame starts only a few cycles past
+its boundary, the length of the instruction that crossed it plus the
+interrupt, so the cycle is stored as that distance.
+*/
+
+#include "inputMovie.hpp"
+#include "emulator.hpp"
+#include "memory.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+static const char MAGIC[4] = {'S', 'I', '8', 'M'};
+static const uint16_t BYTE_ORDER_MARK = 0x0102;
+
+static void writeVarint(std::vector<uint8_t>& out, unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+//Returns false if the varint runs past end
+static bool readVarint(const uint8_t*& in, const uint8_t* end, unsigned long long& value)
+{
+	value = 0;
+	for (int shift = 0; (in < end) && (shift < 64); shift += 7)
+	{
+		uint8_t byte = *in++;
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//The cycle count half frame halfFrame starts from, before any overshoot
+static unsigned long long boundaryCycle(unsigned long long halfFrame)
+{
+	return halfFrame * Machine::CPU_HZ / Machine::HALF_FRAMES_PER_SECOND;
+}
+
+InputMovie::InputMovie() : _start(new SaveStateImage)
+{
+	std::memset(_start.get(), 0, sizeof(SaveStateImage));
+	std::memset(&_end, 0, sizeof(_end));
+}
+
+void InputMovie::startRecording(const Emulator8080& emulator, const Memory& memory, Machine& machine)
+{
+	captureState(emulator, memory, machine, *_start);
+	_events.clear();
+	std::memset(&_end, 0, sizeof(_end));
+	machine.recordInput(this);
+}
+
+void InputMovie::finishRecording(const Emulator8080& emulator, const Memory& memory, Machine& machine)
+{
+	machine.stopInputMovie();
+	SaveStateImage state;
+	captureState(emulator, memory, machine, state);
+	_end.halfFrames = state.header.halfFrames;
+	_end.cycles = state.header.cycles;
+	_end.stateChecksum = state.header.checksum;
+}
+
+void InputMovie::startReplay(Emulator8080& emulator, Memory& memory, Machine& machine) const
+{
+	restoreState(*_start, emulator, memory, machine);
+	machine.replayInput(this);
+}
+
+bool InputMovie::isReplayDone(const Machine& machine) const
+{
+	return machine.getHalfFrames() >= _end.halfFrames;
+}
+
+bool InputMovie::isReplayMatching(const Emulator8080& emulator, const Memory& memory, const Machine& machine) const
+{
+	SaveStateImage state;
+	captureState(emulator, memory, machine, state);
+	return (state.header.halfFrames == _end.halfFrames)
+		&& (state.header.cycles == _end.cycles)
+		&& (state.header.checksum == _end.stateChecksum)
+		&& !machine.isReplayDesynced();
+}
+
+void InputMovie::write(const std::string& fileName) const
+{
+	std::vector<uint8_t> events;
+	events.reserve(_events.size() * 4);
+	unsigned long long previous = _start->header.halfFrames;
+	for (const InputEvent& event : _events)
+	{
+		//Zigzag, in case a loaded state started before its boundary
+		long long distance = static_cast<long long>(event.cycle - boundaryCycle(event.halfFrame));
+		writeVarint(events, event.halfFrame - previous);
+		writeVarint(events, (static_cast<unsigned long long>(distance) << 1) ^ static_cast<unsigned long long>(distance >> 63));
+		events.push_back(event.port1);
+		events.push_back(event.port2);
+		previous = event.halfFrame;
+	}
+
+	InputMovieHeader header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.version = VERSION;
+	header.eventCount = static_cast<uint32_t>(_events.size());
+	header.eventBytes = static_cast<uint32_t>(events.size());
+
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(_start.get()), sizeof(SaveStateImage));
+	file.write(reinterpret_cast<const char*>(events.data()), events.size());
+	file.write(reinterpret_cast<const char*>(&_end), sizeof(_end));
+	file.close();
+	if (!file)
+	{
+		throw InputMovieError("could not write " + fileName);
+	}
+}
+
+void InputMovie::read(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		throw InputMovieError("could not open " + fileName);
+	}
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	InputMovieHeader header;
+	if (bytes.size() < sizeof(header) + sizeof(SaveStateImage) + sizeof(InputMovieEnd))
+	{
+		throw InputMovieError(fileName + " is too short");
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		throw InputMovieError("not a movie");
+	}
+	if (header.byteOrder != BYTE_ORDER_MARK)
+	{
+		throw InputMovieError("written by a host of the other byte order");
+	}
+	if (header.version != VERSION)
+	{
+		throw InputMovieError("version " + std::to_string(header.version) + " is not supported");
+	}
+	if (bytes.size() != sizeof(header) + sizeof(SaveStateImage) + header.eventBytes + sizeof(InputMovieEnd))
+	{
+		throw InputMovieError(fileName + " is the wrong size");
+	}
+
+	std::unique_ptr<SaveStateImage> start(new SaveStateImage);
+	const uint8_t* in = bytes.data() + sizeof(header);
+	std::memcpy(start.get(), in, sizeof(SaveStateImage));
+	try
+	{
+		validateState(*start);
+	}
+	catch (const SaveStateError& e)
+	{
+		throw InputMovieError(std::string("start state: ") + e.what());
+	}
+	in += sizeof(SaveStateImage);
+
+	std::vector<InputEvent> events;
+	events.reserve(header.eventCount);
+	const uint8_t* end = in + header.eventBytes;
+	unsigned long long halfFrame = start->header.halfFrames;
+	for (uint32_t i = 0; i < header.eventCount; ++i)
+	{
+		unsigned long long step, zigzag;
+		if (!readVarint(in, end, step) || !readVarint(in, end, zigzag) || (end - in < 2))
+		{
+			throw InputMovieError("events cut short");
+		}
+		halfFrame += step;
+		long long distance = static_cast<long long>(zigzag >> 1) ^ -static_cast<long long>(zigzag & 1);
+		InputEvent event;
+		event.halfFrame = halfFrame;
+		event.cycle = boundaryCycle(halfFrame) + distance;
+		event.port1 = *in++;
+		event.port2 = *in++;
+		events.push_back(event);
+	}
+	if (in != end)
+	{
+		throw InputMovieError("events do not fill their bytes");
+	}
+
+	_start = std::move(start);
+	_events = std::move(events);
+	std::memcpy(&_end, end, sizeof(_end));
+}
@@ -0,0 +1,107 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+#include "saveState.hpp"
+
+//A movie that cannot be read, written or replayed
+class InputMovieError : public std::exception
+{
+	private:
+		std::string msg;
+	public:
+		InputMovieError(const std::string& reason) : msg("Input movie: " + reason) {}
+		virtual const char* what() const throw()
+		{
+			return msg.c_str();
+		}
+};
+
+//The input ports as the half frame halfFrame started, at emulated cycle
+//cycle. Input only reaches the cpu at half frame boundaries, so this is
+//all a replay needs
+struct InputEvent
+{
+	unsigned long long halfFrame;
+	unsigned long long cycle;
+	uint8_t port1;
+	uint8_t port2;
+};
+
+//Input movie file, version 1: this header, the start state as a
+//SaveStateImage, the events, then an InputMovieEnd. Each event is the
+//half frames since the event before and the cycle's distance from its
+//half frame boundary as varints, then port 1 and port 2. Fields are in
+//the byte order of the host that wrote the file
+struct InputMovieHeader
+{
+	char magic[4]; //"SI8M"
+	uint16_t byteOrder; //0x0102
+	uint16_t version;
+	uint32_t eventCount;
+	uint32_t eventBytes;
+};
+static_assert(sizeof(InputMovieHeader) == 16, "the movie header is 16 bytes on disk");
+
+//Where the recording stopped, and the checksum of the whole machine
+//there: a replay that ends with the same checksum went the same way
+struct InputMovieEnd
+{
+	uint64_t halfFrames;
+	uint64_t cycles;
+	uint32_t stateChecksum;
+	uint32_t reserved;
+};
+static_assert(sizeof(InputMovieEnd) == 24, "the movie end is 24 bytes on disk");
+
+//Every change of the cabinet's input from a saved start, to play a
+//session again exactly and faster than real time.
+//
+//Recording: startRecording() saves the machine as it is and has Machine
+//add an event whenever a half frame starts with different input ports;
+//finishRecording() stops it and stamps the end. Loading a state into the
+//machine in between spoils the recording, start a new one after it.
+//
+//Replay: startReplay() loads the start state and has Machine take its
+//input ports from the events alone, ignoring the platform adapter. Run
+//half frames until isReplayDone(), then isReplayMatching() compares the
+//machine with the end of the recording. Nothing depends on host time, so
+//a replay may run at any speed.
+class InputMovie
+{
+	public:
+		static const uint16_t VERSION = 1;
+
+		InputMovie();
+
+		void startRecording(const Emulator8080& emulator, const Memory& memory, Machine& machine);
+		void finishRecording(const Emulator8080& emulator, const Memory& memory, Machine& machine);
+
+		//Throws SaveStateError if the start state cannot be loaded
+		void startReplay(Emulator8080& emulator, Memory& memory, Machine& machine) const;
+		bool isReplayDone(const Machine& machine) const;
+		bool isReplayMatching(const Emulator8080& emulator, const Memory& memory, const Machine& machine) const;
+
+		//Throw InputMovieError. read() checks the format and the start
+		//state, and replaces the whole movie
+		void write(const std::string& fileName) const;
+		void read(const std::string& fileName);
+
+		//Called by Machine while recording
+		void addEvent(const InputEvent& event) { _events.push_back(event); }
+		const std::vector<InputEvent>& getEvents() const { return _events; }
+		const SaveStateImage& getStartState() const { return *_start; }
+		const InputMovieEnd& getEnd() const { return _end; }
+
+	private:
+		std::unique_ptr<SaveStateImage> _start;
+		std::vector<InputEvent> _events;
+		InputMovieEnd _end;
+};
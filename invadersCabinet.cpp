@@ -0,0 +1,34 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+
+#include "invadersCabinet.hpp"
+
+InvadersCabinet::InvadersCabinet(const std::vector<uint8_t>& image, Emulator8080::core dispatchCore) :
+	memory(new SpaceInvaderMemory)
+{
+	memory->flashROM(const_cast<uint8_t*>(image.data()));
+	emulator.reset(new Emulator8080(memory.get(), dispatchCore));
+	emulator->reset(0x0000);
+	adapter.setInputChanged(false);
+	machine.setPlatformAdapter(&adapter);
+	machine.setEmulator(emulator.get());
+}
+
+InvadersCabinet::InvadersCabinet(std::unique_ptr<SpaceInvaderMemory> memory, Emulator8080::core dispatchCore) :
+	memory(std::move(memory))
+{
+	emulator.reset(new Emulator8080(this->memory.get(), dispatchCore));
+	adapter.setInputChanged(false);
+	machine.setPlatformAdapter(&adapter);
+	machine.setEmulator(emulator.get());
+}
+
+void InvadersCabinet::runFrames(int frames)
+{
+	for (int half = 0; half < frames * 2; ++half)
+	{
+		machine.runHalfFrame();
+	}
+}
@@ -0,0 +1,36 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "memory.hpp"
+#include "emulator.hpp"
+#include "platformAdapter.hpp"
+#include "machine.hpp"
+
+//A Space Invaders cabinet with nothing attached, for the test and bench
+//drivers: memory, an emulator on it, and a Machine wired to the emulator
+//and to an adapter with no input pending. The Machine keeps pointers to
+//the members, so a cabinet stays where it was built
+struct InvadersCabinet
+{
+	//The ROM in image (8 KB from address 0) flashed into new memory, and
+	//the emulator reset to 0000
+	InvadersCabinet(const std::vector<uint8_t>& image, Emulator8080::core dispatchCore);
+	//On memory that already holds a machine, a fork or a copy say. The
+	//emulator is not reset: load the registers and machine state into it
+	InvadersCabinet(std::unique_ptr<SpaceInvaderMemory> memory, Emulator8080::core dispatchCore);
+	InvadersCabinet(const InvadersCabinet&) = delete;
+	InvadersCabinet& operator=(const InvadersCabinet&) = delete;
+
+	//Run whole frames back to back, on emulated time
+	void runFrames(int frames);
+
+	std::unique_ptr<SpaceInvaderMemory> memory;
+	std::unique_ptr<Emulator8080> emulator;
+	Adapter adapter;
+	Machine machine;
+};
@@ -0,0 +1,225 @@
+/*
+ * Native replacements for hot Space Invaders ROM subroutines
+ */
+
+#include "invadersHooks.hpp"
+#include "aluTables.hpp"
+#include <cstdint>
+
+// flags DCR and INR change, all but CY
+static const uint8_t INCREMENT_FLAGS = 0b1101'0100;
+// S Z AC P CY
+static const uint8_t ARITHMETIC_FLAGS = 0b1101'0101;
+// every loop below ends in JNZ, 10 cycles
+static const int JNZ_CYCLES = 10;
+
+/*
+ * A hooked loop: where it starts, the code it must match, and its native
+ * replacement
+ */
+struct invadersHook {
+    std::string name;
+    uint16_t address;
+    // loop body through the routine's RET, as in the ROM
+    std::vector<uint8_t> code;
+    NativeHook8080 hook;
+};
+
+// true if another pass of passCycles fits where the interpreter would
+// still start its final JNZ
+static inline bool isPassInBudget(int cycles, int passCycles, int budget) {
+    return (cycles + passCycles - JNZ_CYCLES) < budget;
+}
+
+// DCR B at the end of every loop
+static inline void decrementB(struct Registers8080 &registers) {
+    registers.replaceFlags(
+        ALU_TABLES.decrement[registers.b], INCREMENT_FLAGS
+    );
+    --registers.b;
+}
+
+// DAD with a register pair holding 0x0020, as LXI B,$0020; DAD B
+static inline void addRowToHL(struct Registers8080 &registers) {
+    uint32_t sum = registers.getHL() + 0x0020;
+    registers.setHL(sum & 0xffff);
+    if (sum & 0x10000) {
+        registers.setFlag(Registers8080::CY);
+    } else {
+        registers.unSetFlag(Registers8080::CY);
+    }
+}
+
+/*
+ * $1a32: LDAX D; MOV M,A; INX H; INX D; DCR B; JNZ $1a32; RET
+ * 39 cycles a pass
+ */
+static int blockCopy(
+    struct Registers8080 &registers, Memory &memory, int budget,
+    unsigned long long &instructions
+) {
+    const int PASS_CYCLES = 39;
+    const uint16_t EXIT_ADDRESS = 0x1a3a;
+    int cycles = 0;
+    while (isPassInBudget(cycles, PASS_CYCLES, budget)) {
+        registers.a = memory.read(registers.getDE());
+        memory.write(registers.a, registers.getHL());
+        registers.setHL(registers.getHL() + 1);
+        registers.setDE(registers.getDE() + 1);
+        decrementB(registers);
+        cycles += PASS_CYCLES;
+        instructions += 6;
+        if (registers.b == 0) {
+            registers.pc = EXIT_ADDRESS;
+            break;
+        }
+    }
+    return cycles;
+}
+
+/*
+ * $1a5f: MVI M,$00; INX H; MOV A,H; CPI $40; JNZ $1a5f; RET
+ * 37 cycles a pass
+ */
+static int clearScreen(
+    struct Registers8080 &registers, Memory &memory, int budget,
+    unsigned long long &instructions
+) {
+    const int PASS_CYCLES = 37;
+    const uint16_t EXIT_ADDRESS = 0x1a68;
+    const uint8_t END_PAGE = 0x40;
+    int cycles = 0;
+    while (isPassInBudget(cycles, PASS_CYCLES, budget)) {
+        memory.write(0x00, registers.getHL());
+        registers.setHL(registers.getHL() + 1);
+        registers.a = registers.h;
+        cycles += PASS_CYCLES;
+        instructions += 5;
+        if (registers.a == END_PAGE) {
+            registers.replaceFlags(
+                ALU_TABLES.subtract[0][registers.a][END_PAGE] >> 8,
+                ARITHMETIC_FLAGS
+            );
+            registers.pc = EXIT_ADDRESS;
+            return cycles;
+        }
+    }
+    // flags of the last CPI that did not leave the loop
+    if (cycles > 0) {
+        registers.replaceFlags(
+            ALU_TABLES.subtract[0][registers.a][END_PAGE] >> 8,
+            ARITHMETIC_FLAGS
+        );
+    }
+    return cycles;
+}
+
+/*
+ * $1439: PUSH B; LDAX D; MOV M,A; INX D; LXI B,$0020; DAD B; POP B;
+ *        DCR B; JNZ $1439; RET
+ * 75 cycles a pass. The pushed BC stays in memory below SP.
+ */
+static int drawSimpleSprite(
+    struct Registers8080 &registers, Memory &memory, int budget,
+    unsigned long long &instructions
+) {
+    const int PASS_CYCLES = 75;
+    const uint16_t EXIT_ADDRESS = 0x1446;
+    int cycles = 0;
+    while (isPassInBudget(cycles, PASS_CYCLES, budget)) {
+        uint16_t stack = registers.sp;
+        memory.write(registers.b, stack - 1);
+        memory.write(registers.c, stack - 2);
+        registers.a = memory.read(registers.getDE());
+        memory.write(registers.a, registers.getHL());
+        registers.setDE(registers.getDE() + 1);
+        addRowToHL(registers);
+        // POP B reads back whatever is on the stack now
+        registers.c = memory.read(stack - 2);
+        registers.b = memory.read(stack - 1);
+        decrementB(registers);
+        cycles += PASS_CYCLES;
+        instructions += 9;
+        if (registers.b == 0) {
+            registers.pc = EXIT_ADDRESS;
+            break;
+        }
+    }
+    return cycles;
+}
+
+/*
+ * $1427: PUSH B; PUSH H; XRA A; MOV M,A; INX H; MOV M,A; INX H; POP H;
+ *        LXI B,$0020; DAD B; POP B; DCR B; JNZ $1427; RET
+ * 105 cycles a pass. The pushed BC and HL stay in memory below SP.
+ */
+static int eraseSimpleSprite(
+    struct Registers8080 &registers, Memory &memory, int budget,
+    unsigned long long &instructions
+) {
+    const int PASS_CYCLES = 105;
+    const uint16_t EXIT_ADDRESS = 0x1438;
+    int cycles = 0;
+    while (isPassInBudget(cycles, PASS_CYCLES, budget)) {
+        uint16_t stack = registers.sp;
+        memory.write(registers.b, stack - 1);
+        memory.write(registers.c, stack - 2);
+        memory.write(registers.h, stack - 3);
+        memory.write(registers.l, stack - 4);
+        // XRA A; its flags are all replaced by DAD and DCR below
+        registers.a = 0x00;
+        memory.write(registers.a, registers.getHL());
+        memory.write(registers.a, registers.getHL() + 1);
+        registers.l = memory.read(stack - 4);
+        registers.h = memory.read(stack - 3);
+        addRowToHL(registers);
+        registers.c = memory.read(stack - 2);
+        registers.b = memory.read(stack - 1);
+        decrementB(registers);
+        cycles += PASS_CYCLES;
+        instructions += 13;
+        if (registers.b == 0) {
+            registers.pc = EXIT_ADDRESS;
+            break;
+        }
+    }
+    return cycles;
+}
+
+// register the hooks whose code matches the ROM
+std::vector<std::string> installInvadersHooks(
+    Emulator8080 &emulator, const Memory &memory
+) {
+    const std::vector<struct invadersHook> invadersHooks = {
+        {"BlockCopy", 0x1a32, {
+            0x1a, 0x77, 0x23, 0x13, 0x05, 0xc2, 0x32, 0x1a, 0xc9
+        }, blockCopy},
+        {"ClearScreen", 0x1a5f, {
+            0x36, 0x00, 0x23, 0x7c, 0xfe, 0x40, 0xc2, 0x5f, 0x1a, 0xc9
+        }, clearScreen},
+        {"DrawSimpleSprite", 0x1439, {
+            0xc5, 0x1a, 0x77, 0x13, 0x01, 0x20, 0x00, 0x09, 0xc1, 0x05,
+            0xc2, 0x39, 0x14, 0xc9
+        }, drawSimpleSprite},
+        {"EraseSimpleSprite", 0x1427, {
+            0xc5, 0xe5, 0xaf, 0x77, 0x23, 0x77, 0x23, 0xe1, 0x01, 0x20,
+            0x00, 0x09, 0xc1, 0x05, 0xc2, 0x27, 0x14, 0xc9
+        }, eraseSimpleSprite}
+    };
+
+    std::vector<std::string> installed;
+    for (const auto &invadersHook : invadersHooks) {
+        bool isMatch = true;
+        for (size_t i = 0; i < invadersHook.code.size(); ++i) {
+            if (memory.read(invadersHook.address + i) != invadersHook.code[i]) {
+                isMatch = false;
+                break;
+            }
+        }
+        if (isMatch) {
+            emulator.registerHook(invadersHook.address, invadersHook.hook);
+            installed.push_back(invadersHook.name);
+        }
+    }
+    return installed;
+}
@@ -0,0 +1,35 @@
+/*
+ * Native replacements for hot Space Invaders ROM subroutines
+ */
+
+#ifndef INVADERSHOOKS_HPP
+#define INVADERSHOOKS_HPP
+
+#include "emulator.hpp"
+#include "memory.hpp"
+#include <string>
+#include <vector>
+
+/*
+ * Register native hooks for the inner loops of the Space Invaders ROM
+ * routines that dominate emulated time:
+ *
+ * $1a32 BlockCopy          copy B bytes from (DE) to (HL)
+ * $1a5f ClearScreen        zero VRAM $2400-$3fff
+ * $1439 DrawSimpleSprite   draw an unshifted sprite column by column
+ * $1427 EraseSimpleSprite  clear a 2-byte wide sprite column by column
+ *
+ * Each hook covers the loop of its routine; code before the loop and the
+ * final RET are interpreted. A hook is only registered if the ROM in
+ * memory holds the expected instructions at its address.
+ *
+ * The routines that draw through the shift register ($1400, $1452) do
+ * I/O inside their loops and are left to the interpreter.
+ *
+ * Returns the names of the hooks registered.
+ */
+std::vector<std::string> installInvadersHooks(
+    Emulator8080 &emulator, const Memory &memory
+);
+
+#endif
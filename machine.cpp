@@ -18,15 +18,24 @@ https://www.dummies.com/programming/c/how-to-use-hex-with-binary-for-c-programmi
 #include "machine.hpp"
 #include "platformAdapter.hpp"
 #include "emulator.hpp"
+#include "memory.hpp"
+#include "inputMovie.hpp"
 #include <chrono>
 
 
 
-Machine::Machine() : _emulator(0), _platformAdapter(0), _port1(0), _port2(0), 
-					shiftRegister(0), shiftRegisterOffset(0), cycleCount(0),
-					_prev_port3(0), _prev_port5(0)
+Machine::Machine() : _platformAdapter(0), _emulator(0), _port1(0), _port2(0),
+					_prev_port3(0), _prev_port5(0),
+					_pacer(std::chrono::nanoseconds(1000000000 / HALF_FRAMES_PER_SECOND)),
+					shiftRegisterOffset(0), shiftRegister(0), _cycles(0), _halfFrames(0),
+					_isTurbo(false), _renderPolicy(RENDER_EVERY_NTH_FRAME), _renderInterval(1),
+					_frames(0), _framesRendered(0), _videoMemory(0),
+					_isSplitRendering(false), _isRenderingFrame(false),
+					_speedStartHalfFrames(0), _recordMovie(0), _replayMovie(0),
+					_replayIndex(0), _isReplayDesynced(false), _recordedPort1(0),
+					_recordedPort2(0)
 {
-	_frameStartTime = std::chrono::high_resolution_clock::now();
+	_speedStartTime = std::chrono::high_resolution_clock::now();
 }
 
 //Sets the cpu emulator used by this machine.
@@ -44,10 +53,11 @@ void Machine::setPlatformAdapter(Adapter* platformAdapter)
 	_platformAdapter = platformAdapter;
 }
 
-//Main processing loop of the machine. Processes input to change
-//bits in the port values. Determines if enough time has elapsed to tirgger
-//a half-frame (RST2) or end-of-frame (RST1) interrupt. If so, advances
-//the cpu emulator the correct number of cycles for the elapsed time.
+//Real time layer on top of runHalfFrame(). Sleeps until the next half
+//frame is due, then runs it, so the game plays at normal speed without
+//keeping a host core busy. After a stall the missed half frames run back
+//to back, up to the pacer's catch-up limit.
+//Everything the cpu sees is decided by runHalfFrame().
 void Machine::step()
 {
 	if (!_emulator)
@@ -55,60 +65,279 @@ void Machine::step()
 		return;
 	}
 
-	//Check platform for input
-	if (_platformAdapter->isInputChanged())
+	//A halted cpu with interrupts disabled never runs again
+	if (_emulator->isDeadlocked())
+	{
+		return;
+	}
+
+	//Turbo runs flat out, host time does not matter
+	if (_isTurbo)
+	{
+		runHalfFrame();
+		return;
+	}
+
+	int due = _pacer.wait();
+	for (int i = 0; i < due; ++i)
+	{
+		runHalfFrame();
+	}
+}
+
+//Advances the cpu to the end of the current half frame and raises the
+//interrupt there: RST1 and a screen refresh, then RST2, alternately.
+//With split rendering the top half of the screen is handed over at the
+//RST1 boundary, the bottom half and the refresh at the RST2 boundary.
+//The platform adapter hears of the end of every frame at the RST2 boundary.
+//The boundaries sit at exact multiples of CPU_HZ / HALF_FRAMES_PER_SECOND
+//(16666.67) cycles. The cycles the last instruction ran past a boundary
+//and the cycles taken to accept an interrupt count toward the next half
+//frame, so no cycles are lost or counted twice.
+void Machine::runHalfFrame()
+{
+	if (!_emulator)
+	{
+		return;
+	}
+
+	//Input is sampled once per half frame
+	_platformAdapter->pollHalfFrameInput();
+	if (_replayMovie)
+	{
+		replayMovieInput();
+	}
+	else if (_platformAdapter->isInputChanged())
 	{
 		processInput();
 	}
+	if (_recordMovie)
+	{
+		recordMovieInput();
+	}
 
-	//Check time for refresh
-	//https://www.geeksforgeeks.org/measure-execution-time-function-cpp/
-	auto checkTime = std::chrono::high_resolution_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::microseconds>(checkTime - _frameStartTime);
-		
-	//Framerate is 60hz. Interrupt the cpu twice per frame (mid-frame and at end)
-	//Redraw the screen at end of every frame.
-	if (duration.count() > 8333) //16666 microseconds in a 1/60 sec frame, check for interrupt every half frame
-	{
-		bool drawScreen = false;		
-		bool isInterruptable = _emulator->isInterruptEnable();
-
-		if (isInterruptable)
-		{	
-			if (useRST1)
-			{	//End of frame interrupt
-				_emulator->requestInterrupt(RST1); 
-				drawScreen = true;
-			}
-			else
-			{
-				//mid-frame interrupt
-				_emulator->requestInterrupt(RST2);
-			}
-			
-			useRST1 = !useRST1;
+	++_halfFrames;
+	unsigned long long target = _halfFrames * CPU_HZ / HALF_FRAMES_PER_SECOND;
+	if (_cycles < target)
+	{
+		//The whole half frame runs as one batch inside the emulator
+		_cycles += _emulator->runCycles(static_cast<int>(target - _cycles));
+	}
+
+	//RST1 is raised with the beam half way down the screen, RST2 at the bottom
+	bool isMidFrame = useRST1;
+	if (_emulator->isInterruptEnable())
+	{
+		_cycles += _emulator->requestInterrupt(useRST1 ? RST1 : RST2);
+	}
+	//The beam keeps moving whether or not the cpu takes the interrupt
+	useRST1 = !useRST1;
+
+	bool isSplit = _isSplitRendering && _videoMemory;
+	const uint8_t* const* videoStrips = 0;
+	if (isSplit)
+	{
+		videoStrips = _videoMemory->getVideoStrips();
+	}
+	if (isMidFrame)
+	{
+		++_frames;
+		_isRenderingFrame = isRenderDue();
+		if (_isRenderingFrame && isSplit)
+		{
+			//The beam is half way down, the top half is what it drew
+			_platformAdapter->renderColumns(videoStrips, 0, HALF_SCREEN_COLUMNS);
 		}
-		
-		//Catch up the CPU for the time that has passed
-		//This emulator should be a 2mhz speed. Since we advance twice a frame,
-		//this means that 1mhz should pass - which is the same as the microseconds
-		//value that has elapsed. So advance the cpu 1 cycle for every microsecond.
-		cycleCount = 0;
-		uint64_t cycles = duration.count();
-		while (cycleCount < cycles)
+		else if (_isRenderingFrame)
 		{
-			//Step emulator
-			cycleCount += _emulator->step();
-		}	
-		
-		if (drawScreen)
+			++_framesRendered;
+			_platformAdapter->refreshScreen();
+		}
+	}
+	else
+	{
+		//The beam reached the bottom, the frame is complete
+		if (_isRenderingFrame && isSplit)
 		{
-			_platformAdapter->refreshScreen();		
+			_isRenderingFrame = false;
+			_platformAdapter->renderColumns(videoStrips, HALF_SCREEN_COLUMNS,
+				SCREEN_COLUMNS - HALF_SCREEN_COLUMNS);
+			++_framesRendered;
+			_platformAdapter->refreshScreen();
 		}
+		_platformAdapter->frameEnd();
+	}
+}
 
-		_frameStartTime = std::chrono::high_resolution_clock::now();
+//_cycles holds the start of the running batch, the emulator knows how far
+//into it the current port instruction is
+unsigned long long Machine::getCurrentCycle() const
+{
+	if (!_emulator)
+	{
+		return _cycles;
 	}
+	return _cycles + _emulator->getBatchCycles();
+}
 
+//Decides whether the frame that just ended is drawn
+bool Machine::isRenderDue()
+{
+	switch (_renderPolicy)
+	{
+		case RENDER_NEVER:
+			return false;
+		case RENDER_ON_VRAM_CHANGE:
+			return !_videoMemory || _videoMemory->isVideoChanged();
+		default:
+			return (_frames % _renderInterval) == 0;
+	}
+}
+
+void Machine::setRenderPolicy(RenderPolicy policy, int interval)
+{
+	_renderPolicy = policy;
+	_renderInterval = (interval > 0) ? interval : 1;
+}
+
+void Machine::setVideoMemory(const SpaceInvaderMemory* videoMemory)
+{
+	_videoMemory = videoMemory;
+}
+
+//A frame whose top half was handed over unsplit gets no bottom half
+void Machine::setSplitRendering(bool isSplitRendering)
+{
+	_isSplitRendering = isSplitRendering;
+	_isRenderingFrame = false;
+}
+
+//Leaving turbo restarts the real time pacing from now, so step() does
+//not see the turbo run as time to catch up
+void Machine::setTurbo(bool isTurbo)
+{
+	_isTurbo = isTurbo;
+	_pacer.restart();
+}
+
+void Machine::resetSpeed()
+{
+	_speedStartTime = std::chrono::high_resolution_clock::now();
+	_speedStartHalfFrames = _halfFrames;
+}
+
+double Machine::getFramesPerSecond() const
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> seconds = now - _speedStartTime;
+	if (seconds.count() <= 0.0)
+	{
+		return 0.0;
+	}
+	return (_halfFrames - _speedStartHalfFrames) / 2.0 / seconds.count();
+}
+
+double Machine::getSpeedUp() const
+{
+	return getFramesPerSecond() / (HALF_FRAMES_PER_SECOND / 2.0);
+}
+
+MachineState Machine::getState() const
+{
+	MachineState state;
+	state.port1 = _port1;
+	state.port2 = _port2;
+	state.prevPort3 = _prev_port3;
+	state.prevPort5 = _prev_port5;
+	state.shiftRegisterOffset = shiftRegisterOffset;
+	state.isNextRST1 = useRST1;
+	state.shiftRegister = shiftRegister;
+	state.cycles = _cycles;
+	state.halfFrames = _halfFrames;
+	state.frames = _frames;
+	return state;
+}
+
+void Machine::loadState(const MachineState& state)
+{
+	_port1 = state.port1;
+	_port2 = state.port2;
+	_prev_port3 = state.prevPort3;
+	_prev_port5 = state.prevPort5;
+	shiftRegisterOffset = state.shiftRegisterOffset & 0x7;
+	useRST1 = state.isNextRST1;
+	shiftRegister = state.shiftRegister;
+	_cycles = state.cycles;
+	_halfFrames = state.halfFrames;
+	_frames = state.frames;
+	//A half drawn split frame belongs to the old timeline
+	_isRenderingFrame = false;
+	_pacer.restart();
+	resetSpeed();
+}
+
+//The ports as recording starts are in the movie's start state, so only
+//changes from them are events
+void Machine::recordInput(InputMovie* movie)
+{
+	_replayMovie = 0;
+	_recordMovie = movie;
+	_recordedPort1 = _port1;
+	_recordedPort2 = _port2;
+}
+
+//The movie's start state must already be loaded: events before the
+//current half frame are skipped
+void Machine::replayInput(const InputMovie* movie)
+{
+	_recordMovie = 0;
+	_replayMovie = movie;
+	_isReplayDesynced = false;
+	const std::vector<InputEvent>& events = movie->getEvents();
+	_replayIndex = 0;
+	while ((_replayIndex < events.size()) && (events[_replayIndex].halfFrame < _halfFrames))
+	{
+		++_replayIndex;
+	}
+}
+
+void Machine::stopInputMovie()
+{
+	_recordMovie = 0;
+	_replayMovie = 0;
+}
+
+void Machine::recordMovieInput()
+{
+	if ((_port1 != _recordedPort1) || (_port2 != _recordedPort2))
+	{
+		_recordMovie->addEvent({_halfFrames, _cycles, _port1, _port2});
+		_recordedPort1 = _port1;
+		_recordedPort2 = _port2;
+	}
+}
+
+void Machine::replayMovieInput()
+{
+	const std::vector<InputEvent>& events = _replayMovie->getEvents();
+	while ((_replayIndex < events.size()) && (events[_replayIndex].halfFrame <= _halfFrames))
+	{
+		const InputEvent& event = events[_replayIndex++];
+		if ((event.halfFrame != _halfFrames) || (event.cycle != _cycles))
+		{
+			_isReplayDesynced = true;
+		}
+		_port1 = event.port1;
+		_port2 = event.port2;
+	}
+}
+
+//Reports a cpu that halted with interrupts disabled.
+//A halted cpu waiting for an interrupt is not deadlocked; runCycles()
+//passes the rest of the half frame idle and the next interrupt wakes it.
+bool Machine::isDeadlocked()
+{
+	return _emulator && _emulator->isDeadlocked();
 }
 
 //Sets the emulated port bits for the input based on the platform
@@ -282,6 +511,7 @@ void Machine::writePortValue(uint8_t port, uint8_t value)
 			//Only play sounds when first changed
 			if (value != _prev_port3)
 			{
+				_platformAdapter->setSoundCycle(getCurrentCycle());
 				//the UFO sound repeats
 				if (value & 0x01 && !(_prev_port3 & 0x01))
 				{
@@ -338,6 +568,7 @@ void Machine::writePortValue(uint8_t port, uint8_t value)
 			//Play sounds, only when changes occur
 			if (value != _prev_port5)
 			{
+				_platformAdapter->setSoundCycle(getCurrentCycle());
 				if (value & 0x01 && !(_prev_port5 & 0x01))
 				{
 					_platformAdapter->playSoundFleetMove1();
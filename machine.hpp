@@ -2,8 +2,27 @@
 CS467 - Build an emulator and run space invaders rom
 Jon Frosch & Phil Sheets
 */
+#pragma once
 #include <cstdint>
+#include <cstddef>
 #include <chrono>
+#include "framePacer.hpp"
+
+//Everything of the cabinet outside the cpu and memory that the game can
+//see, for save states
+struct MachineState
+{
+	uint8_t port1;
+	uint8_t port2;
+	uint8_t prevPort3;
+	uint8_t prevPort5;
+	uint8_t shiftRegisterOffset;
+	bool isNextRST1; //which interrupt the next half frame ends with
+	uint16_t shiftRegister;
+	unsigned long long cycles;
+	unsigned long long halfFrames;
+	unsigned long long frames;
+};
 
 class Machine
 {
@@ -15,7 +34,8 @@ class Machine
 		uint8_t _port2;
 		uint8_t _prev_port3;
 		uint8_t _prev_port5;
-		std::chrono::time_point<std::chrono::high_resolution_clock> _frameStartTime;
+		//Paces step() to real time between half frames
+		FramePacer _pacer;
 
 		void processInput();
 		
@@ -28,8 +48,43 @@ class Machine
 		bool useRST1= true;
 
 		//Timing cycle variables
-		int cycleCount;
-		const int maxCycles = 1000000;
+		//Emulated cycles run since the machine started, interrupts included
+		unsigned long long _cycles;
+		//Half frames run since the machine started
+		unsigned long long _halfFrames;
+
+		//Turbo and frame skip variables
+		bool _isTurbo;
+		int _renderPolicy;
+		int _renderInterval;
+		//Whole frames run, and frames passed to refreshScreen()
+		unsigned long long _frames;
+		unsigned long long _framesRendered;
+		//Memory holding video RAM, whose dirty columns tell if a frame changed
+		const class SpaceInvaderMemory* _videoMemory;
+		//Split rendering, and whether the frame being scanned is rendered
+		bool _isSplitRendering;
+		bool _isRenderingFrame;
+		//Host time and half frame count when speed measurement started
+		std::chrono::time_point<std::chrono::high_resolution_clock> _speedStartTime;
+		unsigned long long _speedStartHalfFrames;
+
+		//Apply the render policy at the end of a frame
+		bool isRenderDue();
+
+		//Input movie being recorded or replayed, and the replay's next
+		//event. The ports as last recorded
+		class InputMovie* _recordMovie;
+		const class InputMovie* _replayMovie;
+		size_t _replayIndex;
+		bool _isReplayDesynced;
+		uint8_t _recordedPort1;
+		uint8_t _recordedPort2;
+
+		//At the start of a half frame, record the input ports if they
+		//changed, or set them from the events due
+		void recordMovieInput();
+		void replayMovieInput();
 
 
 	public:
@@ -38,6 +93,88 @@ class Machine
 		void setPlatformAdapter(class Adapter *platformAdapter);
 		void step();
 
+		//Emulated timing: 2 MHz cpu, 60 frames per second, 2 interrupts per frame
+		static const long CPU_HZ = 2000000;
+		static const int HALF_FRAMES_PER_SECOND = 120;
+
+		//Run the cpu to the next half frame boundary, then raise the interrupt
+		//for that boundary. Depends only on emulated cycles, never on host time,
+		//so the same input always gives the same run.
+		void runHalfFrame();
+
+		//Emulated cycles and half frames run so far
+		unsigned long long getCycles() const { return _cycles; }
+		//Emulated cycles up to the OUT or IN being run, when called from a
+		//port callback; getCycles() otherwise
+		unsigned long long getCurrentCycle() const;
+		unsigned long long getHalfFrames() const { return _halfFrames; }
+
+		//Which frames call the platform adapter's refreshScreen()
+		enum RenderPolicy
+		{
+			RENDER_EVERY_NTH_FRAME, //every interval frames, 1 is every frame
+			RENDER_ON_VRAM_CHANGE, //when video RAM has dirty columns
+			RENDER_NEVER
+		};
+		//RENDER_ON_VRAM_CHANGE needs setVideoMemory(), else every frame renders.
+		//The refresh callback must take the dirty columns from the memory
+		//(SpaceInvaderMemory::takeDirtyColumns()), else every later frame renders
+		void setRenderPolicy(RenderPolicy policy, int interval = 1);
+		void setVideoMemory(const class SpaceInvaderMemory *videoMemory);
+
+		//The beam scans video RAM one column (32 bytes) at a time and is
+		//half way down at the RST1 boundary, at the end at the RST2 boundary.
+		//Split rendering hands each half to the platform adapter's
+		//renderColumns() at the boundary the beam finishes it, so the two
+		//conversions are spread across the frame and show the halves as the
+		//monitor did. refreshScreen() follows the second half. The first half
+		//of a frame decides the render policy for both.
+		//Needs setVideoMemory(), else refreshScreen() alone is called
+		static const int SCREEN_COLUMNS = 224;
+		static const int HALF_SCREEN_COLUMNS = SCREEN_COLUMNS / 2;
+		void setSplitRendering(bool isSplitRendering);
+		bool isSplitRendering() const { return _isSplitRendering; }
+
+		//Turbo mode: step() runs a half frame on every call, as fast as
+		//the host allows, instead of waiting for host time to pass
+		void setTurbo(bool isTurbo);
+		bool isTurbo() const { return _isTurbo; }
+
+		//How closely step() has met the half frame deadlines
+		FrameJitter getFrameJitter() const { return _pacer.getJitter(); }
+
+		//Frames run and frames rendered so far
+		unsigned long long getFrames() const { return _frames; }
+		unsigned long long getFramesRendered() const { return _framesRendered; }
+
+		//Emulated frames per host second since the last resetSpeed() (or
+		//construction), and that rate over the cabinet's 60 frames per second
+		double getFramesPerSecond() const;
+		double getSpeedUp() const;
+		void resetSpeed();
+
+		//Copy the cabinet state out, or back in. Loading keeps the render,
+		//turbo and pacing settings and restarts the pacer and speed counts
+		MachineState getState() const;
+		void loadState(const MachineState& state);
+
+		//Input movies, see InputMovie, which starts and finishes them.
+		//While recording, a half frame that starts with input ports other
+		//than the last recorded adds an event to the movie. While
+		//replaying, the ports are set from the movie's events alone and
+		//the platform adapter's input is ignored
+		void recordInput(class InputMovie* movie);
+		void replayInput(const class InputMovie* movie);
+		void stopInputMovie();
+		bool isReplayingInput() const { return _replayMovie != 0; }
+		//True if a replayed event was due at another cycle than recorded:
+		//the replay went a different way
+		bool isReplayDesynced() const { return _isReplayDesynced; }
+
+		//True if the cpu halted with interrupts disabled. Nothing can wake
+		//it, so step() does no more work and the frontend can stop calling it
+		bool isDeadlocked();
+
 		//Port bit set functions
 		void setCoinBit(bool isSet);
 		void setP2StartButtonBit(bool isSet);
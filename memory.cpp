@@ -4,6 +4,9 @@
 #include "memory.hpp"
 #include <cstdint>
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <atomic>
 //#include <memory>
 
 //Empty constructor
@@ -45,6 +48,27 @@ void Memory::load(uint8_t word, uint16_t address) {
     contents->at(address) = word;
 }
 
+// number of pages in the set
+int MemoryPages::count() const {
+    int pages = 0;
+    for (uint64_t word : bits) {
+        for (; word != 0; word &= word - 1) ++pages;
+    }
+    return pages;
+}
+
+struct MemoryPages MemoryPages::none() {
+    struct MemoryPages pages;
+    for (uint64_t &word : pages.bits) word = 0;
+    return pages;
+}
+
+struct MemoryPages MemoryPages::all() {
+    struct MemoryPages pages;
+    for (uint64_t &word : pages.bits) word = ~0ULL;
+    return pages;
+}
+
 // specifies an offset to the start of "memory"
 void Memory::setStartOffset(uint16_t offset) {
     startOffset = offset;
@@ -57,45 +81,198 @@ uint16_t Memory::getLowAddress() {
 
 // returns the high address of memory
 uint16_t Memory::getHighAddress() {
-    return (contents->size() - 1) + startOffset;
+    return (words - 1) + startOffset;
 }
 
 void Memory::setMemoryBlock(std::unique_ptr<std::vector<uint8_t>> data)
 {
+	this->words = data->size();
 	this->contents = std::move(data);
 }
 
-SpaceInvaderMemory::SpaceInvaderMemory() {
+// a page of SpaceInvaderMemory and the number of memories referencing it.
+// the bytes come first, so a page is found from the address of its bytes
+struct storagePage {
+    uint8_t bytes[SpaceInvaderMemory::STORAGE_PAGE_BYTES];
+    std::atomic<int> references;
+};
+
+static struct storagePage *pageOf(uint8_t *bytes) {
+    return reinterpret_cast<struct storagePage*>(bytes);
+}
+
+// a page referenced once, its bytes not cleared
+static uint8_t *newPage() {
+    struct storagePage *page = new struct storagePage;
+    page->references = 1;
+    return page->bytes;
+}
+
+static void releasePage(uint8_t *bytes) {
+    if (--pageOf(bytes)->references == 0) delete pageOf(bytes);
+}
+
+// zeroed pages owned by the new memory; contents is not used
+SpaceInvaderMemory::SpaceInvaderMemory() : ownedPages(~0ULL) {
     this->words = 0x4000;
     this->startOffset = 0;
-    contents = std::make_unique<std::vector<uint8_t>> (this->words, 0);
+    for (uint8_t *&bytes : pageBytes) {
+        bytes = newPage();
+        std::memset(bytes, 0, STORAGE_PAGE_BYTES);
+    }
+    markAllColumns();
+}
+
+// share every page with the new memory; from now on both copy a page
+// before writing it
+std::unique_ptr<SpaceInvaderMemory> SpaceInvaderMemory::fork() {
+    std::unique_ptr<SpaceInvaderMemory> copy(
+        new SpaceInvaderMemory(*this, forkTag())
+    );
+    ownedPages = 0;
+    return copy;
+}
+
+SpaceInvaderMemory::SpaceInvaderMemory(SpaceInvaderMemory &source, forkTag) :
+        ownedPages(0), dirtyColumns(source.dirtyColumns), 
+        dirtyPages(source.dirtyPages) {
+    this->words = source.words;
+    this->startOffset = source.startOffset;
+    for (int page = 0; page < STORAGE_PAGES; ++page) {
+        pageBytes[page] = source.pageBytes[page];
+        ++pageOf(pageBytes[page])->references;
+    }
+}
+
+int SpaceInvaderMemory::getOwnedPages() const {
+    int pages = 0;
+    for (uint64_t ram = ownedPages >> ((ROM_HIGH_ADDRESS + 1) >> PAGE_SHIFT); 
+            ram != 0; ram &= ram - 1) {
+        ++pages;
+    }
+    return pages;
+}
+
+// copy a shared page; a page whose other references are gone is kept
+uint8_t *SpaceInvaderMemory::ownPage(int page) {
+    uint8_t *bytes = pageBytes[page];
+    if (pageOf(bytes)->references != 1) {
+        uint8_t *copy = newPage();
+        std::memcpy(copy, bytes, STORAGE_PAGE_BYTES);
+        releasePage(bytes);
+        pageBytes[page] = copy;
+        bytes = copy;
+    }
+    ownedPages |= 1ULL << page;
+    return bytes;
 }
 
 void SpaceInvaderMemory::setMemoryBlock(
     std::unique_ptr<std::vector<uint8_t>> data
 ) {
     if (data->size() == 0x4000) {
-        Memory::setMemoryBlock(std::move(data));
+        loadBlock(data->data(), 0, 0x4000);
     } else {
         throw invalidRomError();
     }
 }
-uint8_t SpaceInvaderMemory::read(uint16_t address) const  {
-    // mask the address so that mirroring works
-    address &= this->ADDRESS_MASK;
-    return Memory::read(address);
+
+void SpaceInvaderMemory::flashROM(uint8_t* romData, int romSize, int startAddress) {
+	for (int i = startAddress; i < (romSize + startAddress); ++i) {
+		if ((i < 0) || (i > ADDRESS_MASK)) {
+			markAllColumns();
+			throw invalidRomError();
+		}
+		ownPage(i >> PAGE_SHIFT)[i & PAGE_OFFSET_MASK] = romData[i];
+	}
+	markAllColumns();
 }
-void SpaceInvaderMemory::write(uint8_t word, uint16_t address) {
-    // mask the address so mirroring works
-    address &= this->ADDRESS_MASK;
-    // only write if this is a RAM address
-    if (address > 0x1fff) {
-        Memory::write(word, address);
-    } 
+
+// write a word ignoring ROM, like Memory::load()
+void SpaceInvaderMemory::load(uint8_t word, uint16_t address) {
+    if (address > ADDRESS_MASK) {
+        throw std::out_of_range("address outside memory");
+    }
+    if (read(address) != word) {
+        markChanged(address);
+        ownPage(address >> PAGE_SHIFT)[address & PAGE_OFFSET_MASK] = word;
+    }
 }
 
-void SpaceInvaderMemory::flashROM(uint8_t* romData, int romSize, int startAddress) {
-	Memory::flashROM(romData, romSize, startAddress);
+// bulk copies a page at a time
+void SpaceInvaderMemory::readBlock(
+    uint8_t *destination, int first, int count
+) const {
+    if ((first < 0) || (count < 0) || (first + count > 0x4000)) {
+        throw std::out_of_range("memory block out of range");
+    }
+    while (count > 0) {
+        int offset = first & PAGE_OFFSET_MASK;
+        int bytes = std::min(count, STORAGE_PAGE_BYTES - offset);
+        std::memcpy(destination, pageBytes[first >> PAGE_SHIFT] + offset, bytes);
+        destination += bytes;
+        first += bytes;
+        count -= bytes;
+    }
+}
+
+// pages that would not change are left alone, so they stay shared
+void SpaceInvaderMemory::loadBlock(
+    const uint8_t *source, int first, int count
+) {
+    if ((first < 0) || (count < 0) || (first + count > 0x4000)) {
+        throw std::out_of_range("memory block out of range");
+    }
+    while (count > 0) {
+        int page = first >> PAGE_SHIFT;
+        int offset = first & PAGE_OFFSET_MASK;
+        int bytes = std::min(count, STORAGE_PAGE_BYTES - offset);
+        if (std::memcmp(pageBytes[page] + offset, source, bytes) != 0) {
+            std::memcpy(ownPage(page) + offset, source, bytes);
+        }
+        source += bytes;
+        first += bytes;
+        count -= bytes;
+    }
+    markAllColumns();
+}
+
+// hand the dirty video RAM columns to the caller and clear them
+struct VideoColumns SpaceInvaderMemory::takeDirtyColumns() {
+    struct VideoColumns dirty = dirtyColumns;
+    for (uint64_t &word : dirtyColumns.bits) word = 0;
+    return dirty;
+}
+
+// hand over and clear only the dirty columns in a range
+struct VideoColumns SpaceInvaderMemory::takeDirtyColumns(
+    int firstColumn, int columns
+) {
+    struct VideoColumns dirty;
+    int lastColumn = firstColumn + columns;
+    for (int i = 0; i < VideoColumns::WORDS; ++i) {
+        // the part of the range inside word i, as bit positions
+        int low = std::max(firstColumn - 64 * i, 0);
+        int high = std::min(lastColumn - 64 * i, 64);
+        uint64_t range = 0;
+        if (low < high) {
+            range = ((high == 64) ? ~0ULL : ((1ULL << high) - 1))
+                & ~((1ULL << low) - 1);
+        }
+        dirty.bits[i] = dirtyColumns.bits[i] & range;
+        dirtyColumns.bits[i] &= ~range;
+    }
+    return dirty;
+}
+
+// columns 0-223 set, the rest of the last word clear, and every page
+void SpaceInvaderMemory::markAllColumns() {
+    dirtyPages = MemoryPages::all();
+    for (int i = 0; i < VideoColumns::WORDS; ++i) {
+        int columns = VideoColumns::COLUMNS - 64 * i;
+        dirtyColumns.bits[i] = 
+            (columns >= 64) ? ~0ULL : ((1ULL << columns) - 1);
+    }
 }
 
 void Memory::flashROM(uint8_t* romData, int romSize, int startAddress) {
@@ -109,5 +286,28 @@ void Memory::flashROM(uint8_t* romData, int romSize, int startAddress) {
 	}
 }
 
-// No destructor actions required
-SpaceInvaderMemory::~SpaceInvaderMemory() {}
+// bulk copies for snapshots and save states
+void Memory::readBlock(uint8_t *destination, int first, int count) const {
+    if (
+        (first < 0) || (count < 0) 
+        || (first + count > static_cast<int>(contents->size()))
+    ) {
+        throw std::out_of_range("memory block out of range");
+    }
+    std::memcpy(destination, contents->data() + first, count);
+}
+
+void Memory::loadBlock(const uint8_t *source, int first, int count) {
+    if (
+        (first < 0) || (count < 0) 
+        || (first + count > static_cast<int>(contents->size()))
+    ) {
+        throw std::out_of_range("memory block out of range");
+    }
+    std::memcpy(contents->data() + first, source, count);
+}
+
+// drop this memory's reference to every page
+SpaceInvaderMemory::~SpaceInvaderMemory() {
+    for (uint8_t *bytes : pageBytes) releasePage(bytes);
+}
@@ -22,6 +22,24 @@ class invalidRomError : public std::exception {
         }
 };
 
+// set of 64-byte pages of the first 16 KB of cells, the part snapshots
+// copy, one bit per page: page p is the cells from 64 * p, bit p % 64 of
+// bits[p / 64]
+struct MemoryPages {
+    static const int PAGE_BYTES = 64;
+    static const int PAGES = 0x4000 / PAGE_BYTES;
+    static const int WORDS = PAGES / 64;
+    uint64_t bits[WORDS];
+
+    bool isSet(int page) const {
+        return (bits[page >> 6] >> (page & 63)) & 0x01;
+    }
+    void set(int page) { bits[page >> 6] |= 1ULL << (page & 63); }
+    int count() const;
+    static struct MemoryPages none();
+    static struct MemoryPages all();
+};
+
 class Memory {
     public:
         // return the word at address
@@ -32,6 +50,13 @@ class Memory {
         // write word to address, disegard write protections
         // models "flashing" a ROM
         virtual void load(uint8_t word, uint16_t address); 
+        // the storage cell an address decodes to, for memories that
+        // mirror address ranges. identity by default
+        virtual uint16_t physicalAddress(uint16_t address) const {
+            return address;
+        }
+        // true if write() can never change the word at address
+        virtual bool isReadOnly(uint16_t /*address*/) const { return false; }
 		// Constructor
 		Memory();
 		// create a memory holding a number of words
@@ -48,23 +73,158 @@ class Memory {
 		//Update the memory block
 		virtual void setMemoryBlock(std::unique_ptr<std::vector<uint8_t>> data);
 		virtual void flashROM(uint8_t* romData, int romSize, int startAddress);
+        // copy count words from the cells starting at cell first, in one
+        // block. loadBlock() disregards ROM like load(). both throw
+        // std::out_of_range if the range runs past the end of memory
+        virtual void readBlock(uint8_t *destination, int first, int count) const;
+        virtual void loadBlock(const uint8_t *source, int first, int count);
+        // pages whose cells may have changed since the last
+        // setDirtyPages(), for incremental snapshots. a memory that does
+        // not track writes reports every page
+        virtual struct MemoryPages getDirtyPages() const {
+            return MemoryPages::all();
+        }
+        // start tracking again from pages, usually none()
+        virtual void setDirtyPages(const struct MemoryPages & /*pages*/) {}
     protected:
         int words; // size of memory buffer in words
         uint16_t startOffset; // offset to beginning of address range
         std::unique_ptr<std::vector<uint8_t>> contents;
 };
 
+// set of Space Invaders video RAM columns, one bit per column: column c
+// is the 32 bytes from $2400 + 32 * c, bit c % 64 of bits[c / 64]
+struct VideoColumns {
+    static const int COLUMNS = 224;
+    static const int WORDS = 4;
+    uint64_t bits[WORDS];
+
+    bool isEmpty() const {
+        return (bits[0] | bits[1] | bits[2] | bits[3]) == 0;
+    }
+    bool isSet(int column) const {
+        return (bits[column >> 6] >> (column & 63)) & 0x01;
+    }
+    // the bits of the 8 columns from 8 * group as one byte
+    uint8_t getGroup(int group) const {
+        return static_cast<uint8_t>(bits[group >> 3] >> ((group & 7) * 8));
+    }
+};
+
 // derived class for space invaders, use to set up rom range and mirroring
-class SpaceInvaderMemory : public Memory {
+// final, so code holding a SpaceInvaderMemory (rather than a Memory) calls
+// read/write directly and can inline them
+//
+// the 16 KB are held in 64 reference counted pages of 256 bytes, so
+// fork() makes a copy that shares every page. a page is copied by the
+// first write to it while shared; ROM pages are shared for good. one
+// page is also one 8-column strip of video RAM, see getVideoStrips()
+class SpaceInvaderMemory final : public Memory {
     public:
+        static const uint16_t VIDEO_RAM_START = 0x2400;
+        static const int STORAGE_PAGE_BYTES = 256;
+        static const int STORAGE_PAGES = 0x4000 / STORAGE_PAGE_BYTES;
         SpaceInvaderMemory();
-        uint8_t read(uint16_t address) const override;
-        void write(uint8_t word, uint16_t address) override;
+        // every address is masked into the 0x4000 cells, so no bounds
+        // check is needed
+        uint8_t read(uint16_t address) const override {
+            // mask the address so that mirroring works
+            address &= ADDRESS_MASK;
+            return pageBytes[address >> PAGE_SHIFT][address & PAGE_OFFSET_MASK];
+        }
+        void write(uint8_t word, uint16_t address) override {
+            // mask the address so mirroring works
+            address &= ADDRESS_MASK;
+            uint8_t &cell = pageBytes[address >> PAGE_SHIFT][address & PAGE_OFFSET_MASK];
+            // only write if this is a RAM address, and note the pages
+            // and video RAM columns whose contents change
+            if ((address > ROM_HIGH_ADDRESS) && (cell != word)) {
+                markChanged(address);
+                if (((ownedPages >> (address >> PAGE_SHIFT)) & 0x01) == 0) {
+                    ownPage(address >> PAGE_SHIFT)[address & PAGE_OFFSET_MASK] = word;
+                } else {
+                    cell = word;
+                }
+            }
+        }
+        uint16_t physicalAddress(uint16_t address) const override {
+            return address & ADDRESS_MASK;
+        }
+        bool isReadOnly(uint16_t address) const override {
+            return (address & ADDRESS_MASK) <= ROM_HIGH_ADDRESS;
+        }
+        // a copy sharing every page with this memory, dirty columns and
+        // pages included. costs the page table, not the 16 KB; pages are
+        // copied as either memory writes them. the two may then be used
+        // from different threads
+        std::unique_ptr<SpaceInvaderMemory> fork();
+        // pages not shared with a fork, copied or written since the last
+        // fork() (RAM pages only)
+        int getOwnedPages() const;
+        // video RAM for bulk readers such as the video renderer: element
+        // g points at the 256 bytes of strip g, columns 8 * g to 8 * g + 7.
+        // the array lives as long as the memory, but a write may move a
+        // shared page, so read the elements again after running
+        const uint8_t *const *getVideoStrips() const {
+            return pageBytes + (VIDEO_RAM_START >> PAGE_SHIFT);
+        }
+        // video RAM columns changed by write() since the last
+        // takeDirtyColumns(). setMemoryBlock() and flashROM() mark every
+        // column, and so does construction
+        bool isVideoChanged() const { return !dirtyColumns.isEmpty(); }
+        struct VideoColumns peekDirtyColumns() const { return dirtyColumns; }
+        // return the dirty columns and start a new, empty set
+        struct VideoColumns takeDirtyColumns();
+        // the same for the columns from firstColumn up to (not including)
+        // firstColumn + columns only; dirty columns outside stay dirty
+        struct VideoColumns takeDirtyColumns(int firstColumn, int columns);
         ~SpaceInvaderMemory();
+        SpaceInvaderMemory(const SpaceInvaderMemory &) = delete;
+        SpaceInvaderMemory &operator=(const SpaceInvaderMemory &) = delete;
         void setMemoryBlock(std::unique_ptr<std::vector<uint8_t>> data) override;
 		void flashROM(uint8_t* romData, int romSize = 0x2000, int startAddress = 0x0000) override;
+        // page by page copies. loadBlock() marks every video RAM column,
+        // like flashROM()
+        void readBlock(uint8_t *destination, int first, int count) const override;
+        void loadBlock(const uint8_t *source, int first, int count) override;
+        // marks the page and video RAM column like write(), so incremental
+        // snapshots and the renderer see the change
+        void load(uint8_t word, uint16_t address) override;
+        // pages changed by write() or load() since the last
+        // setDirtyPages(). setMemoryBlock(), flashROM() and loadBlock()
+        // mark every page, and so does construction
+        struct MemoryPages getDirtyPages() const override { return dirtyPages; }
+        void setDirtyPages(const struct MemoryPages &pages) override {
+            dirtyPages = pages;
+        }
     private:
-        const uint16_t ADDRESS_MASK = 0x3fff;
+        static const uint16_t ADDRESS_MASK = 0x3fff;
+        static const uint16_t ROM_HIGH_ADDRESS = 0x1fff;
+        static const int PAGE_SHIFT = 8;
+        static const uint16_t PAGE_OFFSET_MASK = STORAGE_PAGE_BYTES - 1;
+        // the bytes of each page. a page's reference count is kept after
+        // its bytes, see storagePage in memory.cpp
+        uint8_t *pageBytes[STORAGE_PAGES];
+        // bit p set if page p is referenced by this memory alone
+        uint64_t ownedPages;
+        struct VideoColumns dirtyColumns;
+        struct MemoryPages dirtyPages;
+        // mark every video RAM column and every page dirty
+        void markAllColumns();
+        // mark the page of a changed cell, and its column in video RAM
+        void markChanged(uint16_t address) {
+            dirtyPages.set(address / MemoryPages::PAGE_BYTES);
+            if (address >= VIDEO_RAM_START) {
+                int column = (address - VIDEO_RAM_START) >> 5;
+                dirtyColumns.bits[column >> 6] |= 1ULL << (column & 63);
+            }
+        }
+        // make page this memory's alone, copying it if it is shared;
+        // returns its bytes
+        uint8_t *ownPage(int page);
+        // the constructor fork() uses
+        struct forkTag {};
+        SpaceInvaderMemory(SpaceInvaderMemory &source, forkTag);
 };
 
 #endif
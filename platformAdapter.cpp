@@ -121,6 +121,32 @@ bool Adapter::isP2RightButtonDown()
 	return _p2RightDown;
 }
 
+void Adapter::setHalfFrameInputFunction(std::function<void()> func)
+{
+	halfFrameInputFunc = func;
+}
+
+void Adapter::pollHalfFrameInput()
+{
+	if (halfFrameInputFunc)
+	{
+		halfFrameInputFunc();
+	}
+}
+
+void Adapter::setFrameEndFunction(std::function<void()> func)
+{
+	frameEndFunc = func;
+}
+
+void Adapter::frameEnd()
+{
+	if (frameEndFunc)
+	{
+		frameEndFunc();
+	}
+}
+
 void Adapter::setRefreshScreenFunction(std::function<void()> func)
 {
 	refreshScreenFunc = func;
@@ -134,6 +160,30 @@ void Adapter::refreshScreen()
 	}
 }
 
+void Adapter::setRenderColumnsFunction(
+	std::function<void(const uint8_t* const* videoStrips, int firstColumn, int columns)> func)
+{
+	renderColumnsFunc = func;
+}
+
+void Adapter::renderColumns(const uint8_t* const* videoStrips, int firstColumn, int columns)
+{
+	if (renderColumnsFunc)
+	{
+		renderColumnsFunc(videoStrips, firstColumn, columns);
+	}
+}
+
+void Adapter::setSoundCycle(unsigned long long cycle)
+{
+	_soundCycle = cycle;
+}
+
+unsigned long long Adapter::getSoundCycle()
+{
+	return _soundCycle;
+}
+
 void Adapter::setPlayerDieSoundFunction(std::function<void()> func)
 {
 	playerDieFunc = func;
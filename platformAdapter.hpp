@@ -4,6 +4,7 @@ Jon Frosch & Phil Sheets
 */
 #pragma once
 #include <functional>
+#include <cstdint>
 
 
 class Adapter
@@ -23,18 +24,28 @@ class Adapter
 
 		//Visual functions
 		std::function<void()> refreshScreenFunc;
+		std::function<void(const uint8_t* const*, int, int)> renderColumnsFunc;
 
-		bool _inputChanged;
+		//Input functions
+		std::function<void()> halfFrameInputFunc;
 
-		bool _coin;
-		bool _p2StartButtonDown;
-		bool _p1StartButtonDown;
-		bool _p1ShootButtonDown;
-		bool _p1LeftDown;
-		bool _p1RightDown;
-		bool _p2ShootButtonDown;
-		bool _p2LeftDown;
-		bool _p2RightDown;
+		//Frame functions
+		std::function<void()> frameEndFunc;
+
+		bool _inputChanged = false;
+
+		//Emulated cycle of the sound being signalled
+		unsigned long long _soundCycle = 0;
+
+		bool _coin = false;
+		bool _p2StartButtonDown = false;
+		bool _p1StartButtonDown = false;
+		bool _p1ShootButtonDown = false;
+		bool _p1LeftDown = false;
+		bool _p1RightDown = false;
+		bool _p2ShootButtonDown = false;
+		bool _p2LeftDown = false;
+		bool _p2RightDown = false;
 
 	public:
 
@@ -59,12 +70,33 @@ class Adapter
 		bool isP2LeftButtonDown();
 		void setP2RightButtonDown(bool down);
 		bool isP2RightButtonDown();
+
+		//Machine calls this at the start of every half frame, before it
+		//samples the input, so the platform can set the input due at that
+		//half frame even when step() runs several (a scripted input, say)
+		void setHalfFrameInputFunction(std::function<void()> func);
+		void pollHalfFrameInput();
+
+		//Machine calls this when a frame is complete, after the RST2
+		//interrupt and the screen refresh: once for every emulated frame,
+		//however many half frames step() runs. The machine is between
+		//frames, so its whole state can be taken here (for rewind, say)
+		void setFrameEndFunction(std::function<void()> func);
+		void frameEnd();
 		
 		//** Callback functions
 
 		void setRefreshScreenFunction(std::function<void()> func);
 		void refreshScreen();
 
+		//Split rendering (Machine::setSplitRendering()): convert the video
+		//RAM columns from firstColumn to firstColumn + columns - 1 now,
+		//while they hold what the beam just drew. videoStrips are the 8-column
+		//strips of video RAM, see SpaceInvaderMemory::getVideoStrips()
+		void setRenderColumnsFunction(
+			std::function<void(const uint8_t* const* videoStrips, int firstColumn, int columns)> func);
+		void renderColumns(const uint8_t* const* videoStrips, int firstColumn, int columns);
+
 		//Set sound callback functions (platform sets)
 		void setPlayerDieSoundFunction(std::function<void()> func);
 		void setFleetMove1Function(std::function<void()> func);
@@ -77,6 +109,12 @@ class Adapter
 		void setStopUFOFunction(std::function<void()> func);
 		void setUFOHitFunction(std::function<void()> func);
 
+		//Machine sets the emulated cycle of the OUT that changed the sound
+		//bits before calling the sound callbacks below, so a callback can
+		//schedule its sound at that point of emulated time
+		void setSoundCycle(unsigned long long cycle);
+		unsigned long long getSoundCycle();
+
 		//Callback functions for sounds (machine calls)
 		void playSoundPlayerDie();		
 		void playSoundFleetMove1();		
@@ -0,0 +1,317 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+
+Rewind buffer. An entry's encoding of the XOR of two images is a list of
+runs: the number of bytes that are the same (varint), the number that
+differ (varint), then the XOR of those that differ. A run of changes only
+ends at MIN_SAME_BYTES unchanged bytes, so short gaps stay inside it, and
+the unchanged bytes after the last change are not stored.
+*/
+
+#include "rewindBuffer.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+static const size_t MIN_SAME_BYTES = 4;
+static const size_t IMAGE_BYTES = sizeof(SaveStateImage);
+
+static uint8_t* writeVarint(uint8_t* out, size_t value)
+{
+	while (value >= 0x80)
+	{
+		*out++ = static_cast<uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = static_cast<uint8_t>(value);
+	return out;
+}
+
+static const uint8_t* readVarint(const uint8_t* in, size_t& value)
+{
+	value = 0;
+	int shift = 0;
+	while (*in & 0x80)
+	{
+		value |= static_cast<size_t>(*in++ & 0x7f) << shift;
+		shift += 7;
+	}
+	value |= static_cast<size_t>(*in++) << shift;
+	return in;
+}
+
+//Encode the XOR of images a and b into out, returns the bytes written
+static size_t encodeXor(const SaveStateImage& a, const SaveStateImage& b, uint8_t* out)
+{
+	const uint8_t* x = reinterpret_cast<const uint8_t*>(&a);
+	const uint8_t* y = reinterpret_cast<const uint8_t*>(&b);
+	uint8_t* start = out;
+	size_t position = 0;
+	while (position < IMAGE_BYTES)
+	{
+		//Skip what is the same, 8 bytes a step
+		size_t same = position;
+		while (position + 8 <= IMAGE_BYTES)
+		{
+			uint64_t p, q;
+			std::memcpy(&p, x + position, 8);
+			std::memcpy(&q, y + position, 8);
+			if (p != q)
+			{
+				break;
+			}
+			position += 8;
+		}
+		while ((position < IMAGE_BYTES) && (x[position] == y[position]))
+		{
+			++position;
+		}
+		if (position == IMAGE_BYTES)
+		{
+			break;
+		}
+
+		//The changes, up to MIN_SAME_BYTES unchanged bytes in a row
+		size_t first = position;
+		size_t end = position + 1;
+		for (position = end; (position < IMAGE_BYTES) && (position - end < MIN_SAME_BYTES); ++position)
+		{
+			if (x[position] != y[position])
+			{
+				end = position + 1;
+			}
+		}
+		position = end;
+
+		out = writeVarint(out, first - same);
+		out = writeVarint(out, end - first);
+		for (size_t i = first; i < end; ++i)
+		{
+			*out++ = x[i] ^ y[i];
+		}
+	}
+	return out - start;
+}
+
+//XOR an encoding into image
+static void applyXor(const uint8_t* in, size_t bytes, SaveStateImage& image)
+{
+	uint8_t* target = reinterpret_cast<uint8_t*>(&image);
+	const uint8_t* end = in + bytes;
+	size_t position = 0;
+	while (in < end)
+	{
+		size_t same, changed;
+		in = readVarint(in, same);
+		in = readVarint(in, changed);
+		position += same;
+		for (size_t i = 0; i < changed; ++i)
+		{
+			target[position + i] ^= in[i];
+		}
+		position += changed;
+		in += changed;
+	}
+}
+
+RewindBuffer::RewindBuffer(size_t arenaBytes, int keyframeInterval) :
+	_arena(arenaBytes), _scratch(MAX_ENTRY_BYTES), _head(0), _lap(0), _storedBytes(0), _keyframeInterval(std::max(keyframeInterval, 1)),
+	_oldestFrame(0), _base(new SaveStateImage), _newest(new SaveStateImage),
+	_cursor(new SaveStateImage), _next(new SaveStateImage),
+	_cursorFrame(0), _isCursorValid(false), _lastSeekSteps(0)
+{
+	if (arenaBytes < MAX_ENTRY_BYTES)
+	{
+		throw std::invalid_argument("rewind arena too small for one frame");
+	}
+}
+
+void RewindBuffer::clear()
+{
+	_entries.clear();
+	_keyframes.clear();
+	_oldestFrame = 0;
+	_head = 0;
+	_lap = 0;
+	_storedBytes = 0;
+	_isCursorValid = false;
+}
+
+void RewindBuffer::capture(const Emulator8080& emulator, const Memory& memory, const Machine& machine)
+{
+	captureState(emulator, memory, machine, *_next);
+	if (_entries.empty())
+	{
+		//Start again: this frame is the base every keyframe is against
+		clear();
+		std::swap(_base, _next);
+		*_newest = *_base;
+		_entries.push_back({allocate(0), _lap, 0, 0});
+		_keyframes.push_back(0);
+		return;
+	}
+
+	unsigned long long frame = getNewestFrame() + 1;
+	bool isKeyframe = _keyframes.empty() || (frame - _keyframes.back() >= static_cast<unsigned long long>(_keyframeInterval));
+	size_t deltaBytes = encodeXor(*_next, *_newest, _scratch.data());
+	size_t keyBytes = isKeyframe ? encodeXor(*_next, *_base, _scratch.data() + deltaBytes) : 0;
+
+	size_t offset = allocate(deltaBytes + keyBytes);
+	std::memcpy(&_arena[offset], _scratch.data(), deltaBytes + keyBytes);
+	_entries.push_back({offset, _lap, static_cast<uint32_t>(deltaBytes), static_cast<uint32_t>(keyBytes)});
+	if (isKeyframe)
+	{
+		//A keyframe of no bytes still marks the frame
+		_keyframes.push_back(frame);
+	}
+	std::swap(_newest, _next);
+}
+
+//Entries from the lap before all start at or after _head, oldest first,
+//so the ones to drop are always at the front
+size_t RewindBuffer::allocate(size_t bytes)
+{
+	if (_head + bytes > _arena.size())
+	{
+		//The end of the arena is left unused this lap, and so are the
+		//older entries there
+		while (!_entries.empty() && (_entries.front().lap != _lap))
+		{
+			dropOldest();
+		}
+		_head = 0;
+		++_lap;
+	}
+	while (!_entries.empty() && (_entries.front().lap != _lap) && (_entries.front().offset < _head + bytes))
+	{
+		dropOldest();
+	}
+	size_t offset = _head;
+	_head += bytes;
+	_storedBytes += bytes;
+	return offset;
+}
+
+void RewindBuffer::dropOldest()
+{
+	const Entry& oldest = _entries.front();
+	_storedBytes -= oldest.deltaBytes + oldest.keyBytes;
+	_entries.pop_front();
+	if (!_keyframes.empty() && (_keyframes.front() == _oldestFrame))
+	{
+		_keyframes.pop_front();
+	}
+	++_oldestFrame;
+	if (_isCursorValid && (_cursorFrame < _oldestFrame))
+	{
+		_isCursorValid = false;
+	}
+}
+
+void RewindBuffer::applyDelta(unsigned long long frame, SaveStateImage& image) const
+{
+	const Entry& entry = _entries[frame - _oldestFrame];
+	applyXor(&_arena[entry.offset], entry.deltaBytes, image);
+}
+
+unsigned long long RewindBuffer::getFrameBefore(double seconds) const
+{
+	unsigned long long frames = static_cast<unsigned long long>(seconds * FRAMES_PER_SECOND + 0.5);
+	unsigned long long newest = getNewestFrame();
+	if (frames > newest - _oldestFrame)
+	{
+		return _oldestFrame;
+	}
+	return newest - frames;
+}
+
+const SaveStateImage& RewindBuffer::seek(unsigned long long frame)
+{
+	if (_entries.empty() || (frame < _oldestFrame) || (frame > getNewestFrame()))
+	{
+		throw std::out_of_range("frame is not in the rewind buffer");
+	}
+	//Frames of walking from each starting point; a keyframe costs about
+	//as much to decode as KEYFRAME_STEPS deltas
+	const unsigned long long KEYFRAME_STEPS = 8;
+	unsigned long long newest = getNewestFrame();
+	unsigned long long start = newest;
+	unsigned long long steps = newest - frame;
+	int from = 0; //newest, cursor, keyframe
+	if (_isCursorValid)
+	{
+		unsigned long long cursorSteps = (_cursorFrame > frame) ? _cursorFrame - frame : frame - _cursorFrame;
+		if (cursorSteps < steps)
+		{
+			start = _cursorFrame;
+			steps = cursorSteps;
+			from = 1;
+		}
+	}
+	//The keyframes on either side of frame
+	auto after = std::lower_bound(_keyframes.begin(), _keyframes.end(), frame);
+	for (auto keyframe = (after == _keyframes.begin()) ? after : after - 1;
+		(keyframe != _keyframes.end()) && (keyframe <= after); ++keyframe)
+	{
+		unsigned long long keySteps = KEYFRAME_STEPS + ((*keyframe > frame) ? *keyframe - frame : frame - *keyframe);
+		if (keySteps < steps)
+		{
+			start = *keyframe;
+			steps = keySteps;
+			from = 2;
+		}
+	}
+
+	if (from == 0)
+	{
+		*_cursor = *_newest;
+	}
+	else if (from == 2)
+	{
+		const Entry& entry = _entries[start - _oldestFrame];
+		*_cursor = *_base;
+		applyXor(&_arena[entry.offset + entry.deltaBytes], entry.keyBytes, *_cursor);
+	}
+	_lastSeekSteps = static_cast<int>((start > frame) ? start - frame : frame - start);
+	//A frame's delta turns the frame before into it, and it back
+	for (unsigned long long at = start; at > frame; --at)
+	{
+		applyDelta(at, *_cursor);
+	}
+	for (unsigned long long at = start; at < frame; ++at)
+	{
+		applyDelta(at + 1, *_cursor);
+	}
+	_cursorFrame = frame;
+	_isCursorValid = true;
+	return *_cursor;
+}
+
+void RewindBuffer::restore(unsigned long long frame, Emulator8080& emulator, Memory& memory, Machine& machine)
+{
+	restoreState(seek(frame), emulator, memory, machine);
+}
+
+void RewindBuffer::dropAfter(unsigned long long frame)
+{
+	if (_entries.empty() || (frame < _oldestFrame) || (frame >= getNewestFrame()))
+	{
+		return;
+	}
+	*_newest = seek(frame);
+	while (getNewestFrame() > frame)
+	{
+		const Entry& newest = _entries.back();
+		_storedBytes -= newest.deltaBytes + newest.keyBytes;
+		_entries.pop_back();
+	}
+	while (!_keyframes.empty() && (_keyframes.back() > frame))
+	{
+		_keyframes.pop_back();
+	}
+	//The next entry goes straight after this frame's
+	const Entry& last = _entries.back();
+	_head = last.offset + last.deltaBytes + last.keyBytes;
+	_lap = last.lap;
+}
@@ -0,0 +1,107 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include "saveState.hpp"
+
+//Rewind for every frame, in a fixed amount of memory.
+//
+//Each capture() takes the whole machine as a SaveStateImage and stores
+//it as the XOR with the frame before, run length encoded: from one frame
+//to the next only a few hundred bytes change, and the XOR is zero
+//everywhere else. Every keyframeInterval frames the frame is also stored
+//as the XOR with the first frame captured, so a seek never has to walk
+//more than half an interval of deltas from a keyframe. A delta undoes
+//itself, so the walk goes forwards or backwards, from a keyframe, the
+//newest frame or the frame last seeked to, whichever is closest.
+//
+//Entries go one after another into an arena of fixed size, and the
+//oldest frames are dropped to make room. Frames are numbered by capture,
+//from 0.
+class RewindBuffer
+{
+	public:
+		static const int FRAMES_PER_SECOND = Machine::HALF_FRAMES_PER_SECOND / 2;
+		static const int DEFAULT_KEYFRAME_INTERVAL = 5 * FRAMES_PER_SECOND;
+		//The largest entry, a delta and a keyframe of nothing but changes
+		static const size_t MAX_ENTRY_BYTES = 6 * sizeof(SaveStateImage);
+
+		//Throws std::invalid_argument if arenaBytes is under MAX_ENTRY_BYTES
+		RewindBuffer(size_t arenaBytes, int keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+		RewindBuffer(const RewindBuffer&) = delete;
+		RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+		//Store the machine as the next frame, dropping the oldest frames
+		//if the arena is full
+		void capture(const Emulator8080& emulator, const Memory& memory, const Machine& machine);
+
+		bool isEmpty() const { return _entries.empty(); }
+		//The frames held, oldest to newest. Undefined while empty
+		unsigned long long getOldestFrame() const { return _oldestFrame; }
+		unsigned long long getNewestFrame() const { return _oldestFrame + _entries.size() - 1; }
+		size_t getFrameCount() const { return _entries.size(); }
+		//The frame seconds before the newest, or the oldest held
+		unsigned long long getFrameBefore(double seconds) const;
+
+		//Rebuild frame. The image is valid until the next call. Throws
+		//std::out_of_range if the frame is not held
+		const SaveStateImage& seek(unsigned long long frame);
+		//Load frame into the cpu, memory and cabinet. Newer frames are
+		//kept, so seeking on stays possible until dropAfter() or capture()
+		void restore(unsigned long long frame, Emulator8080& emulator, Memory& memory, Machine& machine);
+		//Forget the frames after frame: the next capture() follows it
+		void dropAfter(unsigned long long frame);
+		void clear();
+
+		size_t getArenaBytes() const { return _arena.size(); }
+		//Bytes of the entries held
+		size_t getStoredBytes() const { return _storedBytes; }
+		//Frames of the walk by the last seek(), 0 if it was already there
+		int getLastSeekSteps() const { return _lastSeekSteps; }
+
+	private:
+		struct Entry
+		{
+			size_t offset;
+			unsigned int lap; //times _head had wrapped when it was written
+			uint32_t deltaBytes; //the XOR with the frame before
+			uint32_t keyBytes; //the XOR with _base, after the delta; 0 if no keyframe
+		};
+
+		std::vector<uint8_t> _arena;
+		//An entry being encoded
+		std::vector<uint8_t> _scratch;
+		size_t _head; //where the next entry starts
+		unsigned int _lap; //times _head has wrapped to the start
+		size_t _storedBytes;
+		int _keyframeInterval;
+
+		//_entries[i] is frame _oldestFrame + i
+		std::deque<Entry> _entries;
+		unsigned long long _oldestFrame;
+		//Frames with a keyframe, oldest first
+		std::deque<unsigned long long> _keyframes;
+
+		//The first frame captured, the newest frame, the frame last
+		//seeked to and the frame being captured
+		std::unique_ptr<SaveStateImage> _base;
+		std::unique_ptr<SaveStateImage> _newest;
+		std::unique_ptr<SaveStateImage> _cursor;
+		std::unique_ptr<SaveStateImage> _next;
+		unsigned long long _cursorFrame;
+		bool _isCursorValid;
+		int _lastSeekSteps;
+
+		//Room for an entry of bytes at _head, dropping the oldest frames
+		//in the way. Returns where it starts
+		size_t allocate(size_t bytes);
+		void dropOldest();
+		//Apply the delta of frame: frame - 1 becomes frame and back again
+		void applyDelta(unsigned long long frame, SaveStateImage& image) const;
+};
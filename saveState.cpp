@@ -0,0 +1,323 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+
+Save states on disk. A state is one fixed size block, header and memory
+together, so a file is written with a single write and read by mapping
+it: restoring from a mapped file copies the 16 KB of memory once, from
+the page cache straight into the emulator's memory.
+
+CRC-32: https://en.wikipedia.org/wiki/Cyclic_redundancy_check
+mmap: https://man7.org/linux/man-pages/man2/mmap.2.html
+*/
+
+#include "saveState.hpp"
+#include "emulator.hpp"
+#include "memory.hpp"
+#include <array>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[4] = {'S', 'I', '8', '0'};
+static const uint16_t BYTE_ORDER_MARK = 0x0102;
+
+//CRC-32 (IEEE) read 8 bytes a step: table k gives the CRC of a byte
+//followed by k zero bytes
+static std::array<std::array<uint32_t, 0x100>, 8> buildCrcTables()
+{
+	std::array<std::array<uint32_t, 0x100>, 8> tables;
+	for (uint32_t i = 0; i < 0x100; ++i)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+		}
+		tables[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 0x100; ++i)
+	{
+		for (int k = 1; k < 8; ++k)
+		{
+			uint32_t previous = tables[k - 1][i];
+			tables[k][i] = (previous >> 8) ^ tables[0][previous & 0xff];
+		}
+	}
+	return tables;
+}
+static const std::array<std::array<uint32_t, 0x100>, 8> CRC_TABLES = buildCrcTables();
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* bytes, size_t count)
+{
+	while (count >= 8)
+	{
+		uint32_t low = crc ^ (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16)
+			| (static_cast<uint32_t>(bytes[3]) << 24));
+		crc = CRC_TABLES[7][low & 0xff] ^ CRC_TABLES[6][(low >> 8) & 0xff]
+			^ CRC_TABLES[5][(low >> 16) & 0xff] ^ CRC_TABLES[4][low >> 24]
+			^ CRC_TABLES[3][bytes[4]] ^ CRC_TABLES[2][bytes[5]]
+			^ CRC_TABLES[1][bytes[6]] ^ CRC_TABLES[0][bytes[7]];
+		bytes += 8;
+		count -= 8;
+	}
+	while (count-- > 0)
+	{
+		crc = (crc >> 8) ^ CRC_TABLES[0][(crc ^ *bytes++) & 0xff];
+	}
+	return crc;
+}
+
+//CRC of the image, reading the checksum field as 0
+static uint32_t imageChecksum(const SaveStateImage& image)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&image);
+	const size_t field = offsetof(SaveStateHeader, checksum);
+	const uint8_t zero[sizeof(uint32_t)] = {0, 0, 0, 0};
+	uint32_t crc = 0xffffffff;
+	crc = updateCrc(crc, bytes, field);
+	crc = updateCrc(crc, zero, sizeof(zero));
+	crc = updateCrc(crc, bytes + field + sizeof(uint32_t),
+		sizeof(SaveStateImage) - field - sizeof(uint32_t));
+	return ~crc;
+}
+
+void captureState(const Emulator8080& emulator, const Memory& memory,
+	const Machine& machine, SaveStateImage& image)
+{
+	SaveStateHeader& header = image.header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.version = SaveStateImage::VERSION;
+	header.memoryBytes = SaveStateImage::MEMORY_BYTES;
+
+	Registers8080 registers = emulator.getRegisters();
+	header.a = registers.a;
+	header.b = registers.b;
+	header.c = registers.c;
+	header.d = registers.d;
+	header.e = registers.e;
+	header.h = registers.h;
+	header.l = registers.l;
+	header.flags = registers.getFlags();
+	header.sp = registers.sp;
+	header.pc = registers.pc;
+	header.interruptsEnabled = emulator.isInterruptEnable() ? 1 : 0;
+	header.halted = emulator.isHalted() ? 1 : 0;
+
+	MachineState cabinet = machine.getState();
+	header.port1 = cabinet.port1;
+	header.port2 = cabinet.port2;
+	header.prevPort3 = cabinet.prevPort3;
+	header.prevPort5 = cabinet.prevPort5;
+	header.shiftRegisterOffset = cabinet.shiftRegisterOffset;
+	header.isNextRST1 = cabinet.isNextRST1 ? 1 : 0;
+	header.shiftRegister = cabinet.shiftRegister;
+	header.cycles = cabinet.cycles;
+	header.halfFrames = cabinet.halfFrames;
+	header.frames = cabinet.frames;
+
+	try
+	{
+		memory.readBlock(image.memory, 0, SaveStateImage::MEMORY_BYTES);
+	}
+	catch (const std::out_of_range&)
+	{
+		throw SaveStateError("memory is smaller than 16 KB");
+	}
+	header.checksum = imageChecksum(image);
+}
+
+void validateState(const SaveStateImage& image)
+{
+	const SaveStateHeader& header = image.header;
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		throw SaveStateError("not a save state");
+	}
+	if (header.byteOrder != BYTE_ORDER_MARK)
+	{
+		throw SaveStateError("written by a host of the other byte order");
+	}
+	if (header.version != SaveStateImage::VERSION)
+	{
+		throw SaveStateError("version " + std::to_string(header.version)
+			+ " is not supported");
+	}
+	if (header.memoryBytes != SaveStateImage::MEMORY_BYTES)
+	{
+		throw SaveStateError("wrong memory size");
+	}
+	if (header.checksum != imageChecksum(image))
+	{
+		throw SaveStateError("checksum mismatch, the state is damaged");
+	}
+}
+
+void restoreState(const SaveStateImage& image, Emulator8080& emulator,
+	Memory& memory, Machine& machine)
+{
+	validateState(image);
+	const SaveStateHeader& header = image.header;
+
+	//Memory first: it is the only part that can fail
+	try
+	{
+		memory.loadBlock(image.memory, 0, SaveStateImage::MEMORY_BYTES);
+	}
+	catch (const std::out_of_range&)
+	{
+		throw SaveStateError("memory is smaller than 16 KB");
+	}
+	emulator.flushBlockCache();
+
+	Registers8080 registers;
+	registers.clearRegisters();
+	registers.a = header.a;
+	registers.b = header.b;
+	registers.c = header.c;
+	registers.d = header.d;
+	registers.e = header.e;
+	registers.h = header.h;
+	registers.l = header.l;
+	registers.loadFlags(header.flags);
+	registers.sp = header.sp;
+	registers.pc = header.pc;
+	emulator.loadRegisters(registers);
+	emulator.loadInterruptState(header.interruptsEnabled != 0, header.halted != 0);
+
+	MachineState cabinet;
+	cabinet.port1 = header.port1;
+	cabinet.port2 = header.port2;
+	cabinet.prevPort3 = header.prevPort3;
+	cabinet.prevPort5 = header.prevPort5;
+	cabinet.shiftRegisterOffset = header.shiftRegisterOffset;
+	cabinet.isNextRST1 = header.isNextRST1 != 0;
+	cabinet.shiftRegister = header.shiftRegister;
+	cabinet.cycles = header.cycles;
+	cabinet.halfFrames = header.halfFrames;
+	cabinet.frames = header.frames;
+	machine.loadState(cabinet);
+}
+
+void writeStateFile(const std::string& fileName, const SaveStateImage& image)
+{
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&image), sizeof(image));
+	file.close();
+	if (!file)
+	{
+		throw SaveStateError("could not write " + fileName);
+	}
+}
+
+#ifdef _WIN32
+
+MappedStateFile::MappedStateFile(const std::string& fileName) :
+	_image(nullptr), _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+{
+	_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if ((_file == INVALID_HANDLE_VALUE) || !GetFileSizeEx(_file, &size)
+		|| (size.QuadPart != sizeof(SaveStateImage)))
+	{
+		release();
+		throw SaveStateError("could not map " + fileName);
+	}
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping)
+	{
+		_image = static_cast<const SaveStateImage*>(
+			MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (!_image)
+	{
+		release();
+		throw SaveStateError("could not map " + fileName);
+	}
+	try
+	{
+		validateState(*_image);
+	}
+	catch (const SaveStateError&)
+	{
+		release();
+		throw;
+	}
+}
+
+MappedStateFile::~MappedStateFile()
+{
+	release();
+}
+
+void MappedStateFile::release()
+{
+	if (_image)
+	{
+		UnmapViewOfFile(_image);
+		_image = nullptr;
+	}
+	if (_mapping)
+	{
+		CloseHandle(_mapping);
+		_mapping = nullptr;
+	}
+	if (_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_file);
+		_file = INVALID_HANDLE_VALUE;
+	}
+}
+
+#else
+
+MappedStateFile::MappedStateFile(const std::string& fileName) : _image(nullptr)
+{
+	int file = open(fileName.c_str(), O_RDONLY);
+	struct stat status;
+	if ((file < 0) || (fstat(file, &status) != 0)
+		|| (status.st_size != static_cast<off_t>(sizeof(SaveStateImage))))
+	{
+		if (file >= 0)
+		{
+			close(file);
+		}
+		throw SaveStateError("could not map " + fileName);
+	}
+	//The mapping stays valid after the descriptor is closed
+	void* address = mmap(nullptr, sizeof(SaveStateImage), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (address == MAP_FAILED)
+	{
+		throw SaveStateError("could not map " + fileName);
+	}
+	_image = static_cast<const SaveStateImage*>(address);
+	try
+	{
+		validateState(*_image);
+	}
+	catch (const SaveStateError&)
+	{
+		munmap(const_cast<SaveStateImage*>(_image), sizeof(SaveStateImage));
+		throw;
+	}
+}
+
+MappedStateFile::~MappedStateFile()
+{
+	munmap(const_cast<SaveStateImage*>(_image), sizeof(SaveStateImage));
+}
+
+#endif
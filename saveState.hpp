@@ -0,0 +1,112 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <exception>
+#include "machine.hpp"
+
+class Emulator8080;
+class Memory;
+
+//A save state that cannot be read, written or restored
+class SaveStateError : public std::exception
+{
+	private:
+		std::string msg;
+	public:
+		SaveStateError(const std::string& reason) : msg("Save state: " + reason) {}
+		virtual const char* what() const throw()
+		{
+			return msg.c_str();
+		}
+};
+
+//Save state file, version 1: this header, then the 16 KB of memory.
+//Fields are in the byte order of the host that wrote the file, which
+//byteOrder tells; a host of the other order refuses the file
+struct SaveStateHeader
+{
+	char magic[4]; //"SI80"
+	uint16_t byteOrder; //0x0102
+	uint16_t version;
+	uint32_t checksum; //CRC-32 of the whole file with this field 0
+	uint32_t memoryBytes;
+
+	//cpu
+	uint8_t a, b, c, d, e, h, l, flags;
+	uint16_t sp;
+	uint16_t pc;
+	uint8_t interruptsEnabled;
+	uint8_t halted;
+
+	//cabinet, see MachineState
+	uint8_t port1;
+	uint8_t port2;
+	uint8_t prevPort3;
+	uint8_t prevPort5;
+	uint8_t shiftRegisterOffset;
+	uint8_t isNextRST1;
+	uint16_t shiftRegister;
+	uint8_t reserved[2];
+	uint64_t cycles;
+	uint64_t halfFrames;
+	uint64_t frames;
+};
+static_assert(sizeof(SaveStateHeader) == 64, "the save state header is 64 bytes on disk");
+
+//A whole save state as one block, the same bytes in memory and on disk,
+//so writing is one write and a mapped file can be restored in place
+struct SaveStateImage
+{
+	static const uint16_t VERSION = 1;
+	static const int MEMORY_BYTES = 0x4000;
+
+	SaveStateHeader header;
+	uint8_t memory[MEMORY_BYTES];
+};
+
+//Fill image from the cpu, its 16 KB memory and the cabinet, checksum
+//included
+void captureState(const Emulator8080& emulator, const Memory& memory,
+	const Machine& machine, SaveStateImage& image);
+
+//Check an image's format, version and checksum. Throws SaveStateError
+void validateState(const SaveStateImage& image);
+
+//Validate image and load it into the cpu, memory and cabinet. Throws
+//SaveStateError, leaving everything as it was
+void restoreState(const SaveStateImage& image, Emulator8080& emulator,
+	Memory& memory, Machine& machine);
+
+//Write image to fileName with one write. Throws SaveStateError
+void writeStateFile(const std::string& fileName, const SaveStateImage& image);
+
+//A save state file mapped read only into memory. The image is used where
+//the file's pages are, nothing is copied until restoreState(), and a
+//farm restoring the same state many times pays for the read once.
+//Throws SaveStateError if the file cannot be opened, is not the size of
+//an image, or fails validateState()
+class MappedStateFile
+{
+	public:
+		MappedStateFile(const std::string& fileName);
+		~MappedStateFile();
+		MappedStateFile(const MappedStateFile&) = delete;
+		MappedStateFile& operator=(const MappedStateFile&) = delete;
+
+		const SaveStateImage& getImage() const { return *_image; }
+
+	private:
+		const SaveStateImage* _image;
+#ifdef _WIN32
+		void* _file;
+		void* _mapping;
+
+		//Unmap and close what is open, for the destructor and for a
+		//constructor that fails part way
+		void release();
+#endif
+};
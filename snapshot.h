@@ -2,21 +2,68 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include "emulator.hpp"
 
 class Snapshot
 {
 public:
+	//A full snapshot holds all 16 KB; a delta holds only the pages in
+	//pages, one after another
 	std::vector<uint8_t> memoryData;
 	std::unique_ptr<State8080> state;
+	bool interruptsEnabled = false;
+	bool halted = false;
+	//The full snapshot a delta is relative to, null for a full snapshot
+	std::shared_ptr<const Snapshot> base;
+	struct MemoryPages pages = MemoryPages::all();
+	//Set by Emulator8080::TakeSnapshot(), kept by clone()
+	unsigned long long id = 0;
 
+	bool isDelta() const { return base != nullptr; }
+
+	//One block copy, not a virtual read per byte
 	void copyMemory(Memory* memory)
 	{
-		memoryData.clear();
-		memoryData.reserve(0x4000);
-		for (uint16_t i = 0; i < 0x4000; ++i)
+		memoryData.resize(0x4000);
+		memory->readBlock(memoryData.data(), 0, 0x4000);
+		pages = MemoryPages::all();
+	}
+
+	//Copy only the pages in changed
+	void copyPages(Memory* memory, const struct MemoryPages& changed)
+	{
+		pages = changed;
+		memoryData.resize(changed.count() * MemoryPages::PAGE_BYTES);
+		uint8_t* destination = memoryData.data();
+		for (int page = 0; page < MemoryPages::PAGES; ++page)
+		{
+			if (changed.isSet(page))
+			{
+				memory->readBlock(destination, page * MemoryPages::PAGE_BYTES, MemoryPages::PAGE_BYTES);
+				destination += MemoryPages::PAGE_BYTES;
+			}
+		}
+	}
+
+	//Write the whole 16 KB the snapshot stands for: a delta's pages over
+	//its base's memory
+	void rebuildMemory(uint8_t* destination) const
+	{
+		if (!isDelta())
 		{
-			memoryData.push_back(memory->read(i));
+			std::copy(memoryData.begin(), memoryData.end(), destination);
+			return;
+		}
+		std::copy(base->memoryData.begin(), base->memoryData.end(), destination);
+		const uint8_t* source = memoryData.data();
+		for (int page = 0; page < MemoryPages::PAGES; ++page)
+		{
+			if (pages.isSet(page))
+			{
+				std::copy(source, source + MemoryPages::PAGE_BYTES, destination + page * MemoryPages::PAGE_BYTES);
+				source += MemoryPages::PAGE_BYTES;
+			}
 		}
 	}
 
@@ -24,6 +71,11 @@ public:
 		std::unique_ptr<Snapshot> snapshot = std::make_unique<Snapshot>();
 		snapshot->state = this->state->clone();
 		snapshot->memoryData = this->memoryData; //vector assignment runs deep copy
-		return snapshot;		
-	}	
+		snapshot->interruptsEnabled = this->interruptsEnabled;
+		snapshot->halted = this->halted;
+		snapshot->base = this->base; //the base is shared, never changed
+		snapshot->pages = this->pages;
+		snapshot->id = this->id;
+		return snapshot;
+	}
 };
@@ -0,0 +1,463 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+
+Software sound mixer. Replaces the per-effect XAudio2 voices with one
+portable mixer: the sound files are decoded once into memory, the game
+posts events without blocking, and the device callback or a thread of its
+own does the mixing.
+
+WAV format: http://soundfile.sapp.org/doc/WaveFormat/
+*/
+
+#include "soundMixer.hpp"
+#include "framePacer.hpp"
+#include <chrono>
+#include <iterator>
+
+//Little endian fields of the WAV format
+static uint32_t readLittle16(const std::vector<uint8_t>& bytes, size_t offset)
+{
+	return bytes[offset] | (bytes[offset + 1] << 8);
+}
+
+static uint32_t readLittle32(const std::vector<uint8_t>& bytes, size_t offset)
+{
+	return readLittle16(bytes, offset) | (readLittle16(bytes, offset + 2) << 16);
+}
+
+static void writeLittle(std::ofstream& file, uint32_t value, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)
+	{
+		file.put(static_cast<char>((value >> (8 * i)) & 0xff));
+	}
+}
+
+//Decode a PCM WAV file to mono samples at SoundMixer::SAMPLE_RATE.
+//Channels are averaged and the rate converted by linear interpolation
+static std::vector<int16_t> loadWav(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		throw SoundFileError(fileName, "cannot open the file");
+	}
+	std::vector<uint8_t> bytes(
+		(std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if ((bytes.size() < 12) || (readLittle32(bytes, 0) != 0x46464952) //RIFF
+		|| (readLittle32(bytes, 8) != 0x45564157)) //WAVE
+	{
+		throw SoundFileError(fileName, "not a WAV file");
+	}
+
+	//Walk the chunks for the format and the data, skipping fact and others
+	int channels = 0;
+	int rate = 0;
+	int bits = 0;
+	size_t dataOffset = 0;
+	size_t dataSize = 0;
+	size_t offset = 12;
+	while (offset + 8 <= bytes.size())
+	{
+		uint32_t id = readLittle32(bytes, offset);
+		size_t size = readLittle32(bytes, offset + 4);
+		size_t body = offset + 8;
+		if (size > bytes.size() - body)
+		{
+			size = bytes.size() - body;
+		}
+		if ((id == 0x20746d66) && (size >= 16)) //fmt
+		{
+			if (readLittle16(bytes, body) != 1)
+			{
+				throw SoundFileError(fileName, "not PCM");
+			}
+			channels = readLittle16(bytes, body + 2);
+			rate = readLittle32(bytes, body + 4);
+			bits = readLittle16(bytes, body + 14);
+		}
+		else if (id == 0x61746164) //data
+		{
+			dataOffset = body;
+			dataSize = size;
+		}
+		//Chunks are padded to an even length
+		offset = body + size + (size & 1);
+	}
+	if ((channels < 1) || (rate < 1) || ((bits != 8) && (bits != 16)) || (dataOffset == 0))
+	{
+		throw SoundFileError(fileName, "needs 8 or 16 bit PCM format and data chunks");
+	}
+
+	//Mono at the file's rate
+	int frameBytes = channels * bits / 8;
+	size_t frames = dataSize / frameBytes;
+	std::vector<int16_t> mono(frames);
+	for (size_t i = 0; i < frames; ++i)
+	{
+		int sum = 0;
+		for (int channel = 0; channel < channels; ++channel)
+		{
+			size_t at = dataOffset + i * frameBytes + channel * bits / 8;
+			if (bits == 16)
+			{
+				sum += static_cast<int16_t>(readLittle16(bytes, at));
+			}
+			else
+			{
+				//8 bit samples are unsigned
+				sum += (bytes[at] - 0x80) << 8;
+			}
+		}
+		mono[i] = static_cast<int16_t>(sum / channels);
+	}
+	if ((rate == SoundMixer::SAMPLE_RATE) || (frames < 2))
+	{
+		return mono;
+	}
+
+	//Resample
+	size_t count = static_cast<size_t>(
+		static_cast<unsigned long long>(frames - 1) * SoundMixer::SAMPLE_RATE / rate) + 1;
+	std::vector<int16_t> samples(count);
+	double step = static_cast<double>(rate) / SoundMixer::SAMPLE_RATE;
+	for (size_t i = 0; i < count; ++i)
+	{
+		double position = i * step;
+		size_t left = static_cast<size_t>(position);
+		if (left >= frames - 1)
+		{
+			samples[i] = mono[frames - 1];
+			continue;
+		}
+		double fraction = position - left;
+		samples[i] = static_cast<int16_t>(
+			mono[left] + (mono[left + 1] - mono[left]) * fraction);
+	}
+	return samples;
+}
+
+WavFileSink::WavFileSink(const std::string& fileName) :
+	_file(fileName, std::ios::binary), _samples(0)
+{
+	//The header is written again with the sizes by close()
+	std::vector<char> header(44, 0);
+	_file.write(header.data(), header.size());
+}
+
+WavFileSink::~WavFileSink()
+{
+	close();
+}
+
+void WavFileSink::write(const int16_t* samples, int count)
+{
+	std::vector<char> bytes(count * 2);
+	for (int i = 0; i < count; ++i)
+	{
+		uint16_t sample = static_cast<uint16_t>(samples[i]);
+		bytes[i * 2] = static_cast<char>(sample & 0xff);
+		bytes[i * 2 + 1] = static_cast<char>(sample >> 8);
+	}
+	_file.write(bytes.data(), bytes.size());
+	_samples += count;
+}
+
+//16 bit mono PCM header at the start of the file
+void WavFileSink::close()
+{
+	if (!_file.is_open())
+	{
+		return;
+	}
+	uint32_t dataBytes = static_cast<uint32_t>(_samples * 2);
+	_file.seekp(0);
+	_file.write("RIFF", 4);
+	writeLittle(_file, 36 + dataBytes, 4);
+	_file.write("WAVEfmt ", 8);
+	writeLittle(_file, 16, 4); //fmt size
+	writeLittle(_file, 1, 2); //PCM
+	writeLittle(_file, 1, 2); //channels
+	writeLittle(_file, SoundMixer::SAMPLE_RATE, 4);
+	writeLittle(_file, SoundMixer::SAMPLE_RATE * 2, 4); //bytes per second
+	writeLittle(_file, 2, 2); //bytes per sample
+	writeLittle(_file, 16, 2); //bits per sample
+	_file.write("data", 4);
+	writeLittle(_file, dataBytes, 4);
+	_file.close();
+}
+
+SoundMixer::SoundMixer(size_t eventCapacity, size_t ringSamples) :
+	_events(eventCapacity), _samples(ringSamples), _isStopping(false),
+	_sink(0), _cyclesPerSecond(DEFAULT_CYCLE_RATE), _latency(2 * BLOCK_SAMPLES),
+	_isClockSet(false), _clockOffset(0), _samplePosition(0),
+	_droppedEvents(0), _overruns(0), _samplesMixed(0), _resyncs(0)
+{
+	for (Voice& voice : _voices)
+	{
+		voice = {0, false};
+	}
+	//mix() never needs more, so the device callback does not allocate
+	_sum.reserve(BLOCK_SAMPLES);
+}
+
+SoundMixer::~SoundMixer()
+{
+	stop();
+}
+
+void SoundMixer::loadSounds(const std::string& directory)
+{
+	std::string path = directory;
+	if (!path.empty() && (path.back() != '/') && (path.back() != '\\'))
+	{
+		path += '/';
+	}
+	for (int i = 0; i < SOUND_COUNT; ++i)
+	{
+		_sounds[i] = loadWav(path + std::to_string(i) + ".wav");
+	}
+}
+
+bool SoundMixer::playSound(Sound sound)
+{
+	return postEvent(SoundEvent{0, static_cast<uint8_t>(sound), true, false});
+}
+
+bool SoundMixer::stopSound(Sound sound)
+{
+	return postEvent(SoundEvent{0, static_cast<uint8_t>(sound), false, false});
+}
+
+bool SoundMixer::playSound(Sound sound, unsigned long long cycle)
+{
+	return postEvent(SoundEvent{cycle, static_cast<uint8_t>(sound), true, true});
+}
+
+bool SoundMixer::stopSound(Sound sound, unsigned long long cycle)
+{
+	return postEvent(SoundEvent{cycle, static_cast<uint8_t>(sound), false, true});
+}
+
+bool SoundMixer::postEvent(const SoundEvent& event)
+{
+	if (!_events.push(event))
+	{
+		++_droppedEvents;
+		return false;
+	}
+	return true;
+}
+
+void SoundMixer::setClock(long cyclesPerSecond, int latencySamples)
+{
+	_cyclesPerSecond = (cyclesPerSecond > 0) ? cyclesPerSecond : DEFAULT_CYCLE_RATE;
+	_latency = (latencySamples > 0) ? latencySamples : 0;
+	_isClockSet = false;
+}
+
+void SoundMixer::syncClock(unsigned long long cycle)
+{
+	_isClockSet = true;
+	_clockOffset = static_cast<long long>(_samplePosition) + _latency
+		- static_cast<long long>(cycleSample(cycle));
+}
+
+//Split so cycle * SAMPLE_RATE cannot overflow
+unsigned long long SoundMixer::cycleSample(unsigned long long cycle) const
+{
+	return cycle / _cyclesPerSecond * SAMPLE_RATE
+		+ cycle % _cyclesPerSecond * SAMPLE_RATE / _cyclesPerSecond;
+}
+
+int SoundMixer::eventOffset(const SoundEvent& event, int cursor, int count)
+{
+	if (!event.isTimed)
+	{
+		return cursor;
+	}
+
+	unsigned long long cycleSample = this->cycleSample(event.cycle);
+	long long now = static_cast<long long>(_samplePosition) + cursor;
+	long long sample = static_cast<long long>(cycleSample) + _clockOffset;
+	if (!_isClockSet || (sample < now) || (sample > now + _latency + RESYNC_SAMPLES))
+	{
+		if (_isClockSet)
+		{
+			++_resyncs;
+		}
+		_isClockSet = true;
+		_clockOffset = now + _latency - static_cast<long long>(cycleSample);
+		sample = now + _latency;
+	}
+	long long offset = sample - static_cast<long long>(_samplePosition);
+	return (offset < count) ? static_cast<int>(offset) : count;
+}
+
+void SoundMixer::mixVoices(int from, int to)
+{
+	int32_t* sum = _sum.data();
+	for (int i = 0; i < SOUND_COUNT; ++i)
+	{
+		Voice& voice = _voices[i];
+		const std::vector<int16_t>& sound = _sounds[i];
+		int written = from;
+		while (voice.isPlaying && (written < to))
+		{
+			size_t run = sound.size() - voice.position;
+			if (run > static_cast<size_t>(to - written))
+			{
+				run = to - written;
+			}
+			for (size_t j = 0; j < run; ++j)
+			{
+				sum[written + j] += sound[voice.position + j];
+			}
+			written += static_cast<int>(run);
+			voice.position += run;
+			if (voice.position == sound.size())
+			{
+				//The UFO loops until the game stops it
+				voice.position = 0;
+				voice.isPlaying = (i == UFO);
+			}
+		}
+	}
+}
+
+//Events are taken in the order they were posted, each at its own sample
+void SoundMixer::mix(int16_t* samples, int count)
+{
+	_sum.assign(count, 0);
+	int cursor = 0;
+	SoundEvent event;
+	while (_events.peek(event))
+	{
+		int offset = eventOffset(event, cursor, count);
+		if (offset >= count)
+		{
+			//It belongs to a later block, and so do the events after it
+			break;
+		}
+		mixVoices(cursor, offset);
+		cursor = offset;
+		if (event.sound < SOUND_COUNT)
+		{
+			_voices[event.sound] = {0, event.isStart && !_sounds[event.sound].empty()};
+		}
+		_events.pop(event);
+	}
+	mixVoices(cursor, count);
+
+	//Clip to 16 bits
+	for (int i = 0; i < count; ++i)
+	{
+		int32_t value = _sum[i];
+		if (value > 32767)
+		{
+			value = 32767;
+		}
+		else if (value < -32768)
+		{
+			value = -32768;
+		}
+		samples[i] = static_cast<int16_t>(value);
+	}
+	_samplePosition += count;
+	_samplesMixed += count;
+}
+
+void SoundMixer::pullSamples(int16_t* samples, int count)
+{
+	while (count > 0)
+	{
+		int block = (count < BLOCK_SAMPLES) ? count : BLOCK_SAMPLES;
+		mix(samples, block);
+		samples += block;
+		count -= block;
+	}
+}
+
+void SoundMixer::renderUntil(unsigned long long cycle, SoundSink& sink)
+{
+	if (!_isClockSet)
+	{
+		syncClock(cycle);
+	}
+	long long end = static_cast<long long>(cycleSample(cycle)) + _clockOffset;
+	int16_t block[BLOCK_SAMPLES];
+	while (static_cast<long long>(_samplePosition) < end)
+	{
+		long long count = end - static_cast<long long>(_samplePosition);
+		if (count > BLOCK_SAMPLES)
+		{
+			count = BLOCK_SAMPLES;
+		}
+		mix(block, static_cast<int>(count));
+		sink.write(block, static_cast<int>(count));
+	}
+}
+
+void SoundMixer::start(SoundSink* sink)
+{
+	if (isRunning())
+	{
+		return;
+	}
+	_sink = sink;
+	_isStopping = false;
+	_thread = std::thread([this]() { run(); });
+}
+
+void SoundMixer::stop()
+{
+	if (!isRunning())
+	{
+		return;
+	}
+	_isStopping = true;
+	_thread.join();
+	_sink = 0;
+}
+
+//Mixer thread. Wakes once a block, paced like the machine's half frames,
+//and mixes as many blocks as are due
+void SoundMixer::run()
+{
+	FramePacer pacer(std::chrono::nanoseconds(1000000000LL * BLOCK_SAMPLES / SAMPLE_RATE));
+	std::vector<int16_t> block(BLOCK_SAMPLES);
+	while (!_isStopping)
+	{
+		int due = pacer.wait();
+		for (int i = 0; i < due; ++i)
+		{
+			//The clock keeps running when nobody reads, the block is lost
+			mix(block.data(), BLOCK_SAMPLES);
+			if (_samples.capacity() - _samples.size() < BLOCK_SAMPLES)
+			{
+				++_overruns;
+				continue;
+			}
+			_samples.write(block.data(), BLOCK_SAMPLES);
+		}
+		if (_sink)
+		{
+			size_t count;
+			while ((count = _samples.read(block.data(), BLOCK_SAMPLES)) > 0)
+			{
+				_sink->write(block.data(), static_cast<int>(count));
+			}
+		}
+	}
+}
+
+int SoundMixer::readSamples(int16_t* samples, int count)
+{
+	int copied = static_cast<int>(_samples.read(samples, count));
+	for (int i = copied; i < count; ++i)
+	{
+		samples[i] = 0;
+	}
+	return copied;
+}
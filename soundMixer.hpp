@@ -0,0 +1,227 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+*/
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include "spscRing.hpp"
+
+//A sound file that could not be read or is not 8 or 16 bit PCM
+class SoundFileError : public std::exception
+{
+	private:
+		std::string msg;
+	public:
+		SoundFileError(const std::string& fileName, const std::string& reason) :
+			msg("Could not load sound " + fileName + ": " + reason) {}
+		virtual const char* what() const throw()
+		{
+			return msg.c_str();
+		}
+};
+
+//Receives the mixed sound, 16 bit mono at SoundMixer::SAMPLE_RATE
+class SoundSink
+{
+	public:
+		virtual ~SoundSink() {}
+		virtual void write(const int16_t* samples, int count) = 0;
+};
+
+//Discards the sound, counting the samples
+class NullSoundSink : public SoundSink
+{
+	public:
+		void write(const int16_t* /*samples*/, int count) override { _samples += count; }
+		unsigned long long getSamples() const { return _samples; }
+	private:
+		unsigned long long _samples = 0;
+};
+
+//Writes the sound as a WAV file. The header's sizes are filled in by
+//close(), or by the destructor
+class WavFileSink : public SoundSink
+{
+	public:
+		WavFileSink(const std::string& fileName);
+		~WavFileSink();
+		bool isOpen() const { return _file.is_open() && _file.good(); }
+		void write(const int16_t* samples, int count) override;
+		void close();
+		unsigned long long getSamples() const { return _samples; }
+	private:
+		std::ofstream _file;
+		unsigned long long _samples;
+};
+
+//Portable mixer for the nine Space Invaders sound effects.
+//
+//The emulation thread posts start and stop events through a lock-free
+//ring, so a sound callback inside Machine::writePortValue() never blocks
+//or allocates. The mixer takes the events and mixes the playing voices
+//in one of three ways:
+//
+//Device path: a platform whose audio device pulls sound through a
+//callback calls pullSamples() from that callback, without a mixer
+//thread. Each block is mixed on demand from the event ring as the device
+//asks for it, so nothing sits mixed in between and the latency is the
+//device's own plus setClock()'s.
+//
+//Mixer thread: start() runs a thread paced to the sample rate that mixes
+//into a ring of samples and, if it was given a sink, writes the ring out
+//to it. Without a sink, readSamples() takes the ring from a callback that
+//must not do the mixing itself.
+//
+//Offline: renderUntil() mixes on emulated time, as fast as the host can.
+//
+//Events may carry the emulated cycle of the OUT that caused them. The
+//mixer turns cycles into sample positions on a clock of its own: the
+//first timed event lands latency samples after the block being mixed,
+//and each later one at its exact distance in emulated time from that.
+//A sound then starts at the sample it belongs to, however the emulation
+//bunches its events into half frames, and the delay stays fixed. If the
+//emulation drifts from the sample clock so far that an event would be
+//in the past, or more than RESYNC_SAMPLES past the latency, the clock
+//is set again from that event.
+class SoundMixer
+{
+	public:
+		//In the order of the files, 0.wav to 8.wav
+		enum Sound
+		{
+			UFO, //loops until stopped
+			SHOT,
+			PLAYER_DEATH,
+			INVADER_DEATH,
+			FLEET_MOVE_1,
+			FLEET_MOVE_2,
+			FLEET_MOVE_3,
+			FLEET_MOVE_4,
+			UFO_HIT,
+			SOUND_COUNT
+		};
+
+		static const int SAMPLE_RATE = 44100;
+		//Samples mixed per wake up of the mixer thread, about 11.6 ms
+		static const int BLOCK_SAMPLES = 512;
+		//The 8080's clock in the cabinet
+		static const long DEFAULT_CYCLE_RATE = 2000000;
+		//A quarter of a second
+		static const int RESYNC_SAMPLES = SAMPLE_RATE / 4;
+
+		//Room for pending events, and for mixed samples not yet read
+		SoundMixer(size_t eventCapacity = 256, size_t ringSamples = 8192);
+		~SoundMixer();
+
+		//Read 0.wav to 8.wav from directory (ending in a path separator or
+		//not) and convert them to SAMPLE_RATE mono. Throws SoundFileError
+		void loadSounds(const std::string& directory);
+
+		//Emulation thread. Never blocks; false if the event ring is full
+		//and the event was dropped. Playing a sound that is already playing
+		//starts it again from the beginning
+		bool playSound(Sound sound);
+		bool stopSound(Sound sound);
+		//The same at emulated cycle, see setClock()
+		bool playSound(Sound sound, unsigned long long cycle);
+		bool stopSound(Sound sound, unsigned long long cycle);
+
+		//Emulated cycles per second, and the samples between the block a
+		//timed event is mixed in and its sound (2 blocks by default). Call
+		//while the mixer thread is stopped; the clock starts again from
+		//the next timed event
+		void setClock(long cyclesPerSecond, int latencySamples);
+		//Set the clock now instead of at the next timed event: cycle falls
+		//latency samples after the next sample mixed. Call while stopped
+		void syncClock(unsigned long long cycle);
+
+		//Offline rendering, with the mixer thread stopped: mix from the
+		//next sample up to the sample of cycle (not included) into sink.
+		//Called after each stretch of emulation with the cycles run, it
+		//mixes every event at its exact sample, as fast as the host can
+		void renderUntil(unsigned long long cycle, SoundSink& sink);
+
+		//Take the pending events and mix count samples. Called by the
+		//mixer thread; call it directly only while the thread is stopped
+		void mix(int16_t* samples, int count);
+
+		//Device path: mix count samples now, from the device callback,
+		//with the mixer thread stopped. Mixes a block at a time, so it
+		//never allocates and is safe on a real time audio thread
+		void pullSamples(int16_t* samples, int count);
+
+		//Start the mixer thread, writing to sink if it is given. The sink
+		//must outlive stop()
+		void start(SoundSink* sink = nullptr);
+		void stop();
+		bool isRunning() const { return _thread.joinable(); }
+
+		//Device callback side when running without a sink. Fills samples
+		//with what has been mixed and the rest with silence, returns the
+		//number of mixed samples copied
+		int readSamples(int16_t* samples, int count);
+
+		unsigned long long getDroppedEvents() const { return _droppedEvents; }
+		//Mixed blocks thrown away because nobody read the sample ring
+		unsigned long long getOverruns() const { return _overruns; }
+		unsigned long long getSamplesMixed() const { return _samplesMixed; }
+		//Times the sample clock was set again from a drifting event
+		unsigned long long getResyncs() const { return _resyncs; }
+
+	private:
+		struct SoundEvent
+		{
+			unsigned long long cycle;
+			uint8_t sound;
+			bool isStart;
+			bool isTimed; //else it takes effect where mixing has got to
+		};
+
+		//One voice per sound, like the cabinet's sound circuits
+		struct Voice
+		{
+			size_t position;
+			bool isPlaying;
+		};
+
+		std::array<std::vector<int16_t>, SOUND_COUNT> _sounds;
+		std::array<Voice, SOUND_COUNT> _voices;
+		//Voices summed before clipping
+		std::vector<int32_t> _sum;
+		SpscRing<SoundEvent> _events;
+		SpscRing<int16_t> _samples;
+
+		std::thread _thread;
+		std::atomic<bool> _isStopping;
+		SoundSink* _sink;
+
+		//Sample clock: a timed event's sample is its cycle in samples plus
+		//_clockOffset. _samplePosition is the first sample of the next block
+		long _cyclesPerSecond;
+		int _latency;
+		bool _isClockSet;
+		long long _clockOffset;
+		unsigned long long _samplePosition;
+
+		std::atomic<unsigned long long> _droppedEvents;
+		std::atomic<unsigned long long> _overruns;
+		std::atomic<unsigned long long> _samplesMixed;
+		std::atomic<unsigned long long> _resyncs;
+
+		bool postEvent(const SoundEvent& event);
+		//cycle in samples, before _clockOffset
+		unsigned long long cycleSample(unsigned long long cycle) const;
+		//The sample in the block of count samples the event takes effect
+		//at, not before cursor; count or more if it belongs to a later block
+		int eventOffset(const SoundEvent& event, int cursor, int count);
+		//Add the playing voices to _sum from sample from up to to
+		void mixVoices(int from, int to);
+		void run();
+};
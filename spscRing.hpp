@@ -0,0 +1,120 @@
+/*
+CS467 - Build an emulator and run space invaders rom
+Jon Frosch & Phil Sheets
+
+Lock-free ring for one producer thread and one consumer thread. Each
+index is written by one side only: the producer publishes items by
+storing _head with release order, the consumer frees slots by storing
+_tail. Neither side ever waits on the other; a full ring refuses items
+and an empty one returns none.
+
+https://en.cppreference.com/w/cpp/atomic/memory_order
+*/
+#pragma once
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template <typename T>
+class SpscRing
+{
+	public:
+		//capacity is rounded up to a power of two
+		explicit SpscRing(size_t capacity) : _head(0), _tail(0)
+		{
+			size_t size = 1;
+			while (size < capacity)
+			{
+				size <<= 1;
+			}
+			_items.resize(size);
+			_mask = size - 1;
+		}
+
+		//Producer side. False if the ring is full
+		bool push(const T& item)
+		{
+			size_t head = _head.load(std::memory_order_relaxed);
+			if (head - _tail.load(std::memory_order_acquire) > _mask)
+			{
+				return false;
+			}
+			_items[head & _mask] = item;
+			_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		//Producer side. Copies as many of items as fit, returns how many
+		size_t write(const T* items, size_t count)
+		{
+			size_t head = _head.load(std::memory_order_relaxed);
+			size_t space = _mask + 1 - (head - _tail.load(std::memory_order_acquire));
+			if (count > space)
+			{
+				count = space;
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				_items[(head + i) & _mask] = items[i];
+			}
+			_head.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		//Consumer side. False if the ring is empty
+		bool pop(T& item)
+		{
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail == _head.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			item = _items[tail & _mask];
+			_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		//Consumer side. Copies the oldest item without taking it, false if
+		//the ring is empty
+		bool peek(T& item) const
+		{
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			if (tail == _head.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			item = _items[tail & _mask];
+			return true;
+		}
+
+		//Consumer side. Copies up to count items out, returns how many
+		size_t read(T* items, size_t count)
+		{
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			size_t available = _head.load(std::memory_order_acquire) - tail;
+			if (count > available)
+			{
+				count = available;
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				items[i] = _items[(tail + i) & _mask];
+			}
+			_tail.store(tail + count, std::memory_order_release);
+			return count;
+		}
+
+		//Items waiting, exact only when called from one of the two sides
+		size_t size() const
+		{
+			return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+		}
+		size_t capacity() const { return _mask + 1; }
+
+	private:
+		std::vector<T> _items;
+		size_t _mask;
+		//On separate cache lines so the two threads do not share one
+		alignas(64) std::atomic<size_t> _head;
+		alignas(64) std::atomic<size_t> _tail;
+};
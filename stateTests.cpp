@@ -0,0 +1,626 @@
+/*
+ *  Test driver for save states, delta snapshots, forking and rewind: runs
+ *  Space Invaders and checks that each brings the machine back exactly
+ */
+
+#ifdef _WIN32
+#define TCLAP_NAMESTARTSTRING "~~"
+#define TCLAP_FLAGSTARTSTRING "/"
+#endif
+
+#include "tclap/CmdLine.h"
+#include <string>
+#include <memory>
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "memory.hpp"
+#include "emulator.hpp"
+#include "machine.hpp"
+#include "platformAdapter.hpp"
+#include "saveState.hpp"
+#include "rewindBuffer.hpp"
+#include "snapshot.h"
+#include "invadersCabinet.hpp"
+
+// arena of the rewind check: at about 136 bytes a frame of play, 8.5
+// minutes fit
+const size_t REWIND_ARENA_BYTES = 4 << 20;
+
+/*
+ * Struct holding the arguments retrieved from the command line
+ */
+struct stateTestArguments {
+    std::string romFileName;
+    Emulator8080::core dispatchCore;
+    int frames;
+};
+
+/*
+ * Invoke parser from TCLAP library to process the command line
+ * Returns nullptr on failure.
+ */
+std::unique_ptr<struct stateTestArguments> parseArguments(
+    int argumentCount, char *argumentVector[]
+);
+
+/*
+ * Name a dispatch core for reports
+ */
+std::string coreLabel(Emulator8080::core dispatchCore);
+
+/*
+ * Run Space Invaders for frames, save the state to fileName and time the
+ * write and restores from the mapped file. Then run the original and a
+ * restored copy on for as many frames again, comparing RAM, registers and
+ * cycles after every half frame, and check that a damaged state is
+ * refused. Returns false on any difference.
+ */
+bool benchSaveStates(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames,
+    const std::string &fileName
+);
+
+/*
+ * Run Space Invaders for frames, taking a full snapshot every 
+ * keyframes frames and a delta against it every other frame, and going
+ * back to the last delta now and then. Checks that each delta rebuilds
+ * the memory and registers exactly and reports its size and time against
+ * full snapshots. Returns false on a mismatch.
+ */
+bool benchDeltaSnapshots(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames,
+    int keyframes
+);
+
+/*
+ * Run Space Invaders for frames, then fork it: the fork shares the memory
+ * pages and has a coin dropped in, while the original and an independent
+ * full copy run on. Times forking, counts the pages either side copies,
+ * and checks the original always matches the full copy. Returns false if
+ * it does not, or if the fork fails to diverge.
+ */
+bool benchForking(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames
+);
+
+/*
+ * Play Space Invaders for frames with scripted input, capturing every
+ * frame into a rewind buffer of arenaBytes. Checks that seeking rebuilds
+ * sampled frames exactly, times capture, stepping back and random seeks,
+ * and reports the bytes held per frame. Then restores a frame half way
+ * back, drops the frames after it and plays on with the same input, which
+ * must end in the same state. Returns false on any difference.
+ */
+bool benchRewind(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames,
+    size_t arenaBytes
+);
+
+int main(int argc, char *argv[]) {
+    std::unique_ptr<struct stateTestArguments> args = 
+        parseArguments(argc, argv);
+    if (!args) {
+        return 1;
+    }
+
+    // the 8 KB ROM goes at address 0
+    std::ifstream romFile(args->romFileName, std::ios::binary);
+    if (!romFile) {
+        std::cerr << "Could not open file: " << args->romFileName << '\n';
+        return 1;
+    }
+    std::vector<uint8_t> image(0x10000);
+    romFile.read(reinterpret_cast<char*>(image.data()), 0x2000);
+    if (romFile.gcount() != 0x2000) {
+        std::cerr << "Error reading file." << '\n';
+        return 1;
+    }
+
+    try {
+        // save, map and restore a state, then check the restored run
+        std::string fileName = args->romFileName + ".sav";
+        bool isSaved = benchSaveStates(
+            image, args->dispatchCore, args->frames, fileName
+        );
+        std::remove(fileName.c_str());
+        if (!isSaved) return 1;
+        if (!benchForking(image, args->dispatchCore, args->frames)) {
+            return 1;
+        }
+        for (int keyframes : {10, 60}) {
+            if (
+                !benchDeltaSnapshots(
+                    image, args->dispatchCore, args->frames, keyframes
+                )
+            ) {
+                return 1;
+            }
+        }
+        // record every frame, then seek, step back and play on
+        if (
+            !benchRewind(
+                image, args->dispatchCore, args->frames, REWIND_ARENA_BYTES
+            )
+        ) {
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    std::cout << "All state checks passed." << std::endl;
+    return 0;
+}
+
+bool benchSaveStates(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames,
+    const std::string &fileName
+) {
+    // the original run and the one restored from the file
+    InvadersCabinet original(image, dispatchCore);
+    InvadersCabinet restored(image, dispatchCore);
+    original.runFrames(frames);
+
+    SaveStateImage state;
+    auto start = std::chrono::steady_clock::now();
+    captureState(
+        *original.emulator, *original.memory, original.machine, state
+    );
+    auto captured = std::chrono::steady_clock::now();
+    writeStateFile(fileName, state);
+    auto written = std::chrono::steady_clock::now();
+    std::cout << "Save state after " << std::dec << frames << " frames: " 
+        << sizeof(state) << " bytes to " << fileName << ", capture "
+        << std::chrono::duration<double, std::micro>(captured - start).count()
+        << " us, write "
+        << std::chrono::duration<double, std::micro>(written - captured).count()
+        << " us" << std::endl;
+
+    // restore the mapped state over and over, as a farm of runs would
+    const int RESTORES = 20000;
+    MappedStateFile mapped(fileName);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < RESTORES; ++i) {
+        restoreState(
+            mapped.getImage(), *restored.emulator, *restored.memory, 
+            restored.machine
+        );
+    }
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    std::cout << "  " << RESTORES << " restores from the mapped file: " 
+        << (RESTORES / seconds) << " per second (" 
+        << (1e6 * seconds / RESTORES) << " us each)" << std::endl;
+
+    for (int half = 0; half < frames * 2; ++half) {
+        original.machine.runHalfFrame();
+        restored.machine.runHalfFrame();
+
+        bool isSame = 
+            (original.machine.getCycles() == restored.machine.getCycles())
+            && original.emulator->getRegisters().isSameState(
+                restored.emulator->getRegisters()
+            );
+        for (int i = 0x2000; isSame && (i < 0x4000); ++i) {
+            isSame = original.memory->read(i) == restored.memory->read(i);
+        }
+        if (!isSame) {
+            std::cerr << "restored run diverged in half frame " << half 
+                << '\n';
+            return false;
+        }
+    }
+    std::cout << "  " << frames << " frames on from the restore, " 
+        << coreLabel(dispatchCore) 
+        << " core: RAM, registers and cycles match." << std::endl;
+
+    // a flipped bit anywhere must be caught by the checksum
+    state.memory[0x2400] ^= 0x10;
+    try {
+        validateState(state);
+        std::cerr << "damaged state was accepted" << '\n';
+        return false;
+    } catch (const SaveStateError &e) {
+        std::cout << "  Damaged state refused: " << e.what() << std::endl;
+    }
+    return true;
+}
+
+bool benchDeltaSnapshots(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames,
+    int keyframes
+) {
+    InvadersCabinet cabinet(image, dispatchCore);
+    SpaceInvaderMemory &memory = *cabinet.memory;
+    Emulator8080 &emulator = *cabinet.emulator;
+
+    std::shared_ptr<const Snapshot> base;
+    std::unique_ptr<Snapshot> previous;
+    std::vector<uint8_t> rebuilt(0x4000);
+    std::vector<uint8_t> live(0x4000);
+    unsigned long long deltaBytes = 0;
+    int deltas = 0;
+    int rewinds = 0;
+    double deltaSeconds = 0.0;
+    double fullSeconds = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        cabinet.runFrames(1);
+        // now and then go back a frame, as rewinding does
+        if ((frame % 97 == 96) && previous && previous->isDelta()) {
+            emulator.LoadSnapshot(previous->clone());
+            ++rewinds;
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (frame % keyframes == 0) {
+            base = emulator.TakeSnapshot();
+            fullSeconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start
+            ).count();
+            continue;
+        }
+        std::unique_ptr<Snapshot> delta = emulator.TakeSnapshot(base);
+        deltaSeconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        deltaBytes += delta->memoryData.size();
+        ++deltas;
+
+        delta->rebuildMemory(rebuilt.data());
+        memory.readBlock(live.data(), 0, 0x4000);
+        if (
+            (rebuilt != live) 
+            || !delta->state->isSameState(emulator.getRegisters())
+        ) {
+            std::cerr << "delta snapshot of frame " << frame 
+                << " does not rebuild the state" << '\n';
+            return false;
+        }
+        previous = std::move(delta);
+    }
+    int fulls = frames - deltas;
+    std::cout << "Delta snapshots, a full one every " << std::dec 
+        << keyframes << " frames: " << deltas << " deltas of " 
+        << (deltaBytes / std::max(deltas, 1)) << " bytes on average ("
+        << (1e6 * deltaSeconds / std::max(deltas, 1)) << " us), full " 
+        << 0x4000 << " bytes (" << (1e6 * fullSeconds / std::max(fulls, 1))
+        << " us), " << rewinds << " rewinds: all rebuild exactly." 
+        << std::endl;
+    return true;
+}
+
+bool benchForking(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames
+) {
+    // the original, its fork and a full copy to check the original against
+    InvadersCabinet original(image, dispatchCore);
+    original.runFrames(frames);
+
+    const int FORKS = 100000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FORKS; ++i) {
+        original.memory->fork();
+    }
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    InvadersCabinet fork(original.memory->fork(), dispatchCore);
+    std::unique_ptr<SpaceInvaderMemory> copyMemory = 
+        std::make_unique<SpaceInvaderMemory>();
+    std::vector<uint8_t> cells(0x4000);
+    original.memory->readBlock(cells.data(), 0, 0x4000);
+    copyMemory->loadBlock(cells.data(), 0, 0x4000);
+    InvadersCabinet copy(std::move(copyMemory), dispatchCore);
+    for (InvadersCabinet *run : {&fork, &copy}) {
+        run->emulator->loadRegisters(original.emulator->getRegisters());
+        run->emulator->loadInterruptState(
+            original.emulator->isInterruptEnable(), 
+            original.emulator->isHalted()
+        );
+        run->machine.loadState(original.machine.getState());
+    }
+    std::cout << "Forking after " << std::dec << frames << " frames: "
+        << (1e9 * seconds / FORKS) << " ns and a " 
+        << sizeof(uint8_t*) * SpaceInvaderMemory::STORAGE_PAGES 
+        << " byte page table per fork." << std::endl;
+
+    fork.adapter.setCoin(true);
+    bool isDiverged = false;
+    for (int half = 0; half < frames * 2; ++half) {
+        // the coin switch is held for a few frames, like a real coin
+        if (half == 10) fork.adapter.setCoin(false);
+        for (InvadersCabinet *run : {&original, &fork, &copy}) {
+            run->machine.runHalfFrame();
+        }
+
+        struct Registers8080 registers = original.emulator->getRegisters();
+        bool isSame = 
+            (original.machine.getCycles() == copy.machine.getCycles())
+            && registers.isSameState(copy.emulator->getRegisters());
+        for (int i = 0; isSame && (i < 0x4000); ++i) {
+            isSame = original.memory->read(i) == copy.memory->read(i);
+        }
+        if (!isSame) {
+            std::cerr << "original changed by its fork in half frame " 
+                << half << '\n';
+            return false;
+        }
+        for (int i = 0x2000; !isDiverged && (i < 0x4000); ++i) {
+            isDiverged = original.memory->read(i) != fork.memory->read(i);
+        }
+        if (half == 1) {
+            std::cout << "  After one frame: the original copied " 
+                << original.memory->getOwnedPages() << " pages, the fork "
+                << fork.memory->getOwnedPages() << ", of " 
+                << SpaceInvaderMemory::STORAGE_PAGES / 2 << " RAM pages." 
+                << std::endl;
+        }
+    }
+    if (!isDiverged) {
+        std::cerr << "the fork with a coin never diverged" << '\n';
+        return false;
+    }
+    std::cout << "  " << frames << " frames on: the fork diverged, the "
+        << "original still matches a full copy." << std::endl;
+    return true;
+}
+
+/*
+ * Input for frame of benchRewind(): a coin, one player start, then the
+ * cannon sweeps left and right firing now and then
+ */
+static void scriptRewindInput(Adapter &adapter, int frame) {
+    adapter.setCoin((frame >= 100) && (frame < 103));
+    adapter.setP1StartButtonDown((frame >= 160) && (frame < 163));
+    adapter.setP1ShootButtonDown((frame > 200) && (frame % 40 < 3));
+    adapter.setP1LeftButtonDown((frame > 200) && ((frame / 90) % 2 == 0));
+    adapter.setP1RightButtonDown((frame > 200) && ((frame / 90) % 2 == 1));
+}
+
+bool benchRewind(
+    const std::vector<uint8_t> &image, 
+    Emulator8080::core dispatchCore, 
+    int frames,
+    size_t arenaBytes
+) {
+    InvadersCabinet cabinet(image, dispatchCore);
+    SpaceInvaderMemory &memory = *cabinet.memory;
+    Emulator8080 &emulator = *cabinet.emulator;
+    Adapter &adapter = cabinet.adapter;
+    Machine &machine = cabinet.machine;
+    auto playFrame = [&](int frame) {
+        scriptRewindInput(adapter, frame);
+        machine.runHalfFrame();
+        adapter.setInputChanged(false);
+        machine.runHalfFrame();
+    };
+
+    // the machine captures every frame as it completes it, so frame i of
+    // the buffer is the state after frame i was played; every
+    // REFERENCE_STRIDE frames a full copy is kept to check seeks against
+    const int REFERENCE_STRIDE = 97;
+    RewindBuffer rewind(arenaBytes);
+    std::vector<std::pair<int, std::unique_ptr<SaveStateImage>>> references;
+    double captureSeconds = 0.0;
+    adapter.setFrameEndFunction([&]() {
+        auto start = std::chrono::steady_clock::now();
+        rewind.capture(emulator, memory, machine);
+        captureSeconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+    });
+    for (int frame = 0; frame < frames; ++frame) {
+        playFrame(frame);
+        if ((frame % REFERENCE_STRIDE == 0) || (frame == frames - 1)) {
+            references.emplace_back(
+                frame, std::make_unique<SaveStateImage>()
+            );
+            captureState(
+                emulator, memory, machine, *references.back().second
+            );
+        }
+    }
+    unsigned long long lastFrame = static_cast<unsigned long long>(frames - 1);
+    if (rewind.isEmpty() || (rewind.getNewestFrame() != lastFrame)) {
+        std::cerr << "the frame end hook captured " 
+            << (rewind.isEmpty() ? 0 : rewind.getNewestFrame() + 1) 
+            << " frames of " << frames << '\n';
+        return false;
+    }
+    unsigned long long oldest = rewind.getOldestFrame();
+    unsigned long long newest = rewind.getNewestFrame();
+    std::cout << "Rewind over " << std::dec << frames << " frames, " 
+        << coreLabel(dispatchCore) << " core: " << rewind.getFrameCount() 
+        << " frames (" 
+        << (rewind.getFrameCount() / RewindBuffer::FRAMES_PER_SECOND) 
+        << " s) held in " << rewind.getStoredBytes() << " of " 
+        << rewind.getArenaBytes() << " bytes, " 
+        << (rewind.getStoredBytes() / rewind.getFrameCount()) 
+        << " bytes per frame against " << sizeof(SaveStateImage) 
+        << " for a state; capture " 
+        << (1e6 * captureSeconds / frames) << " us." << std::endl;
+
+    int checked = 0;
+    for (const auto &reference : references) {
+        if (static_cast<unsigned long long>(reference.first) < oldest) {
+            continue;
+        }
+        const SaveStateImage &rebuilt = rewind.seek(reference.first);
+        if (
+            std::memcmp(&rebuilt, reference.second.get(), sizeof(rebuilt)) 
+            != 0
+        ) {
+            std::cerr << "rewind did not rebuild frame " << reference.first 
+                << '\n';
+            return false;
+        }
+        ++checked;
+    }
+    std::cout << "  " << checked << " sampled frames rebuild exactly." 
+        << std::endl;
+
+    // hold rewind: step back one frame at a time from the newest
+    int backSteps = static_cast<int>(std::min<unsigned long long>(
+        newest - oldest, 10 * RewindBuffer::FRAMES_PER_SECOND
+    ));
+    rewind.seek(newest);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i <= backSteps; ++i) {
+        rewind.seek(newest - i);
+    }
+    double backSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    // jump anywhere in the window
+    const int SEEKS = 2000;
+    uint32_t random = 12345;
+    long long seekSteps = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SEEKS; ++i) {
+        random = random * 1103515245 + 12345;
+        rewind.seek(oldest + (random >> 8) % (newest - oldest + 1));
+        seekSteps += rewind.getLastSeekSteps();
+    }
+    double seekSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    std::cout << "  Step back " << backSteps << " frames: " 
+        << (1e6 * backSeconds / std::max(backSteps, 1)) 
+        << " us a frame; " << SEEKS << " random seeks: " 
+        << (1e6 * seekSeconds / SEEKS) << " us, " 
+        << (seekSteps / SEEKS) << " deltas each on average." << std::endl;
+
+    // go back half the window and play the same input forward again
+    unsigned long long resume = oldest + (newest - oldest) / 2;
+    rewind.restore(resume, emulator, memory, machine);
+    rewind.dropAfter(resume);
+    for (int frame = static_cast<int>(resume) + 1; frame < frames; ++frame) {
+        playFrame(frame);
+    }
+    SaveStateImage replayed;
+    captureState(emulator, memory, machine, replayed);
+    if (
+        (rewind.getNewestFrame() != newest)
+        || (
+            std::memcmp(
+                &replayed, references.back().second.get(), sizeof(replayed)
+            ) != 0
+        )
+        || (
+            std::memcmp(&rewind.seek(newest), &replayed, sizeof(replayed)) 
+            != 0
+        )
+    ) {
+        std::cerr << "replay from frame " << resume 
+            << " did not end in the same state" << '\n';
+        return false;
+    }
+    std::cout << "  Restored frame " << resume << " and played on: frame " 
+        << newest << " matches." << std::endl;
+    return true;
+}
+
+/*
+ * Name a dispatch core for reports
+ */
+std::string coreLabel(Emulator8080::core dispatchCore) {
+    switch (dispatchCore) {
+        case Emulator8080::SWITCH: return "Switch";
+        case Emulator8080::BLOCK: return "Block";
+        default: return "Table";
+    }
+}
+
+/*
+ * Invoke parser from TCLAP library to process the command line
+ * Returns nullptr on failure.
+ */
+std::unique_ptr<struct stateTestArguments> parseArguments(
+    int argumentCount, char *argumentVector[]
+) {
+    std::unique_ptr<struct stateTestArguments> args = 
+        std::make_unique<struct stateTestArguments>();
+    try {
+        TCLAP::CmdLine cmd(
+            "Space Invaders save state, snapshot and rewind checks",
+            ' ',
+            "0.1",
+            true
+        );
+
+        TCLAP::UnlabeledValueArg<std::string> romFileNameArg(
+            "fileName",
+            "the 8 KB Space Invaders ROM",
+            true,
+            "",
+            "string"
+        );
+        cmd.add(romFileNameArg);
+
+        std::vector<std::string> cores;
+        cores.push_back("table");
+        cores.push_back("switch");
+        cores.push_back("block");
+        TCLAP::ValuesConstraint<std::string> coreValues(cores);
+        TCLAP::ValueArg<std::string> core(
+            "k",
+            "core",
+            "opcode dispatch core",
+            false,
+            "table",
+            &coreValues
+        );
+        cmd.add(core);
+
+        TCLAP::ValueArg<int> frames(
+            "f",
+            "frames",
+            "number of Space Invaders frames each check runs",
+            false,
+            2000,
+            "int"
+        );
+        cmd.add(frames);
+
+        // Run the parser and extract the values
+        cmd.parse(argumentCount, argumentVector);
+        args->romFileName = romFileNameArg.getValue();
+        if (core.getValue() == "switch") {
+            args->dispatchCore = Emulator8080::SWITCH;
+        } else if (core.getValue() == "block") {
+            args->dispatchCore = Emulator8080::BLOCK;
+        } else {
+            args->dispatchCore = Emulator8080::TABLE;
+        }
+        args->frames = frames.getValue();
+    }
+    catch (TCLAP::ArgException &e) {
+        std::cerr << "error: " << e.error() << " for arg " << e.argId() 
+            << '\n';
+        return std::unique_ptr<struct stateTestArguments>(nullptr);
+    }
+    return args;
+}
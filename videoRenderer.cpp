@@ -0,0 +1,185 @@
+/*
+ * Conversion of Space Invaders video RAM to an upright framebuffer
+ */
+
+#include "videoRenderer.hpp"
+#include <array>
+#include <cstring>
+
+// a row of 8 pixels as a byte (bit i is pixel i) widened to 8 bytes of
+// 0x00 or 0xff, kept as bytes so a 64-bit load sees them in memory order
+// on any host
+static constexpr std::array<std::array<uint8_t, 8>, 0x100> buildPixelMasks() {
+    std::array<std::array<uint8_t, 8>, 0x100> masks = {};
+    for (int bits = 0; bits < 0x100; ++bits) {
+        for (int i = 0; i < 8; ++i) {
+            masks[bits][i] = ((bits >> i) & 0x01) ? 0xff : 0x00;
+        }
+    }
+    return masks;
+}
+static constexpr std::array<std::array<uint8_t, 8>, 0x100> PIXEL_MASKS =
+    buildPixelMasks();
+
+// transpose an 8x8 bit matrix held one row per byte: bit j of byte i
+// moves to bit i of byte j. Hacker's Delight, section 7-3
+static inline uint64_t transpose8x8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+// default colours, the same as the Windows app
+static const uint32_t DEFAULT_PALETTE[VideoRenderer::NUMBER_OF_COLORS] = {
+    0x00000000, // black background
+    0x00ffffff, // white
+    0x00ff1144, // magenta strip near the top
+    0x00139d08 // green strip near the bottom
+};
+
+// build the gel planes
+VideoRenderer::VideoRenderer() {
+    this->gel8.resize(WIDTH * HEIGHT);
+    for (int row = 0; row < HEIGHT; ++row) {
+        for (int column = 0; column < WIDTH; ++column) {
+            this->gel8[row * WIDTH + column] = gelColor(row, column);
+        }
+    }
+    this->setPalette(DEFAULT_PALETTE);
+}
+
+// colour the gel plane for 32bpp output
+void VideoRenderer::setPalette(const uint32_t palette[NUMBER_OF_COLORS]) {
+    this->gel32.resize(WIDTH * HEIGHT);
+    for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+        this->gel32[i] = palette[this->gel8[i]];
+    }
+}
+
+// the strips: magenta over the score line, green over the player, the
+// shields and the reserve ships but not the credit count
+uint8_t VideoRenderer::gelColor(int row, int column) {
+    if (
+        (row <= 32) || ((row > 64) && (row <= 184))
+        || ((row > 240) && ((column <= 15) || (column > 134)))
+    ) {
+        return COLOR_WHITE;
+    } else if ((row > 32) && (row <= 64)) {
+        return COLOR_MAGENTA;
+    }
+    return COLOR_GREEN;
+}
+
+// load the 8x8 tile of a strip whose bits come from byte of each
+// column: byte i of the word is column i of the strip
+static inline uint64_t loadTile(const uint8_t *strip, int byte) {
+    const int COLUMN_BYTES = VideoRenderer::HEIGHT / 8;
+    const uint8_t *source = strip + byte;
+    uint64_t tile = 0;
+    for (int i = 0; i < 8; ++i) {
+        tile |= static_cast<uint64_t>(source[i * COLUMN_BYTES]) << (8 * i);
+    }
+    return tile;
+}
+
+// render the 8 columns from 8 * group, held by strip, one 8x8 tile per
+// step.
+// tileRow counts 8-pixel rows from the top, so it reads byte
+// 31 - tileRow of each column, high bit first
+void VideoRenderer::renderGroup8(
+    const uint8_t *strip, int group, uint8_t *pixels
+) const {
+    const int COLUMN_BYTES = HEIGHT / 8;
+    int column = group * 8;
+    for (int tileRow = 0; tileRow < COLUMN_BYTES; ++tileRow) {
+        uint64_t tile = 
+            loadTile(strip, COLUMN_BYTES - 1 - tileRow);
+        // now byte j holds bit j of every column, the row 7 - j
+        tile = transpose8x8(tile);
+        for (int j = 0; j < 8; ++j) {
+            int offset = (tileRow * 8 + 7 - j) * WIDTH + column;
+            uint64_t mask;
+            uint64_t gel;
+            uint8_t bits = static_cast<uint8_t>(tile >> (8 * j));
+            std::memcpy(&mask, PIXEL_MASKS[bits].data(), 8);
+            std::memcpy(&gel, &this->gel8[offset], 8);
+            mask &= gel;
+            std::memcpy(&pixels[offset], &mask, 8);
+        }
+    }
+}
+
+// the same tiles as renderGroup8(), widened to 32 bits a pixel
+void VideoRenderer::renderGroup32(
+    const uint8_t *strip, int group, uint32_t *pixels
+) const {
+    const int COLUMN_BYTES = HEIGHT / 8;
+    int column = group * 8;
+    for (int tileRow = 0; tileRow < COLUMN_BYTES; ++tileRow) {
+        uint64_t tile = 
+            loadTile(strip, COLUMN_BYTES - 1 - tileRow);
+        tile = transpose8x8(tile);
+        for (int j = 0; j < 8; ++j) {
+            int offset = (tileRow * 8 + 7 - j) * WIDTH + column;
+            uint8_t bits = static_cast<uint8_t>(tile >> (8 * j));
+            const uint8_t *mask = PIXEL_MASKS[bits].data();
+            const uint32_t *gel = &this->gel32[offset];
+            for (int i = 0; i < 8; ++i) {
+                // sign extension makes 0xff all ones
+                uint32_t lit = static_cast<uint32_t>(
+                    static_cast<int8_t>(mask[i])
+                );
+                pixels[offset + i] = gel[i] & lit;
+            }
+        }
+    }
+}
+
+// convert the whole screen
+void VideoRenderer::render8(
+    const uint8_t *const *videoStrips, uint8_t *pixels
+) const {
+    for (int group = 0; group < GROUPS; ++group) {
+        this->renderGroup8(videoStrips[group], group, pixels);
+    }
+}
+
+void VideoRenderer::render32(
+    const uint8_t *const *videoStrips, uint32_t *pixels
+) const {
+    for (int group = 0; group < GROUPS; ++group) {
+        this->renderGroup32(videoStrips[group], group, pixels);
+    }
+}
+
+// convert the groups of 8 columns holding a dirty column
+int VideoRenderer::update8(
+    const uint8_t *const *videoStrips, const struct VideoColumns &dirty, 
+    uint8_t *pixels
+) const {
+    int updated = 0;
+    for (int group = 0; group < GROUPS; ++group) {
+        if (dirty.getGroup(group) == 0) continue;
+        this->renderGroup8(videoStrips[group], group, pixels);
+        ++updated;
+    }
+    return updated;
+}
+
+int VideoRenderer::update32(
+    const uint8_t *const *videoStrips, const struct VideoColumns &dirty, 
+    uint32_t *pixels
+) const {
+    int updated = 0;
+    for (int group = 0; group < GROUPS; ++group) {
+        if (dirty.getGroup(group) == 0) continue;
+        this->renderGroup32(videoStrips[group], group, pixels);
+        ++updated;
+    }
+    return updated;
+}
@@ -0,0 +1,88 @@
+/*
+ * Conversion of Space Invaders video RAM to an upright framebuffer
+ */
+
+#ifndef VIDEORENDERER_HPP
+#define VIDEORENDERER_HPP
+
+#include <cstdint>
+#include <vector>
+#include "memory.hpp"
+
+/*
+ * Video RAM ($2400-$3fff) holds the screen as the monitor scans it: 224
+ * columns of 32 bytes, each column bottom to top, low bit first. The
+ * cabinet turns the monitor a quarter turn, so the upright image is the
+ * video RAM rotated counter-clockwise, and coloured strips of gel on the
+ * glass tint parts of it.
+ *
+ * The renderer works in strips of 8 columns, so a strip can be redrawn on
+ * its own when only some columns changed. It rotates 8x8 pixel tiles at a
+ * time: the 8 bytes of a tile are loaded into one 64-bit word, transposed
+ * as a bit matrix with three shift/mask steps, and each resulting byte (a
+ * row of 8 pixels) is widened through a table and masked with a
+ * precomputed gel plane. No per-pixel branches and no per-byte virtual
+ * memory reads.
+ */
+class VideoRenderer {
+    public:
+        static const int WIDTH = 224;
+        static const int HEIGHT = 256;
+        static const uint16_t VIDEO_RAM_START = 0x2400;
+        static const int VIDEO_RAM_BYTES = WIDTH * HEIGHT / 8;
+
+        // colour indices of 8bpp output; black must stay 0
+        enum colorIndex : uint8_t {
+            COLOR_BLACK = 0,
+            COLOR_WHITE = 1,
+            COLOR_MAGENTA = 2,
+            COLOR_GREEN = 3
+        };
+        static const int NUMBER_OF_COLORS = 4;
+
+        VideoRenderer();
+
+        // 0x00RRGGBB for each colour index, used by render32()
+        // black must stay 0
+        void setPalette(const uint32_t palette[NUMBER_OF_COLORS]);
+
+        // videoStrips[g] points at the 256 bytes of video RAM from
+        // $2400 + 256 * g, the columns of strip g (see
+        // SpaceInvaderMemory::getVideoStrips()). pixels receives
+        // WIDTH * HEIGHT pixels, top row first
+        void render8(const uint8_t *const *videoStrips, uint8_t *pixels) const;
+        void render32(const uint8_t *const *videoStrips, uint32_t *pixels) const;
+
+        // redraw only the 8-column strips holding a column in dirty (see
+        // SpaceInvaderMemory::takeDirtyColumns()); pixels must hold the
+        // frame drawn before those columns changed. returns the number of
+        // strips redrawn, 0 if the frame did not change
+        int update8(
+            const uint8_t *const *videoStrips, const struct VideoColumns &dirty, 
+            uint8_t *pixels
+        ) const;
+        int update32(
+            const uint8_t *const *videoStrips, const struct VideoColumns &dirty, 
+            uint32_t *pixels
+        ) const;
+
+        // the colour index the gel gives a lit pixel, top row first
+        static uint8_t gelColor(int row, int column);
+
+    private:
+        // strips of 8 columns, the unit of conversion
+        static const int GROUPS = WIDTH / 8;
+
+        void renderGroup8(
+            const uint8_t *strip, int group, uint8_t *pixels
+        ) const;
+        void renderGroup32(
+            const uint8_t *strip, int group, uint32_t *pixels
+        ) const;
+
+        // gel colour of every pixel as an index and as 0x00RRGGBB
+        std::vector<uint8_t> gel8;
+        std::vector<uint32_t> gel32;
+};
+
+#endif
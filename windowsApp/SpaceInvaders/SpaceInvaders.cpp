@@ -13,12 +13,15 @@ and advance the machine emulator every frame.
 #include "machine.hpp"
 #include "memory.hpp"
 #include "emulator.hpp"
+#include "videoRenderer.hpp"
 #include <vector>
 #include <fstream>
 #include <memory>
+#include <cstring>
 #include "soundDevice.h"
-#include "snapshot.h"
-#include <chrono>
+#include "saveState.hpp"
+#include "rewindBuffer.hpp"
+#include "inputMovie.hpp"
 #include <synchapi.h>
 #define MAX_LOADSTRING 100
 
@@ -38,15 +41,21 @@ void DrawScreen(HWND hWnd, HDC hdc);
 void LoadROMIntoMemory();
 
 void RefreshScreen();
-void TakeSnapshot();
-void RewindSnapshot();
-void ForwardSnapshot();
+void CaptureRewindFrame();
+void SeekRewind(double seconds);
+bool DropRewoundFrames();
+void ResumeFromRewind();
+void UpdateWholeScreen();
+void QuickSave();
+void QuickLoad();
+void SaveMovie();
 
 Adapter platformAdapter;
 Machine machine;
 std::unique_ptr<SpaceInvaderMemory> memory = nullptr;
 Emulator8080 emulator;
 uint8_t* g_videoBuffer;
+VideoRenderer videoRenderer;
 bool g_gameRunning;
 bool g_screenNeedsRefresh;
 
@@ -68,12 +77,24 @@ std::unique_ptr<InvaderSoundDevice> soundPlayer;
 
 bool g_paused;
 
-#define NUM_SNAPSHOTS 20
-std::vector<std::unique_ptr<Snapshot>> snapshots;
-int g_snapshotIndex = 0;
-int g_snapshotStartIndex = 0;
-int g_snapshotEndIndex = 0;
-std::chrono::time_point<std::chrono::high_resolution_clock> g_snapshotStartTime;
+//Every frame of the last 10 minutes is kept for rewinding. A frame of
+//play stores about 136 bytes, the arena allows a little more
+const int REWIND_SECONDS = 10 * 60;
+const size_t REWIND_BYTES_PER_FRAME = 160;
+const size_t REWIND_ARENA_BYTES =
+	REWIND_SECONDS * RewindBuffer::FRAMES_PER_SECOND * REWIND_BYTES_PER_FRAME;
+const double REWIND_STEP_SECONDS = 1.0;
+RewindBuffer g_rewind(REWIND_ARENA_BYTES);
+//While paused and rewound, the frame the machine was loaded from
+bool g_isRewound = false;
+unsigned long long g_rewindFrame = 0;
+
+const char* QUICK_SAVE_FILE = "SpaceInvaders.sav";
+
+//The input since launch, or since the game last jumped to another state,
+//for replaying a session exactly
+InputMovie g_movie;
+const char* MOVIE_FILE = "SpaceInvaders.movie";
 
 //end declares
 
@@ -90,6 +111,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	//Create gui app video buffer
 	int screenPixelBufferSize = NATIVE_HEIGHT_PIXELS * NATIVE_WIDTH_PIXELS; //57344 total pixels
 	g_videoBuffer = reinterpret_cast<uint8_t*>(std::malloc(screenPixelBufferSize * sizeof(uint8_t)));
+	//Black until the machine renders the first frame into it
+	std::memset(g_videoBuffer, COLOR_BLACK, screenPixelBufferSize);
 
 	//Create the bitmap color palette to be used for drawing the screen
 	COLOR_TABLE[COLOR_BLACK] = RGBQUAD{ 0x00,0x00,0x00,0 }; // color 0, black for background
@@ -146,6 +169,16 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	//Screen refresh indicator
 	platformAdapter.setRefreshScreenFunction(RefreshScreen);
 
+	//Each half of the screen is converted at the interrupt that ends it,
+	//so sprites the game moves mid-frame do not tear. Only the columns
+	//written since the last conversion are converted again
+	platformAdapter.setRenderColumnsFunction([](const uint8_t* const* videoStrips, int firstColumn, int columns) {
+		videoRenderer.update8(videoStrips, memory->takeDirtyColumns(firstColumn, columns), g_videoBuffer);
+	});
+
+	//Every frame is kept for rewinding, as the machine completes it
+	platformAdapter.setFrameEndFunction(CaptureRewindFrame);
+
 	machine.setPlatformAdapter(&platformAdapter);
 
 	memory = std::make_unique<SpaceInvaderMemory>();
@@ -158,6 +191,9 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
 	//Connect machine to emulator
 	machine.setEmulator(&emulator);
+	machine.setVideoMemory(memory.get());
+	machine.setSplitRendering(true);
+	g_movie.startRecording(emulator, *memory, machine);
 
 	//** End Configure machine and emulator **
 
@@ -176,6 +212,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
     MSG msg;
 	 
+	//The machine sleeps between half frames; ask for 1 ms timer resolution
+	//so those sleeps end close to the frame deadlines
+	timeBeginPeriod(1);
+
 	//Main game loop
 	g_gameRunning = true;
 	while (g_gameRunning)
@@ -184,17 +224,6 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 		if (!g_paused)
 		{
 			platformAdapter.setInputChanged(false);
-
-			//Snapshot taken every 5 seconds
-			{
-				auto checkTime = std::chrono::high_resolution_clock::now();
-				auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(checkTime - g_snapshotStartTime);
-				if (duration.count() > 5000)
-				{
-					TakeSnapshot();
-					g_snapshotStartTime = std::chrono::high_resolution_clock::now();
-				}
-			}
 		}
 
 		//Check for input or need to redraw screen
@@ -208,7 +237,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 		}
 
 		//Advance the machine, it will trigger a screen refresh when needed
-		if (!g_paused)
+		//A deadlocked cpu is left alone like a paused one
+		if (!g_paused && !machine.isDeadlocked())
 		{
 			machine.step();
 		}
@@ -218,6 +248,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 		}
 		
 	}
+	timeEndPeriod(1);
 	free(g_videoBuffer);
 	free(bi);
     return (int) msg.wParam;
@@ -397,31 +428,40 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 			case 0x50:
 				//P key
 				g_paused = !g_paused;
-				if (g_paused)
+				if (!g_paused)
 				{
-					//Take a snapshot, so we can always come back to
-					//this point if we rewound
-					TakeSnapshot();
+					ResumeFromRewind();
 				}
 				break;
 			case 0x49:
 				//I key
-				//Attempt to go back in time
+				//Go back in time, pausing the game
 				g_paused = true;
-				RewindSnapshot();
+				SeekRewind(-REWIND_STEP_SECONDS);
 				RefreshScreen();
 				break;
 			case 0x4F:
 				//O key
-				//Attempt to go forward in time
+				//Go forward again, up to where the game was paused
 				g_paused = true;
-				ForwardSnapshot();
-				RefreshScreen();				
+				SeekRewind(REWIND_STEP_SECONDS);
+				RefreshScreen();
 				break;
-			case 0x54:
-				//T key
-				//TakeSnapshot
-				TakeSnapshot();				
+			case VK_F5:
+				//F5 key
+				//Save the game to the quick save file
+				QuickSave();
+				break;
+			case VK_F9:
+				//F9 key
+				//Load the game from the quick save file
+				QuickLoad();
+				RefreshScreen();
+				break;
+			case VK_F7:
+				//F7 key
+				//Save the input movie of the session so far
+				SaveMovie();
 				break;
 			default:
 				return DefWindowProc(hWnd, message, wParam, lParam);
@@ -548,59 +588,9 @@ INT_PTR CALLBACK About(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam)
 void DrawScreen(HWND hWnd, HDC hdc)
 {
 	//Space Invaders screen: 256x224 pixels
-	//Each byte in the g_videoBuffer is a pixel to make it easy to rotate
-	int height = NATIVE_HEIGHT_PIXELS;
-	int width = NATIVE_WIDTH_PIXELS;
-	//int byteSize = 1; //Each pixel is 8 bits
-	//int bitCount = byteSize * 8; // could be 8, 16, 24, 32, 64 bits per color, only 0/1 from game
-	//int totalSize = height * width * byteSize;  // 57,344 total pixels
-
-	//Iterate over each byte of of memory and put bits into video buffer
-	//int bufferIndex = 0; //Used for testing drawing raw data (rotated clockwise)
-	
-	int rowWidth = NATIVE_WIDTH_PIXELS;
-	int rowIndex = NATIVE_HEIGHT_PIXELS - 1; //reduce by 1 for 0-indexing
-	int columnIndex = 0;
-
-	static int VIDEO_BUFFER_BEGIN = 0x2400;
-	static int VIDEO_BUFFER_END = 0x4000;
-
-	for (int i = VIDEO_BUFFER_BEGIN; i < VIDEO_BUFFER_END; ++i)
-	{
-		uint8_t bitBlock = memory->read(i);
-
-		//Rotate pixels counter-clockwise, so draw every column bottom-up
-		auto foreground = [](int row, int column)
-		{
-			if ((row <= 32) || ((row > 64) && (row <= 184)) || ((row > 240) && ((column <= 15) || (column > 134))))
-			{
-				return COLOR_WHITE;
-			} 
-			else if (row > 32 && row <= 64)
-			{
-				return COLOR_MAGENTA;
-			}
-			else
-			{
-				return COLOR_GREEN;
-			}
-		};
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 0) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 1) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 2) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 3) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 4) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 5) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 6) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-		g_videoBuffer[rowIndex-- * rowWidth + columnIndex] = (bitBlock >> 7) & 0x1 ? foreground(rowIndex + 1, columnIndex) : COLOR_BLACK;
-
-		if (rowIndex < 0)
-		{
-			rowIndex = NATIVE_HEIGHT_PIXELS - 1; //reduce by 1 for 0-indexing
-			columnIndex += 1;
-		}
-		
-	}
+	//Each byte in the g_videoBuffer is a pixel, a COLOR_TABLE index.
+	//The machine's split rendering has already converted video RAM into it
+	//half a screen at a time, so painting only copies it to the window
 
 	//Enforce correct aspect ratio for displayed screen
 	static float aspectRatio = 256/224;
@@ -653,65 +643,116 @@ void RefreshScreen()
 	InvalidateRect(g_hWndGameWindow, 0, 0);
 }
 
-//Take a snapshot and store it in a circular array of NUM_SNAPSHOTS size
-void TakeSnapshot()
+//Keep the frame the machine just completed for rewinding
+void CaptureRewindFrame()
 {
-	std::unique_ptr<Snapshot> snapshot = emulator.TakeSnapshot();
+	g_rewind.capture(emulator, *memory, machine);
+}
 
-	if (g_snapshotIndex == snapshots.size())
+//Load the frame seconds after the one showing, negative to go back. The
+//frames after it are kept until the game is resumed
+void SeekRewind(double seconds)
+{
+	if (g_rewind.isEmpty())
 	{
-		snapshots.push_back(std::move(snapshot));
+		return;
 	}
-	else
+	if (!g_isRewound)
 	{
-		snapshots[g_snapshotIndex] = std::move(snapshot);
+		g_rewindFrame = g_rewind.getNewestFrame();
+		g_isRewound = true;
 	}
-
-	//If at last slot, advance end slot
-	if (g_snapshotIndex == g_snapshotEndIndex)
+	long long step = static_cast<long long>(seconds * RewindBuffer::FRAMES_PER_SECOND);
+	long long frame = static_cast<long long>(g_rewindFrame) + step;
+	if (frame < static_cast<long long>(g_rewind.getOldestFrame()))
 	{
-		g_snapshotEndIndex++;
-		g_snapshotEndIndex = g_snapshotEndIndex % NUM_SNAPSHOTS;		
+		frame = g_rewind.getOldestFrame();
 	}
-
-	//End wrapped around to start, so move start up
-	if (g_snapshotEndIndex == g_snapshotStartIndex)
+	if (frame > static_cast<long long>(g_rewind.getNewestFrame()))
 	{
-		g_snapshotStartIndex++;
-		g_snapshotStartIndex = g_snapshotStartIndex % NUM_SNAPSHOTS;
+		frame = g_rewind.getNewestFrame();
 	}
-	
-	g_snapshotIndex++;
-	g_snapshotIndex = g_snapshotIndex % NUM_SNAPSHOTS;
-
+	g_rewindFrame = static_cast<unsigned long long>(frame);
+	g_rewind.restore(g_rewindFrame, emulator, *memory, machine);
+	UpdateWholeScreen();
 }
 
-void RewindSnapshot()
-{	
-	if (g_snapshotIndex != g_snapshotStartIndex)
+//If the game is rewound, drop the frames after the one showing, so the
+//next capture follows it. Returns whether it was rewound
+bool DropRewoundFrames()
+{
+	if (!g_isRewound)
 	{
-		g_snapshotIndex = g_snapshotIndex > 0 ? g_snapshotIndex - 1 : NUM_SNAPSHOTS - 1;
+		return false;
 	}
+	g_rewind.dropAfter(g_rewindFrame);
+	g_isRewound = false;
+	return true;
+}
 
-	if (g_snapshotIndex < snapshots.size() && snapshots[g_snapshotIndex] != NULL)
+//Play on from the frame showing: the future that was rewound is dropped
+void ResumeFromRewind()
+{
+	if (DropRewoundFrames())
 	{
-		emulator.LoadSnapshot(std::move(snapshots[g_snapshotIndex]->clone()));
+		//The movie so far led somewhere else
+		g_movie.startRecording(emulator, *memory, machine);
 	}
 }
 
+//Save the whole machine to QUICK_SAVE_FILE
+void QuickSave()
+{
+	SaveStateImage state;
+	try
+	{
+		captureState(emulator, *memory, machine, state);
+		writeStateFile(QUICK_SAVE_FILE, state);
+	}
+	catch (const SaveStateError& e)
+	{
+		MessageBoxA(g_hWndGameWindow, e.what(), "Quick save", MB_OK | MB_ICONWARNING);
+	}
+}
 
-void ForwardSnapshot()
+//Load QUICK_SAVE_FILE, mapped rather than read. A missing or damaged file
+//leaves the game as it was
+void QuickLoad()
 {
-	//snapshotIndex normally points to the NEXT slot to save into
-	//So the last valid slot to move forward is endIndex - 2
-	if (g_snapshotIndex != g_snapshotEndIndex && (g_snapshotIndex + 1) % NUM_SNAPSHOTS != g_snapshotEndIndex)
+	try
 	{
-		g_snapshotIndex++;
-		g_snapshotIndex = g_snapshotIndex % NUM_SNAPSHOTS;
+		MappedStateFile file(QUICK_SAVE_FILE);
+		restoreState(file.getImage(), emulator, *memory, machine);
 	}
+	catch (const SaveStateError& e)
+	{
+		MessageBoxA(g_hWndGameWindow, e.what(), "Quick load", MB_OK | MB_ICONWARNING);
+		return;
+	}
+	//The loaded game follows on from the frame showing, in a new movie
+	DropRewoundFrames();
+	g_movie.startRecording(emulator, *memory, machine);
+	UpdateWholeScreen();
+}
 
-	if (g_snapshotIndex < snapshots.size() && snapshots[g_snapshotIndex] != NULL)
+//Write g_movie to MOVIE_FILE, then record on into a new movie from here
+void SaveMovie()
+{
+	g_movie.finishRecording(emulator, *memory, machine);
+	try
+	{
+		g_movie.write(MOVIE_FILE);
+	}
+	catch (const InputMovieError& e)
 	{
-		emulator.LoadSnapshot(std::move(snapshots[g_snapshotIndex]->clone()));
+		MessageBoxA(g_hWndGameWindow, e.what(), "Save movie", MB_OK | MB_ICONWARNING);
 	}
+	g_movie.startRecording(emulator, *memory, machine);
+}
+
+//Convert the whole screen now, the game may be paused
+void UpdateWholeScreen()
+{
+	videoRenderer.update8(memory->getVideoStrips(),
+		memory->takeDirtyColumns(0, Machine::SCREEN_COLUMNS), g_videoBuffer);
 }